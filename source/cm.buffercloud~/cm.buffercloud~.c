@@ -27,8 +27,18 @@
 #include "buffer.h"
 #include "ext_atomic.h"
 #include "ext_obex.h"
+#include "ext_systhread.h"
 #include <stdlib.h> // for arc4random_uniform
 #include <math.h> // for stereo functions
+#include <string.h> // for memcpy
+#include <stdio.h> // for the analysis cache files
+#include <limits.h> // for LONG_MAX (file frame counts)
+#ifdef MAC_VERSION
+#include <sys/mman.h> // for mmap/madvise (file source)
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #define MIN_CLOUDSIZE 1 // min cloud size in ms
 #define MIN_GRAINLENGTH 1 // min grain length in ms
 #define MIN_PITCH 0.001 // min pitch
@@ -40,8 +50,94 @@
 #define ARGUMENTS 4 // constant number of arguments required for the external
 #define FLOAT_INLETS 10 // number of object float inlets
 #define PITCHLIST 10 // max values to be provided for pitch list
+#define CHANLIST 64 // max values to be provided for channel list
+#define DEFAULT_CHANS 8 // default number of output channels in speakers mode
+#define MAX_SPEAKERS 64 // max number of speakers in speakers mode
+#define SPK_ACTIVE 3 // max number of speakers with non-zero gain per grain
+#define SPK_AZSTEPS 360 // azimuth resolution of the speaker gain table (1 degree)
+#define SPK_ELSTEPS 91 // elevation resolution of the speaker gain table (2 degrees)
+#define SPK_NEAREST 6 // number of nearest speakers searched for the vbap triplet
+#define DBAP_BLUR 0.2 // spatial blur added to the speaker distances for dbap
+#define MAX_ORDER 3 // max ambisonic order
+#define AMBI_CHANS 16 // number of ambisonic channels at max order ((MAX_ORDER + 1)^2)
+#define DIRLIST 64 // max directions to be provided for direction list
+#define MIN_CUTOFF 20.0 // min grain filter cutoff frequency in Hz
+#define MAX_CUTOFF 20000.0 // max grain filter cutoff frequency in Hz
+#define MIN_Q 0.1 // min grain filter q
+#define MAX_Q 40.0 // max grain filter q
+#define MAP_INT16 1 // mapped file sample format: 16 bit integer
+#define MAP_INT24 2 // mapped file sample format: 24 bit integer
+#define MAP_INT32 3 // mapped file sample format: 32 bit integer
+#define MAP_FLOAT32 4 // mapped file sample format: 32 bit float
+#define MAP_FLOAT64 5 // mapped file sample format: 64 bit float
+#define MAP_PAGESIZE 4096 // page size used to align prefetch requests
+#define PREFETCH_INTERVAL 10 // prefetch thread interval in ms
+#define PREFETCH_MAX 16777216 // max bytes prefetched per interval
+#define STREAM_CHUNKFRAMES 16384 // frames per chunk of the streaming source cache
+#define STREAM_CACHE 33554432 // size of the streaming source cache in bytes
+#define STREAM_HEADER 1048576 // max bytes read to find the sample data of a streamed file
+#define STREAM_QUEUE 256 // size of the chunk request queue of the streaming source
+#define STREAM_INTERVAL 2 // streaming thread interval in ms when the cache is up to date
+#define STREAM_WINDOW 100 // interval in ms to move the lookahead window within a start range larger than the cache
+#define STORE_INT16 1 // compressed store format: 16 bit integer
+#define STORE_BFP16 2 // compressed store format: block floating point, 16 bit mantissa
+#define STORE_BFP8 3 // compressed store format: block floating point, 8 bit mantissa
+#define STORE_BLOCK 64 // frames sharing one exponent in the block floating point formats
+#define LOAD_CHUNKFRAMES 65536 // frames decoded per read by the load thread (multiple of STORE_BLOCK)
+#define LOAD_RUNNING 0 // load thread state: decoding
+#define LOAD_DONE 1 // load thread state: finished, the store is complete
+#define LOAD_FAILED 2 // load thread state: read error or cancelled
+#define MAX_CORPUS 1024 // maximum number of buffers in the corpus
+#define ONSET_FFTSIZE 1024 // onset detection frame size
+#define ONSET_HOP 256 // onset detection hop size
+#define ONSET_WINDOW 8 // onset detection frames on each side of the adaptive threshold window
+#define ONSET_MINGAP 4 // minimum distance between onsets in hops
+#define ONSET_FLOOR 0.1 // minimum spectral flux of an onset
+#define DESC_DIMS 4 // number of descriptors (rms, spectral centroid, spectral flatness, pitch)
+#define DESC_FRAMESIZE 1024 // descriptor analysis frame size
+#define DESC_FFTSIZE 2048 // descriptor analysis fft size (zero padded frame for the autocorrelation)
+#define DESC_HOP 512 // descriptor analysis hop size
+#define DESC_MINPITCH 50.0 // lowest detected pitch in Hz
+#define DESC_MAXPITCH 1000.0 // highest detected pitch in Hz
+#define DESC_VOICED 0.2 // maximum normalized difference of a voiced frame (yin threshold)
+#define DESC_UNVOICED -1.0 // normalized pitch of unvoiced frames
+#define MAX_NEIGHBORS 32 // maximum number of nearest descriptor frames a start is chosen from
+#define CACHE_VERSION 1 // analysis cache file version (increment when an analysis or the file layout changes)
+#define CACHE_ONSETS 1 // analysis cache file kinds
+#define CACHE_ZEROS 2
+#define CACHE_DESCRIPTORS 3
+#define CACHE_MARKS 4
+#define CACHE_RESAMPLED 5
+#define MARK_HOP 256 // pitch mark analysis hop size (the frame size is DESC_FRAMESIZE)
+#define MAX_PERIODS 8 // maximum number of periods of a pitch synchronous grain
+#define MIN_HOP 1.0 // min scan hop in ms
+#define MAX_HOP 1000.0 // max scan hop in ms
+#define MAX_STRETCH 8.0 // max scan playhead speed (negative speeds scan backwards)
+#define MAX_SEEK 20.0 // max scan alignment search range in ms
+#define WSOLA_MAXLEN 2048 // max number of frames compared by the scan alignment
+#define WSOLA_MAXSEEK 1024 // max scan alignment search range in frames (on each side of the playhead)
+#define WSOLA_FFTSIZE 4096 // max scan alignment fft size (WSOLA_MAXLEN + 2 * WSOLA_MAXSEEK)
+#define WSOLA_INTERVAL 1 // alignment thread interval in ms
+#define WSOLA_IDLE 0 // alignment job states
+#define WSOLA_PENDING 1
+#define WSOLA_RUNNING 2
+#define WSOLA_DONE 3
+#define RESAMPLE_ZEROS 32 // zero crossings on each side of the resampling kernel
+#define RESAMPLE_PHASES 512 // resampling kernel table entries per zero crossing
+#define RESAMPLE_BETA 8.6 // kaiser window beta of the resampling kernel
+#define WINTABLE_MIN 256 // min size of the window table (power of 2)
+#define WINTABLE_MAX 65536 // max size of the window table (power of 2)
+#define MAX_BUSES 16 // max number of stereo output buses
+#define MAX_BUCKETS 64 // max number of hrtf direction buckets
+#define MAX_HRIRLENGTH 4096 // max length of a head related impulse response in samples
+#define CONV_BLOCK 128 // partition size of the hrtf convolution in samples
+#define CONV_FFTSIZE 256 // fft size of the hrtf convolution (2 * CONV_BLOCK)
 #define RANDMAX 10000
 
+#ifdef WIN_VERSION
+#define M_PI 3.14159265358979323846264338327950288
+#endif
+
 
 /************************************************************************************************************************/
 /* GRAIN MEMORY STORAGE                                                                                                 */
@@ -53,9 +149,210 @@ typedef struct cmcloud {
 	long pos;
 	t_bool reverse; // used to store the reverse flag
 	t_bool busy; // used to store the flag if a grain is currently playing or not
+	short spk[SPK_ACTIVE]; // output channels the grain is mixed into (speakers mode)
+	double spk_gain[SPK_ACTIVE]; // gains for the output channels (speakers mode)
+	short spk_count; // number of output channels with non-zero gain (speakers mode)
+	double ambi_coef[AMBI_CHANS]; // spherical harmonic coefficients of the grain direction (ambisonic mode)
+	long bucket; // hrtf direction bucket (binaural mode)
+	long bus; // stereo output bus
 } cm_cloud;
 
 
+/************************************************************************************************************************/
+/* SPEAKER GAIN TABLE ENTRY                                                                                             */
+/************************************************************************************************************************/
+typedef struct cmspkentry {
+	short spk[SPK_ACTIVE]; // speaker indices
+	float gain[SPK_ACTIVE]; // speaker gains
+	short count; // number of speakers with non-zero gain
+} cm_spkentry;
+
+
+/************************************************************************************************************************/
+/* MEMORY MAPPED AUDIO FILE (uncompressed WAV/RF64, AIFF/AIFC and CAF)                                                  */
+/************************************************************************************************************************/
+typedef struct cmmapfile {
+	unsigned char *base; // first byte of the mapping
+	t_int64 size; // size of the mapping in bytes
+	t_int64 filesize; // size of the file in bytes
+	unsigned char *data; // first byte of the sample data
+	t_int64 framecount; // number of frames in the file
+	long channelcount; // number of channels in the file
+	double samplerate; // sample rate of the file
+	short format; // sample format (MAP_INT16 ... MAP_FLOAT64)
+	short bytes; // bytes per sample
+	long framebytes; // bytes per frame
+	t_bool bigendian; // byte order of the samples
+#ifdef WIN_VERSION
+	HANDLE file; // file handle
+	HANDLE mapping; // file mapping handle
+#endif
+} cm_mapfile;
+
+
+/************************************************************************************************************************/
+/* STREAMING AUDIO FILE (fixed size cache of chunks, loaded by the streaming thread)                                   */
+/************************************************************************************************************************/
+typedef struct cmstream {
+	cm_mapfile fmt; // format of the file (the file is not mapped)
+	t_int64 dataoffset; // file position of the sample data
+	t_filehandle fh; // file handle
+	long chunkbytes; // bytes per chunk
+	long chunkcount; // number of chunks in the file
+	long slots; // number of cache slots
+	unsigned char *cache; // cache memory (slots * chunkbytes)
+	long *slot_chunk; // chunk held by each slot (-1 = empty)
+	t_bool *slot_ready; // slot loaded
+	long *slot_used; // generation of the last read of each slot
+	long *chunk_slot; // slot of each chunk (-1 = not cached)
+	long generation; // signal vector counter (least recently used slots are replaced first)
+	long queue[STREAM_QUEUE]; // chunks requested by the audio thread
+	long queue_head; // queue read position
+	long queue_tail; // queue write position
+	long window_first; // first chunk of the lookahead window
+	long window_last; // last chunk of the lookahead window
+	long window_time; // time of the last lookahead window move in ms
+} cm_stream;
+
+
+/************************************************************************************************************************/
+/* COMPRESSED SAMPLE STORE (planar int16 or block floating point with one exponent per STORE_BLOCK frames)               */
+/************************************************************************************************************************/
+typedef struct cmstore {
+	long framecount; // number of frames
+	long channelcount; // number of channels
+	double samplerate; // sample rate
+	short format; // store format (STORE_INT16, STORE_BFP16, STORE_BFP8)
+	short **m16; // 16 bit samples/mantissas per channel (int16, bfp16)
+	signed char **m8; // 8 bit mantissas per channel (bfp8)
+	signed char **exponent; // block exponents per channel (bfp16, bfp8)
+} cm_store;
+
+
+/************************************************************************************************************************/
+/* CORPUS TABLE ENTRY (buffer reference and cached buffer information of one corpus buffer~)                            */
+/************************************************************************************************************************/
+typedef struct cmcorpusentry {
+	t_symbol *name; // buffer name
+	t_buffer_ref *ref; // buffer reference
+	long framecount; // number of frames in the buffer
+	t_atom_long channelcount; // number of channels in the buffer
+	double m_sr; // buffer sample rate in samples per ms
+} cm_corpusentry;
+
+
+/************************************************************************************************************************/
+/* DESCRIPTOR FRAME AND K-D TREE (frames are stored in implicit k-d layout: the median of each range is the node)       */
+/************************************************************************************************************************/
+typedef struct cmdescframe {
+	double v[DESC_DIMS]; // normalized descriptors (rms, spectral centroid, spectral flatness, pitch)
+	long frame; // first frame of the analysis frame
+} cm_descframe;
+
+typedef struct cmdesctree {
+	cm_descframe *nodes; // k-d tree nodes, the split axis is the depth modulo DESC_DIMS
+	long count; // number of nodes
+	double min[DESC_DIMS]; // descriptor minimum (rms in dBFS, centroid and pitch in octaves, flatness)
+	double range[DESC_DIMS]; // descriptor range used for the normalization
+} cm_desctree;
+
+
+/************************************************************************************************************************/
+/* RESAMPLED COPY OF THE SAMPLE BUFFER~ (interleaved like the buffer~, at the dsp sample rate)                          */
+/************************************************************************************************************************/
+typedef struct cmresampled {
+	float *samples; // interleaved samples
+	long framecount; // number of frames
+	long channelcount; // number of channels
+	double samplerate; // sample rate of the copy (the dsp sample rate when the copy was made)
+} cm_resampled;
+
+
+/************************************************************************************************************************/
+/* WINDOW TABLE (the window buffer~ resampled to a power of 2 size, read with a 64 bit phase accumulator)              */
+/************************************************************************************************************************/
+typedef struct cmwintable {
+	double *window; // window samples (size + 1 entries, the last one for the interpolation)
+	long size; // table size (power of 2)
+	long mask; // table index mask
+	int shift; // right shift from the phase to the table index
+	t_uint64 fracmask; // phase bits below the table index
+	double fracscale; // scale from the phase bits below the table index to the interpolation fraction
+} cm_wintable;
+
+
+/************************************************************************************************************************/
+/* SCAN ALIGNMENT JOB (written by the perform routine, the lag is computed by the alignment thread)                    */
+/************************************************************************************************************************/
+typedef struct cmwsola {
+	double *ref; // frames read by the previous grain one hop after the start (natural continuation)
+	double *search; // frames around the playhead position of the next grain
+	long length; // number of reference frames
+	long range; // search range on each side of the playhead position
+	long search_start; // source frame of the first search frame
+	long target; // playhead position of the next grain
+	long result; // aligned start of the next grain
+	long state; // job state (WSOLA_IDLE, WSOLA_PENDING, WSOLA_RUNNING, WSOLA_DONE)
+	double *spec_ref; // fft buffers of the alignment thread
+	double *spec_search;
+	double *twiddle;
+	long *bitrev;
+	long fftsize; // fft size of the twiddle and bit reversal tables
+} cm_wsola;
+
+
+/************************************************************************************************************************/
+/* ANALYSIS CACHE FILE HEADER (followed by the block sizes as t_int64 and the blocks)                                  */
+/************************************************************************************************************************/
+typedef struct cmcacheheader {
+	char magic[8]; // "cmcache"
+	t_uint32 version; // CACHE_VERSION
+	t_uint32 kind; // CACHE_ONSETS ... CACHE_RESAMPLED
+	t_uint64 hash; // content hash of the sample buffer~
+	double param; // analysis parameter (onset threshold, resampling ratio)
+	t_uint32 longsize; // size of long on the machine that wrote the file
+	t_uint32 count; // number of blocks
+} cm_cacheheader;
+
+
+/************************************************************************************************************************/
+/* ASYNC FILE LOAD JOB (the file is decoded into its own store, which replaces the current store when it is complete)   */
+/************************************************************************************************************************/
+typedef struct cmload {
+	t_filehandle fh; // file handle (read by the load thread only)
+	cm_mapfile fmt; // sample format of the file (the header is not kept)
+	t_int64 dataoffset; // file position of the sample data
+	cm_store *store; // store the file is decoded into
+	volatile double progress; // fraction of the file decoded
+	volatile long state; // load thread state (LOAD_RUNNING, LOAD_DONE, LOAD_FAILED)
+} cm_load;
+
+
+/************************************************************************************************************************/
+/* HRTF CONVOLUTION STATE (grains are summed into one bus per direction bucket, each bus is convolved once)             */
+/************************************************************************************************************************/
+typedef struct cmhrtf {
+	long buckets; // number of direction buckets
+	long partitions; // number of hrir partitions of CONV_BLOCK samples
+	double *dir; // bucket directions as unit vectors
+	double *spec_left; // partitioned left ear hrir spectra (bins 0 to CONV_BLOCK)
+	double *spec_right; // partitioned right ear hrir spectra (bins 0 to CONV_BLOCK)
+	double *fdl; // frequency domain delay line of the bucket input spectra
+	long fdl_pos; // current frequency domain delay line slot
+	double *bus_in; // bucket buses of the current block
+	double *bus_prev; // bucket buses of the previous block (overlap-save)
+	long *idle; // number of consecutive silent blocks per bucket
+	double *out_left; // left ear output of the last block
+	double *out_right; // right ear output of the last block
+	long pos; // sample position within the current block
+	double *fft_buf; // fft work buffer
+	double *acc_left; // left ear spectrum accumulator
+	double *acc_right; // right ear spectrum accumulator
+	double *twiddle; // fft twiddle factors
+	long *bitrev; // fft bit reversal table
+} cm_hrtf;
+
+
 /************************************************************************************************************************/
 /* OBJECT STRUCTURE                                                                                                     */
 /************************************************************************************************************************/
@@ -69,6 +366,9 @@ typedef struct _cmbuffercloud {
 	t_buffer_ref *w_buffer_ref; // window buffer reference
 	long w_framecount; // number of frames in the window buffer
 	t_atom_long w_channelcount; // number of channels in the window buffer
+	cm_wintable *wintable; // copy of the window buffer~ at a power of 2 size
+	t_systhread_mutex wintable_mutex; // guards the window table while it is replaced
+	void *wintable_qelem; // writes the window table on the main thread
 	double b_m_sr; // buffer sample rate
 	double sr_ratio; // ratio between buffer sample rate and system sample rate
 	double m_sr; // system millisampling rate (samples per milliseconds = sr * 0.001)
@@ -82,6 +382,116 @@ typedef struct _cmbuffercloud {
 	void *grains_count_out; // outlet for number of currently playing grains (for debugging)
 	void *status_out; // bang outlet for preview playback indication
 	t_atom_long attr_stereo; // attribute: number of channels to be played
+	t_atom_long attr_channel; // attribute: source channel used in fixed channel mode (1-based)
+	t_symbol *attr_chanmode; // attribute: per-grain source channel selection mode
+	t_symbol *attr_outmode; // attribute: output mode
+	t_symbol *attr_panlaw; // attribute: panning law in speakers mode
+	t_atom_long attr_chans; // attribute: number of output channels in speakers mode
+	long mc_chans[2]; // number of channels of the two multichannel signal outlets
+	double *spk_azimuth; // speaker azimuth values in degrees
+	double *spk_elevation; // speaker elevation values in degrees
+	long spk_count; // number of speakers in the current layout
+	cm_spkentry *spk_table; // precomputed speaker gains for quantized grain directions
+	t_systhread_mutex spk_mutex; // guards the speaker gain table while it is replaced
+	double elevation_min; // min grain elevation in degrees
+	double elevation_max; // max grain elevation in degrees
+	t_atom_long attr_order; // attribute: ambisonic order
+	double *dirlist; // array to store azimuth/elevation pairs provided by method
+	double dirlist_zero; // zero value pointer for randomize function
+	double dirlist_size; // current number of directions stored in the direction list array
+	t_bool dirlist_active; // boolean direction list active true/false
+	cm_hrtf *hrtf; // hrtf convolution state (binaural mode)
+	t_atom_long attr_buses; // attribute: number of stereo output buses
+	t_symbol *attr_busmode; // attribute: per-grain bus assignment mode
+	t_symbol *attr_busparam; // attribute: grain parameter used for bus assignment in range mode
+	double busweights[MAX_BUSES]; // cumulative bus weights provided by method
+	long busweights_count; // current number of bus weights
+	t_symbol *attr_filter; // attribute: grain filter type
+	long filter_type; // grain filter type (0 = off, 1 = lowpass, 2 = highpass, 3 = bandpass, 4 = notch)
+	double cutoff_min; // min grain filter cutoff frequency in Hz
+	double cutoff_max; // max grain filter cutoff frequency in Hz
+	double q_min; // min grain filter q
+	double q_max; // max grain filter q
+	t_symbol *attr_source; // attribute: sample source (buffer~ or memory mapped file)
+	cm_mapfile *map; // memory mapped audio file (file source)
+	t_systhread_mutex src_mutex; // guards the mapped file against the perform routine while it is replaced
+	t_systhread_mutex map_mutex; // guards the mapped file against the prefetch thread while it is replaced
+	t_systhread prefetch_thread; // prefetch thread (file source)
+	t_bool prefetch_quit; // flag set to true to stop the prefetch thread
+	cm_stream *stream; // streaming audio file (stream source)
+	t_symbol *attr_underrun; // attribute: grains reading chunks that are not cached are silent or deferred
+	long stream_underruns; // number of grains that read chunks that were not cached
+	long stream_underruns_out; // number of underruns last sent to the status outlet
+	t_bool stream_deferred; // a deferred grain is retried with the stored parameters
+	double deferred_params[5]; // randomized parameters of the last grain
+	cm_store *store; // compressed sample store (store source)
+	t_bool store_buffer; // the store was compressed from the sample buffer~ (rebuilt when the buffer~ is modified)
+	t_symbol *attr_storeformat; // attribute: compressed sample store format
+	cm_load *load; // file load in progress
+	t_systhread load_thread; // load thread (decodes the file of the load message)
+	t_bool load_cancel; // flag set to true to stop the load thread
+	void *load_qelem; // reports the load progress and switches the store on the main thread
+	cm_corpusentry *corpus; // contiguous table of the corpus buffers (corpus source)
+	long corpus_count; // number of corpus buffers
+	t_bool corpus_modified; // a corpus buffer has been modified, the cached buffer information is refreshed
+	t_symbol *attr_corpusmode; // attribute: corpus buffer selection mode
+	double *corpusweights; // cumulative corpus buffer weights provided by method
+	long corpusweights_count; // current number of corpus buffer weights
+	long corpus_index; // corpus buffer index provided by method (index mode)
+	t_symbol *attr_onsetmode; // attribute: onset start mode
+	long onset_mode; // onset start mode (0 = off, 1 = snap, 2 = constrain)
+	double attr_onsetthresh; // attribute: onset detection threshold
+	long *onsets; // sorted onset frames of the sample buffer~
+	long onsets_count; // number of onsets
+	t_symbol *attr_zerosnap; // attribute: zero crossing snap mode
+	long zero_mode; // zero crossing snap mode (0 = off, 1 = start, 2 = start and end)
+	long **zeros; // sorted zero crossing frames per channel of the sample buffer~
+	long *zeros_count; // number of zero crossings per channel
+	long zeros_channels; // number of channels of the zero crossing index
+	t_atom_long attr_descriptors; // attribute: descriptor based start selection on/off
+	double attr_tolerance; // attribute: maximum normalized descriptor distance
+	t_atom_long attr_neighbors; // attribute: number of nearest descriptor frames
+	double desc_target[DESC_DIMS]; // target descriptors provided by method
+	double desc_weight[DESC_DIMS]; // target descriptor weights (0 = descriptor not used)
+	cm_desctree *desctree; // descriptor k-d tree of the sample buffer~
+	t_atom_long attr_resample; // attribute: resampled copy of the sample buffer~ on/off
+	t_atom_long attr_psola; // attribute: pitch synchronous grains on/off
+	double attr_periods; // attribute: number of periods of a pitch synchronous grain
+	long *marks; // sorted pitch marks of the sample buffer~ (frames)
+	long *mark_periods; // period at each pitch mark (frames)
+	long marks_count; // number of pitch marks
+	double psola_timer; // output samples since the last pitch synchronous grain
+	double psola_hop; // output samples between pitch synchronous grains (source period / pitch)
+	cm_resampled *resampled; // copy of the sample buffer~ at the dsp sample rate
+	t_atom_long attr_scan; // attribute: scan mode on/off
+	double attr_stretch; // attribute: scan playhead speed (1 = original speed)
+	double attr_hop; // attribute: scan grain interval in ms
+	double attr_seek; // attribute: scan alignment search range in ms
+	double scan_pos; // scan playhead position in source frames
+	double scan_timer; // output samples since the last scan grain
+	double scan_lo; // scan range in source frames (the playhead wraps around)
+	double scan_hi;
+	t_bool scan_reset; // the playhead restarts at start min
+	cm_wsola *wsola; // scan alignment job
+	t_systhread_mutex wsola_mutex; // guards the alignment job state
+	t_systhread wsola_thread; // alignment thread (runs while scan mode is on)
+	t_bool wsola_quit; // flag set to true to stop the alignment thread
+	t_bool resampled_active; // the copy replaced the sample buffer~ in the last signal vector
+	t_systhread_mutex index_mutex; // guards the analysis indices against the perform routine while they are replaced
+	t_systhread analysis_thread; // analysis thread (builds the indices of the sample buffer~)
+	t_bool analysis_cancel; // flag set to true to stop the analysis thread
+	volatile t_bool analysis_done; // the analysis thread has finished
+	t_bool analysis_request; // the indices are rebuilt by the analysis qelem
+	void *analysis_qelem; // starts the analysis thread and reports the indices on the main thread
+	float *analysis_samples; // copy of the sample buffer~ read by the analysis thread
+	long analysis_framecount; // number of frames of the copy
+	long analysis_channelcount; // number of channels of the copy
+	double analysis_samplerate; // sample rate of the copy
+	double analysis_dsprate; // dsp sample rate when the copy was made
+	t_symbol *attr_cache; // attribute: analysis cache folder
+	char cache_dir[MAX_PATH_CHARS]; // analysis cache folder as native path (empty = no cache)
+	char analysis_cachedir[MAX_PATH_CHARS]; // analysis cache folder used by the analysis thread
+	t_systhread_mutex hrtf_mutex; // guards the hrtf convolution state while it is replaced
 	t_atom_long attr_winterp; // attribute: window interpolation on/off
 	t_atom_long attr_sinterp; // attribute: window interpolation on/off
 	t_atom_long attr_zero; // attribute: zero crossing trigger on/off
@@ -102,6 +512,11 @@ typedef struct _cmbuffercloud {
 	double pitchlist_zero; // zero value pointer for randomize function
 	double pitchlist_size; // current numer of values stored in the pitch list array
 	t_bool pitchlist_active; // boolean pitch list active true/false
+	long *chanlist; // array to store source channels provided by method (0-based)
+	double chanlist_zero; // zero value pointer for randomize function
+	double chanlist_size; // current number of values stored in the channel list array
+	double *scratch_left; // planar copy of the source frames read by the current grain (first channel)
+	double *scratch_right; // planar copy of the source frames read by the current grain (second channel)
 	long playback_timer; // timer for check-interval playback direction
 	double startmedian; // variable to store the current playback position (median between min and max)
 	t_bool play_reverse; // flag for reverse playback used when reverse-attr set to "direction"
@@ -123,7 +538,7 @@ typedef struct cmpanner {
 /* STATIC DECLARATIONS                                                                                                  */
 /************************************************************************************************************************/
 static t_class *cmbuffercloud_class; // class pointer
-static t_symbol *ps_buffer_modified, *ps_stereo;
+static t_symbol *ps_buffer_modified, *ps_stereo, *ps_speakers, *ps_ambisonic, *ps_binaural, *ps_file, *ps_stream, *ps_store, *ps_corpus, *ps_defer;
 
 
 /************************************************************************************************************************/
@@ -142,6 +557,7 @@ void cmbuffercloud_set(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
 void cmbuffercloud_cloudsize(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
 void cmbuffercloud_grainlength(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
 void cmbuffercloud_pitchlist(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void cmbuffercloud_chanlist(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
 void cmbuffercloud_preview(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
 void cmbuffercloud_bang(t_cmbuffercloud *x);
 t_max_err cmbuffercloud_stereo_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
@@ -149,7 +565,80 @@ t_max_err cmbuffercloud_winterp_set(t_cmbuffercloud *x, t_object *attr, long arg
 t_max_err cmbuffercloud_sinterp_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
 t_max_err cmbuffercloud_zero_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
 t_max_err cmbuffercloud_reverse_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_channel_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_chanmode_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_outmode_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_panlaw_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_chans_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_order_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_buses_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_busmode_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_busparam_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+void cmbuffercloud_busweights(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+t_max_err cmbuffercloud_filter_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+void cmbuffercloud_cutoff(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void cmbuffercloud_q(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+t_max_err cmbuffercloud_source_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+void cmbuffercloud_file(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void cmbuffercloud_dofile(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void *cmbuffercloud_prefetch(t_cmbuffercloud *x);
+t_bool cmbuffercloud_prefetchstart(t_cmbuffercloud *x);
+void cmbuffercloud_stream(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void cmbuffercloud_dostream(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void cmbuffercloud_streamservice(t_cmbuffercloud *x);
+t_max_err cmbuffercloud_underrun_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+void cmbuffercloud_store(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void cmbuffercloud_dostore(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+t_max_err cmbuffercloud_storeformat_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+short cmbuffercloud_storeformat(t_cmbuffercloud *x);
+void cmbuffercloud_corpus(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void cmbuffercloud_docorpus(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void cmbuffercloud_corpusweights(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void cmbuffercloud_corpusindex(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+t_max_err cmbuffercloud_corpusmode_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+long cmbuffercloud_grainsource(t_cmbuffercloud *x);
+t_max_err cmbuffercloud_onsetmode_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_onsetthresh_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+void cmbuffercloud_analysisrequest(t_cmbuffercloud *x);
+void cmbuffercloud_analysisqueue(t_cmbuffercloud *x);
+void cmbuffercloud_wintablequeue(t_cmbuffercloud *x);
+void cmbuffercloud_analysiscancel(t_cmbuffercloud *x);
+void *cmbuffercloud_analysisthread(t_cmbuffercloud *x);
+long cmbuffercloud_onsetstart(t_cmbuffercloud *x, long start);
+t_max_err cmbuffercloud_zerosnap_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_descriptors_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_tolerance_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_neighbors_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_cache_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_resample_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_psola_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_periods_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+void cmbuffercloud_target(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+t_max_err cmbuffercloud_scan_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_stretch_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_hop_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmbuffercloud_seek_set(t_cmbuffercloud *x, t_object *attr, long argc, t_atom *argv);
+double cmbuffercloud_scanwrap(t_cmbuffercloud *x, double pos);
+void cmbuffercloud_wsolapost(t_cmbuffercloud *x, float *b_sample, cm_mapfile *map, cm_stream *stream, cm_store *store, long channel, long start, double hop);
+void *cmbuffercloud_wsolathread(t_cmbuffercloud *x);
+void cmbuffercloud_sourceread(t_cmbuffercloud *x, double *dest, float *b_sample, cm_mapfile *map, cm_stream *stream, cm_store *store, long channel, long start, long frames);
+long cmbuffercloud_descstart(t_cmbuffercloud *x);
+void cm_corpus_free(cm_corpusentry *corpus, long count);
+void cmbuffercloud_load(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void cmbuffercloud_doload(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void *cmbuffercloud_loadthread(t_cmbuffercloud *x);
+void cmbuffercloud_loadqueue(t_cmbuffercloud *x);
+void cmbuffercloud_loadcancel(t_cmbuffercloud *x);
+long cmbuffercloud_grainbus(t_cmbuffercloud *x);
+void cmbuffercloud_directions(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void cmbuffercloud_hrtf(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
 t_bool cmbuffercloud_resize(t_cmbuffercloud *x);
+long cmbuffercloud_grainchannel(t_cmbuffercloud *x);
+long cmbuffercloud_multichanneloutputs(t_cmbuffercloud *x, long outletindex);
+void cmbuffercloud_speakers(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void cmbuffercloud_elevation(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av);
+void cmbuffercloud_spktable_build(t_cmbuffercloud *x);
+void cmbuffercloud_dspchain_update(t_cmbuffercloud *x);
 
 // PANNING FUNCTION
 void cm_panning(cm_panstruct *panstruct, double *pos, t_cmbuffercloud *x);
@@ -159,6 +648,74 @@ double cm_random(double *min, double *max);
 t_bool cm_randomreverse();
 // LINEAR INTERPOLATION FUNCTION
 double cm_lininterp(double distance, float *b_sample, t_atom_long b_channelcount, t_atom_long b_framecount, short channel);
+// SPEAKER GAIN TABLE FUNCTIONS
+cm_spkentry *cm_spktable_new(double *azimuth, double *elevation, long count, t_bool dbap);
+void cm_vbap(cm_spkentry *entry, double *dir, double (*spk)[3], long count, t_bool planar);
+void cm_dbap(cm_spkentry *entry, double *dir, double (*spk)[3], long count);
+void cm_direction(double *dir, double azimuth, double elevation);
+// AMBISONIC ENCODING FUNCTION
+void cm_ambi_encode(double *coef, double azimuth, double elevation, long order);
+// HRTF CONVOLUTION FUNCTIONS
+cm_hrtf *cm_hrtf_new(float *hrir, long channelcount, long length, double *azel, long buckets);
+void cm_hrtf_free(cm_hrtf *hrtf);
+long cm_hrtf_bucket(cm_hrtf *hrtf, double azimuth, double elevation);
+void cm_hrtf_process(cm_hrtf *hrtf);
+// MEMORY MAPPED FILE FUNCTIONS
+cm_mapfile *cm_mapfile_open(t_object *x, const char *path);
+void cm_mapfile_close(cm_mapfile *map);
+t_bool cm_mapfile_parse(cm_mapfile *map);
+void cm_mapread(double *dest, cm_mapfile *map, long channel, t_int64 start, long frames);
+double cm_mapinterp(cm_mapfile *map, double distance, long channel);
+void cm_mapprefetch(cm_mapfile *map, t_int64 start, t_int64 frames);
+double cm_mapsample(const unsigned char *p, short format, t_bool bigendian);
+t_uint32 cm_le32(const unsigned char *p);
+t_uint32 cm_be32(const unsigned char *p);
+t_uint64 cm_be64(const unsigned char *p);
+// STREAMING FILE FUNCTIONS
+t_bool cm_fileheader(t_object *x, const char *filename, t_filehandle fh, cm_mapfile *fmt, t_int64 *dataoffset);
+cm_stream *cm_stream_open(t_object *x, const char *filename, short path);
+void cm_stream_close(cm_stream *stream);
+long cm_streamrequest(cm_stream *stream, long start, long frames);
+void cm_streamread(double *dest, cm_stream *stream, long channel, long start, long frames);
+double cm_streaminterp(cm_stream *stream, double distance, long channel);
+// COMPRESSED STORE FUNCTIONS
+cm_store *cm_store_new(long framecount, long channelcount, double samplerate, short format);
+void cm_store_free(cm_store *store);
+void cm_store_encode(cm_store *store, float *samples, long channelcount, long start, long frames);
+void cm_storeread(double *dest, cm_store *store, long channel, long start, long frames);
+double cm_storeinterp(cm_store *store, double distance, long channel);
+// ANALYSIS FUNCTIONS
+long cm_onsets(long **onsets, float *samples, long channelcount, long framecount, double threshold, t_bool *cancel);
+long cm_zerocrossings(long **zeros, float *samples, long channelcount, long framecount, long channel);
+void cm_zeros_free(long **zeros, long *zeros_count, long channels);
+double cm_period(double *buf, double *acf, double *twiddle, long *bitrev, long lag_min, long lag_max);
+long cm_descriptors(cm_descframe **frames, float *samples, long channelcount, long framecount, double samplerate, t_bool *cancel);
+long cm_pitchmarks(long **marks, long **periods, float *samples, long channelcount, long framecount, double samplerate, t_bool *cancel);
+cm_desctree *cm_desctree_new(cm_descframe *frames, long count);
+void cm_desctree_free(cm_desctree *tree);
+void cm_kdbuild(cm_descframe *nodes, long low, long high, long depth);
+void cm_kdsearch(cm_descframe *nodes, long low, long high, long depth, double *query, double *weight, double radius, long k, double *best_dist, long *best_frame, long *found);
+long cm_resample(float **dest, float *samples, long channelcount, long framecount, double ratio, t_bool *cancel);
+void cm_resampled_free(cm_resampled *resampled);
+cm_wintable *cm_wintable_new(float *samples, long channelcount, long framecount, t_bool interp);
+void cm_wintable_free(cm_wintable *wintable);
+t_uint64 cm_hash(float *samples, long channelcount, long framecount, double samplerate, t_bool *cancel);
+long cm_cacheread(const char *dir, t_uint64 hash, long kind, double param, long maxcount, void **blocks, t_int64 *bytes);
+void cm_cachewrite(const char *dir, t_uint64 hash, long kind, double param, long count, void **blocks, t_int64 *bytes);
+long cm_lowerbound(long *index, long count, double value);
+// SCAN ALIGNMENT FUNCTIONS
+cm_wsola *cm_wsola_new(void);
+void cm_wsola_free(cm_wsola *wsola);
+long cm_wsola_align(cm_wsola *wsola);
+long cm_nearest(long *index, long count, double value);
+// STATE VARIABLE FILTER FUNCTION
+void cm_svf(double *samples, long length, double cutoff, double q, double samplerate, long type);
+// FFT FUNCTIONS
+void cm_fft(double *data, long n, double *twiddle, long *bitrev, t_bool inverse);
+void cm_fft_tables(double *twiddle, long *bitrev, long n);
+// PLANAR READ FUNCTION
+void cm_deinterleave(double *dest, float *b_sample, t_atom_long b_channelcount, t_atom_long b_framecount, long channel, long start, long frames);
+void cm_pitchread(double *dest, double *src, long length, long pitch_length, t_bool interp);
 
 
 /************************************************************************************************************************/
@@ -177,8 +734,25 @@ void ext_main(void *r) {
 	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_cloudsize,	"cloudsize",	A_GIMME, 0); // Bind the cloudsize message
 	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_grainlength,	"grainlength",	A_GIMME, 0); // Bind the grainlength message
 	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_pitchlist,	"pitchlist",	A_GIMME, 0); // Bind the pitchlist message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_chanlist,	"chanlist",		A_GIMME, 0); // Bind the chanlist message
 	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_preview,		"preview",		A_GIMME, 0); // Bind the preview message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_speakers,	"speakers",		A_GIMME, 0); // Bind the speakers message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_elevation,	"elevation",	A_GIMME, 0); // Bind the elevation message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_directions,	"directions",	A_GIMME, 0); // Bind the directions message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_hrtf,		"hrtf",			A_GIMME, 0); // Bind the hrtf message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_busweights,	"busweights",	A_GIMME, 0); // Bind the busweights message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_cutoff,		"cutoff",		A_GIMME, 0); // Bind the cutoff message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_q,			"q",			A_GIMME, 0); // Bind the q message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_file,		"file",			A_GIMME, 0); // Bind the file message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_stream,		"stream",		A_GIMME, 0); // Bind the stream message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_store,		"store",		A_GIMME, 0); // Bind the store message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_load,		"load",			A_GIMME, 0); // Bind the load message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_corpus,		"corpus",		A_GIMME, 0); // Bind the corpus message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_corpusweights,	"corpusweights",	A_GIMME, 0); // Bind the corpusweights message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_corpusindex,	"corpusindex",	A_GIMME, 0); // Bind the corpusindex message
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_target,		"target",		A_GIMME, 0); // Bind the target message
 	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_bang,		"bang",			0);
+	class_addmethod(cmbuffercloud_class, (method)cmbuffercloud_multichanneloutputs, "multichanneloutputs", A_CANT, 0); // Bind the multichannel outlet count method
 	
 	CLASS_ATTR_ATOM_LONG(cmbuffercloud_class, "stereo", 0, t_cmbuffercloud, attr_stereo);
 	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "stereo", (method)NULL, (method)cmbuffercloud_stereo_set);
@@ -211,16 +785,231 @@ void ext_main(void *r) {
 	CLASS_ATTR_SAVE(cmbuffercloud_class, "reverse", 0);
 	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "reverse", 0, "enum", "Reverse mode");
 	
+	CLASS_ATTR_ATOM_LONG(cmbuffercloud_class, "channel", 0, t_cmbuffercloud, attr_channel);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "channel", (method)NULL, (method)cmbuffercloud_channel_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "channel", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "channel", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "channel", 0, "text", "Source channel");
+	
+	CLASS_ATTR_SYM(cmbuffercloud_class, "chanmode", 0, t_cmbuffercloud, attr_chanmode);
+	CLASS_ATTR_ENUM(cmbuffercloud_class, "chanmode", 0, "fixed random list");
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "chanmode", (method)NULL, (method)cmbuffercloud_chanmode_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "chanmode", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "chanmode", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "chanmode", 0, "enum", "Source channel selection mode");
+	
+	CLASS_ATTR_SYM(cmbuffercloud_class, "outmode", 0, t_cmbuffercloud, attr_outmode);
+	CLASS_ATTR_ENUM(cmbuffercloud_class, "outmode", 0, "stereo speakers ambisonic binaural");
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "outmode", (method)NULL, (method)cmbuffercloud_outmode_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "outmode", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "outmode", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "outmode", 0, "enum", "Output mode");
+	
+	CLASS_ATTR_SYM(cmbuffercloud_class, "panlaw", 0, t_cmbuffercloud, attr_panlaw);
+	CLASS_ATTR_ENUM(cmbuffercloud_class, "panlaw", 0, "vbap dbap");
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "panlaw", (method)NULL, (method)cmbuffercloud_panlaw_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "panlaw", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "panlaw", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "panlaw", 0, "enum", "Speaker panning law");
+	
+	CLASS_ATTR_ATOM_LONG(cmbuffercloud_class, "chans", 0, t_cmbuffercloud, attr_chans);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "chans", (method)NULL, (method)cmbuffercloud_chans_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "chans", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "chans", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "chans", 0, "text", "Number of speakers");
+	
+	CLASS_ATTR_ATOM_LONG(cmbuffercloud_class, "order", 0, t_cmbuffercloud, attr_order);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "order", (method)NULL, (method)cmbuffercloud_order_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "order", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "order", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "order", 0, "text", "Ambisonic order");
+	
+	CLASS_ATTR_ATOM_LONG(cmbuffercloud_class, "buses", 0, t_cmbuffercloud, attr_buses);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "buses", (method)NULL, (method)cmbuffercloud_buses_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "buses", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "buses", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "buses", 0, "text", "Number of output buses");
+	
+	CLASS_ATTR_SYM(cmbuffercloud_class, "busmode", 0, t_cmbuffercloud, attr_busmode);
+	CLASS_ATTR_ENUM(cmbuffercloud_class, "busmode", 0, "random weighted range");
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "busmode", (method)NULL, (method)cmbuffercloud_busmode_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "busmode", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "busmode", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "busmode", 0, "enum", "Output bus assignment mode");
+	
+	CLASS_ATTR_SYM(cmbuffercloud_class, "busparam", 0, t_cmbuffercloud, attr_busparam);
+	CLASS_ATTR_ENUM(cmbuffercloud_class, "busparam", 0, "start length pitch pan gain");
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "busparam", (method)NULL, (method)cmbuffercloud_busparam_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "busparam", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "busparam", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "busparam", 0, "enum", "Output bus assignment parameter");
+	
+	CLASS_ATTR_SYM(cmbuffercloud_class, "filter", 0, t_cmbuffercloud, attr_filter);
+	CLASS_ATTR_ENUM(cmbuffercloud_class, "filter", 0, "off lowpass highpass bandpass notch");
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "filter", (method)NULL, (method)cmbuffercloud_filter_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "filter", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "filter", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "filter", 0, "enum", "Grain filter type");
+	
+	CLASS_ATTR_SYM(cmbuffercloud_class, "source", 0, t_cmbuffercloud, attr_source);
+	CLASS_ATTR_ENUM(cmbuffercloud_class, "source", 0, "buffer file stream store corpus");
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "source", (method)NULL, (method)cmbuffercloud_source_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "source", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "source", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "source", 0, "enum", "Sample source");
+	
+	CLASS_ATTR_SYM(cmbuffercloud_class, "underrun", 0, t_cmbuffercloud, attr_underrun);
+	CLASS_ATTR_ENUM(cmbuffercloud_class, "underrun", 0, "silence defer");
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "underrun", (method)NULL, (method)cmbuffercloud_underrun_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "underrun", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "underrun", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "underrun", 0, "enum", "Stream underrun handling");
+	
+	CLASS_ATTR_SYM(cmbuffercloud_class, "storeformat", 0, t_cmbuffercloud, attr_storeformat);
+	CLASS_ATTR_ENUM(cmbuffercloud_class, "storeformat", 0, "int16 bfp16 bfp8");
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "storeformat", (method)NULL, (method)cmbuffercloud_storeformat_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "storeformat", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "storeformat", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "storeformat", 0, "enum", "Sample store format");
+	
+	CLASS_ATTR_SYM(cmbuffercloud_class, "corpusmode", 0, t_cmbuffercloud, attr_corpusmode);
+	CLASS_ATTR_ENUM(cmbuffercloud_class, "corpusmode", 0, "random weighted index");
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "corpusmode", (method)NULL, (method)cmbuffercloud_corpusmode_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "corpusmode", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "corpusmode", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "corpusmode", 0, "enum", "Corpus buffer selection");
+	
+	CLASS_ATTR_SYM(cmbuffercloud_class, "onsetmode", 0, t_cmbuffercloud, attr_onsetmode);
+	CLASS_ATTR_ENUM(cmbuffercloud_class, "onsetmode", 0, "off snap constrain");
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "onsetmode", (method)NULL, (method)cmbuffercloud_onsetmode_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "onsetmode", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "onsetmode", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "onsetmode", 0, "enum", "Onset start mode");
+	
+	CLASS_ATTR_DOUBLE(cmbuffercloud_class, "onsetthresh", 0, t_cmbuffercloud, attr_onsetthresh);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "onsetthresh", (method)NULL, (method)cmbuffercloud_onsetthresh_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "onsetthresh", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "onsetthresh", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "onsetthresh", 0, "text", "Onset detection threshold");
+	
+	CLASS_ATTR_SYM(cmbuffercloud_class, "zerosnap", 0, t_cmbuffercloud, attr_zerosnap);
+	CLASS_ATTR_ENUM(cmbuffercloud_class, "zerosnap", 0, "off start both");
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "zerosnap", (method)NULL, (method)cmbuffercloud_zerosnap_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "zerosnap", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "zerosnap", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "zerosnap", 0, "enum", "Zero crossing snap mode");
+	
+	CLASS_ATTR_ATOM_LONG(cmbuffercloud_class, "descriptors", 0, t_cmbuffercloud, attr_descriptors);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "descriptors", (method)NULL, (method)cmbuffercloud_descriptors_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "descriptors", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "descriptors", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "descriptors", 0, "onoff", "Descriptor based start selection on/off");
+	
+	CLASS_ATTR_DOUBLE(cmbuffercloud_class, "tolerance", 0, t_cmbuffercloud, attr_tolerance);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "tolerance", (method)NULL, (method)cmbuffercloud_tolerance_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "tolerance", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "tolerance", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "tolerance", 0, "text", "Descriptor tolerance");
+	
+	CLASS_ATTR_ATOM_LONG(cmbuffercloud_class, "neighbors", 0, t_cmbuffercloud, attr_neighbors);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "neighbors", (method)NULL, (method)cmbuffercloud_neighbors_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "neighbors", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "neighbors", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "neighbors", 0, "text", "Number of nearest descriptor frames");
+	
+	CLASS_ATTR_ATOM_LONG(cmbuffercloud_class, "psola", 0, t_cmbuffercloud, attr_psola);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "psola", (method)NULL, (method)cmbuffercloud_psola_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "psola", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "psola", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "psola", 0, "onoff", "Pitch synchronous grains on/off");
+	
+	CLASS_ATTR_DOUBLE(cmbuffercloud_class, "periods", 0, t_cmbuffercloud, attr_periods);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "periods", (method)NULL, (method)cmbuffercloud_periods_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "periods", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "periods", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "periods", 0, "text", "Periods per pitch synchronous grain");
+	
+	CLASS_ATTR_ATOM_LONG(cmbuffercloud_class, "resample", 0, t_cmbuffercloud, attr_resample);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "resample", (method)NULL, (method)cmbuffercloud_resample_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "resample", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "resample", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "resample", 0, "onoff", "Resample the sample buffer~ to the dsp sample rate");
+	
+	CLASS_ATTR_ATOM_LONG(cmbuffercloud_class, "scan", 0, t_cmbuffercloud, attr_scan);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "scan", (method)NULL, (method)cmbuffercloud_scan_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "scan", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "scan", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "scan", 0, "onoff", "Time-stretch scan mode on/off");
+	
+	CLASS_ATTR_DOUBLE(cmbuffercloud_class, "stretch", 0, t_cmbuffercloud, attr_stretch);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "stretch", (method)NULL, (method)cmbuffercloud_stretch_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "stretch", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "stretch", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "stretch", 0, "text", "Scan playhead speed");
+	
+	CLASS_ATTR_DOUBLE(cmbuffercloud_class, "hop", 0, t_cmbuffercloud, attr_hop);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "hop", (method)NULL, (method)cmbuffercloud_hop_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "hop", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "hop", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "hop", 0, "text", "Scan grain interval in ms");
+	
+	CLASS_ATTR_DOUBLE(cmbuffercloud_class, "seek", 0, t_cmbuffercloud, attr_seek);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "seek", (method)NULL, (method)cmbuffercloud_seek_set);
+	CLASS_ATTR_BASIC(cmbuffercloud_class, "seek", 0);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "seek", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "seek", 0, "text", "Scan alignment search range in ms");
+	
+	CLASS_ATTR_SYM(cmbuffercloud_class, "cache", 0, t_cmbuffercloud, attr_cache);
+	CLASS_ATTR_ACCESSORS(cmbuffercloud_class, "cache", (method)NULL, (method)cmbuffercloud_cache_set);
+	CLASS_ATTR_SAVE(cmbuffercloud_class, "cache", 0);
+	CLASS_ATTR_STYLE_LABEL(cmbuffercloud_class, "cache", 0, "text", "Analysis cache folder");
+	
 	CLASS_ATTR_ORDER(cmbuffercloud_class, "stereo", 0, "1");
 	CLASS_ATTR_ORDER(cmbuffercloud_class, "w_interp", 0, "2");
 	CLASS_ATTR_ORDER(cmbuffercloud_class, "s_interp", 0, "3");
 	CLASS_ATTR_ORDER(cmbuffercloud_class, "zero", 0, "4");
 	CLASS_ATTR_ORDER(cmbuffercloud_class, "reverse", 0, "5");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "channel", 0, "6");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "chanmode", 0, "7");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "outmode", 0, "8");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "panlaw", 0, "9");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "chans", 0, "10");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "order", 0, "11");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "buses", 0, "12");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "busmode", 0, "13");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "busparam", 0, "14");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "filter", 0, "15");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "source", 0, "16");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "underrun", 0, "17");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "storeformat", 0, "18");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "corpusmode", 0, "19");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "onsetmode", 0, "20");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "onsetthresh", 0, "21");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "zerosnap", 0, "22");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "descriptors", 0, "23");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "tolerance", 0, "24");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "neighbors", 0, "25");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "cache", 0, "26");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "resample", 0, "27");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "psola", 0, "28");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "periods", 0, "29");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "scan", 0, "30");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "stretch", 0, "31");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "hop", 0, "32");
+	CLASS_ATTR_ORDER(cmbuffercloud_class, "seek", 0, "33");
 	
 	class_dspinit(cmbuffercloud_class); // Add standard Max/MSP methods to your class
 	class_register(CLASS_BOX, cmbuffercloud_class); // Register the class with Max
 	ps_buffer_modified = gensym("buffer_modified"); // assign the buffer modified message to the static pointer created above
 	ps_stereo = gensym("stereo");
+	ps_speakers = gensym("speakers");
+	ps_ambisonic = gensym("ambisonic");
+	ps_binaural = gensym("binaural");
+	ps_file = gensym("file");
+	ps_stream = gensym("stream");
+	ps_store = gensym("store");
+	ps_corpus = gensym("corpus");
+	ps_defer = gensym("defer");
 }
 
 
@@ -249,6 +1038,47 @@ void *cmbuffercloud_new(t_symbol *s, long argc, t_atom *argv) {
 	object_attr_setlong(x, gensym("s_interp"), 1); // initialize window interpolation attribute
 	object_attr_setlong(x, gensym("zero"), 0); // initialize zero crossing attribute
 	object_attr_setsym(x, gensym("reverse"), gensym("off")); // initialize reverse attribute
+	object_attr_setlong(x, gensym("channel"), 1); // initialize source channel attribute
+	object_attr_setsym(x, gensym("chanmode"), gensym("fixed")); // initialize channel mode attribute
+	object_attr_setsym(x, gensym("outmode"), gensym("stereo")); // initialize output mode attribute
+	object_attr_setsym(x, gensym("panlaw"), gensym("vbap")); // initialize panning law attribute
+	object_attr_setlong(x, gensym("chans"), DEFAULT_CHANS); // initialize number of speakers attribute
+	object_attr_setlong(x, gensym("order"), 1); // initialize ambisonic order attribute
+	x->busweights_count = 0;
+	object_attr_setlong(x, gensym("buses"), 1); // initialize number of output buses attribute
+	object_attr_setsym(x, gensym("busmode"), gensym("random")); // initialize bus assignment mode attribute
+	object_attr_setsym(x, gensym("busparam"), gensym("pan")); // initialize bus assignment parameter attribute
+	object_attr_setsym(x, gensym("filter"), gensym("off")); // initialize grain filter attribute
+	object_attr_setsym(x, gensym("source"), gensym("buffer")); // initialize sample source attribute
+	object_attr_setsym(x, gensym("underrun"), gensym("silence")); // initialize stream underrun attribute
+	object_attr_setsym(x, gensym("storeformat"), gensym("int16")); // initialize sample store format attribute
+	object_attr_setsym(x, gensym("corpusmode"), gensym("random")); // initialize corpus buffer selection attribute
+	object_attr_setfloat(x, gensym("onsetthresh"), 1.5); // initialize onset detection threshold attribute
+	object_attr_setsym(x, gensym("onsetmode"), gensym("off")); // initialize onset start mode attribute
+	object_attr_setsym(x, gensym("zerosnap"), gensym("off")); // initialize zero crossing snap attribute
+	object_attr_setfloat(x, gensym("tolerance"), 0.1); // initialize descriptor tolerance attribute
+	object_attr_setlong(x, gensym("neighbors"), 8); // initialize number of nearest descriptor frames attribute
+	object_attr_setlong(x, gensym("descriptors"), 0); // initialize descriptor based start selection attribute
+	object_attr_setlong(x, gensym("resample"), 0); // initialize resample attribute
+	object_attr_setfloat(x, gensym("periods"), 2.0); // initialize periods per pitch synchronous grain attribute
+	object_attr_setlong(x, gensym("psola"), 0); // initialize pitch synchronous grains attribute
+	x->wsola = NULL; // the alignment job and thread are created by the scan attribute
+	x->wsola_thread = NULL;
+	x->wsola_quit = false;
+	systhread_mutex_new(&x->wsola_mutex, SYSTHREAD_MUTEX_NORMAL);
+	x->scan_pos = 0.0;
+	x->scan_timer = 0.0;
+	x->scan_lo = 0.0;
+	x->scan_hi = 0.0;
+	x->scan_reset = true;
+	object_attr_setfloat(x, gensym("stretch"), 1.0); // initialize scan playhead speed attribute
+	object_attr_setfloat(x, gensym("hop"), 20.0); // initialize scan grain interval attribute
+	object_attr_setfloat(x, gensym("seek"), 10.0); // initialize scan alignment search range attribute
+	object_attr_setlong(x, gensym("scan"), 0); // initialize scan mode attribute
+	x->cutoff_min = 1000.0;
+	x->cutoff_max = 1000.0;
+	x->q_min = 0.707;
+	x->q_max = 0.707;
 	attr_args_process(x, argc, argv); // get attribute values if supplied as argument
 	
 	// CHECK IF USER SUPPLIED MAXIMUM GRAINS IS IN THE LEGAL RANGE
@@ -266,8 +1096,9 @@ void *cmbuffercloud_new(t_symbol *s, long argc, t_atom *argv) {
 	// CREATE OUTLETS (OUTLETS ARE CREATED FROM RIGHT TO LEFT)
 	x->status_out = outlet_new((t_object *)x, NULL);
 	x->grains_count_out = intout((t_object *)x); // create outlet for number of currently playing grains
-	outlet_new((t_object *)x, "signal"); // right signal outlet
-	outlet_new((t_object *)x, "signal"); // left signal outlet
+	outlet_new((t_object *)x, "multichannelsignal"); // right signal outlet
+	outlet_new((t_object *)x, "multichannelsignal"); // left signal outlet (all speaker channels in speakers mode)
+	x->obj.z_misc |= Z_NO_INPLACE; // output vectors are accumulated into and must not share memory with the inputs
 	
 	// GET SYSTEM SAMPLE RATE
 	x->m_sr = sys_getsr() * 0.001; // get the current sample rate and write it into the object structure
@@ -319,6 +1150,106 @@ void *cmbuffercloud_new(t_symbol *s, long argc, t_atom *argv) {
 	// ALLOCATE MEMORY FOR PITCH LIST
 	x->pitchlist = (double *)sysmem_newptrclear(PITCHLIST * sizeof(double));
 	
+	// ALLOCATE MEMORY FOR CHANNEL LIST
+	x->chanlist = (long *)sysmem_newptrclear(CHANLIST * sizeof(long));
+	
+	// ALLOCATE MEMORY FOR THE PLANAR GRAIN SOURCE ARRAYS (+ 2 frames for the interpolation guard)
+	x->scratch_left = (double *)sysmem_newptrclear((((x->grainlength * x->m_sr) * MAX_PITCH) + 2) * sizeof(double));
+	x->scratch_right = (double *)sysmem_newptrclear((((x->grainlength * x->m_sr) * MAX_PITCH) + 2) * sizeof(double));
+	if (x->chanlist == NULL || x->scratch_left == NULL || x->scratch_right == NULL) {
+		object_error((t_object *)x, "out of memory");
+		return NULL;
+	}
+	
+	// ALLOCATE MEMORY FOR THE SPEAKER LAYOUT AND BUILD THE SPEAKER GAIN TABLE
+	x->spk_azimuth = (double *)sysmem_newptrclear(MAX_SPEAKERS * sizeof(double));
+	x->spk_elevation = (double *)sysmem_newptrclear(MAX_SPEAKERS * sizeof(double));
+	if (x->spk_azimuth == NULL || x->spk_elevation == NULL) {
+		object_error((t_object *)x, "out of memory");
+		return NULL;
+	}
+	systhread_mutex_new(&x->spk_mutex, SYSTHREAD_MUTEX_NORMAL);
+	x->spk_count = x->attr_chans;
+	for (i = 0; i < x->spk_count; i++) { // default layout: equally spaced ring, channel 1 in front, clockwise
+		x->spk_azimuth[i] = -360.0 * i / x->spk_count;
+		if (x->spk_azimuth[i] < -180.0) {
+			x->spk_azimuth[i] += 360.0;
+		}
+		x->spk_elevation[i] = 0.0;
+	}
+	x->spk_table = NULL;
+	cmbuffercloud_spktable_build(x);
+	x->elevation_min = 0.0;
+	x->elevation_max = 0.0;
+	
+	// ALLOCATE MEMORY FOR DIRECTION LIST
+	x->dirlist = (double *)sysmem_newptrclear(DIRLIST * 2 * sizeof(double));
+	if (x->dirlist == NULL) {
+		object_error((t_object *)x, "out of memory");
+		return NULL;
+	}
+	x->dirlist_active = false;
+	x->dirlist_zero = 0.0;
+	x->dirlist_size = 0.0;
+	
+	// HRTF CONVOLUTION STATE (built by the hrtf message)
+	x->hrtf = NULL;
+	systhread_mutex_new(&x->hrtf_mutex, SYSTHREAD_MUTEX_NORMAL);
+	
+	// MEMORY MAPPED FILE SOURCE (opened by the file message, pages are prefetched by the prefetch thread)
+	x->map = NULL;
+	x->stream = NULL;
+	x->store = NULL;
+	x->store_buffer = false;
+	x->load = NULL;
+	x->load_thread = NULL;
+	x->load_cancel = false;
+	x->load_qelem = qelem_new(x, (method)cmbuffercloud_loadqueue);
+	x->corpus = NULL;
+	x->corpus_count = 0;
+	x->corpus_modified = false;
+	x->corpusweights = NULL;
+	x->corpusweights_count = 0;
+	x->corpus_index = 0;
+	
+	// ANALYSIS INDICES (built by the analysis thread, analysis_request is set by the attributes above)
+	x->onsets = NULL;
+	x->onsets_count = 0;
+	x->zeros = NULL;
+	x->zeros_count = NULL;
+	x->zeros_channels = 0;
+	x->desctree = NULL;
+	x->resampled = NULL;
+	x->resampled_active = false;
+	x->marks = NULL;
+	x->mark_periods = NULL;
+	x->marks_count = 0;
+	x->psola_timer = 0.0;
+	x->psola_hop = 0.0;
+	x->attr_cache = gensym("");
+	x->cache_dir[0] = '\0';
+	x->analysis_cachedir[0] = '\0';
+	for (i = 0; i < DESC_DIMS; i++) {
+		x->desc_target[i] = 0.0;
+		x->desc_weight[i] = 0.0;
+	}
+	x->analysis_thread = NULL;
+	x->analysis_cancel = false;
+	x->analysis_done = false;
+	x->analysis_samples = NULL;
+	systhread_mutex_new(&x->index_mutex, SYSTHREAD_MUTEX_NORMAL);
+	x->analysis_qelem = qelem_new(x, (method)cmbuffercloud_analysisqueue);
+	if (x->analysis_request) {
+		qelem_set(x->analysis_qelem);
+	}
+	x->stream_underruns = 0;
+	x->stream_underruns_out = 0;
+	x->stream_deferred = false;
+	systhread_mutex_new(&x->src_mutex, SYSTHREAD_MUTEX_NORMAL);
+	systhread_mutex_new(&x->map_mutex, SYSTHREAD_MUTEX_NORMAL);
+	x->prefetch_quit = false;
+	x->prefetch_thread = NULL; // started by the first file or stream message
+	
 	/************************************************************************************************************************/
 	// INITIALIZE VALUES
 	x->object_inlets[0] = 0.0; // initialize float inlet value for current start min value
@@ -347,6 +1278,10 @@ void *cmbuffercloud_new(t_symbol *s, long argc, t_atom *argv) {
 	x->pitchlist_zero = 0.0;
 	x->pitchlist_size = 0.0;
 	
+	// chanlist values
+	x->chanlist_zero = 0.0;
+	x->chanlist_size = 0.0;
+	
 	// cloud structure members
 	for (i = 0; i < x->cloudsize; i++) {
 		x->cloud[i].length = 0;
@@ -378,6 +1313,9 @@ void *cmbuffercloud_new(t_symbol *s, long argc, t_atom *argv) {
 	x->w_framecount = 0;
 	x->b_channelcount = 0;
 	x->w_channelcount = 0;
+	x->wintable = NULL;
+	systhread_mutex_new(&x->wintable_mutex, SYSTHREAD_MUTEX_NORMAL);
+	x->wintable_qelem = qelem_new(x, (method)cmbuffercloud_wintablequeue);
 	x->b_m_sr = 0;
 	x->sr_ratio = 0;
 	
@@ -421,9 +1359,24 @@ void cmbuffercloud_dsp64(t_cmbuffercloud *x, t_object *dsp64, short *count, doub
 				return;
 			}
 		}
+		x->scratch_left = (double *)sysmem_resizeptrclear(x->scratch_left, (((x->grainlength * x->m_sr) * MAX_PITCH) + 2) * sizeof(double));
+		x->scratch_right = (double *)sysmem_resizeptrclear(x->scratch_right, (((x->grainlength * x->m_sr) * MAX_PITCH) + 2) * sizeof(double));
+		if (x->scratch_left == NULL || x->scratch_right == NULL) {
+			object_error((t_object *)x, "out of memory");
+			return;
+		}
+		// the resampled copy and the indices built from it are made for the new sample rate
+		if (x->attr_resample) {
+			cmbuffercloud_analysisrequest(x);
+		}
 	}
 	// BUFFER SETUP
 	cmbuffercloud_buffersetup(x);
+	qelem_set(x->wintable_qelem); // the window table is written from the window buffer~ of the setup
+	
+	// NUMBER OF CHANNELS PER SIGNAL OUTLET
+	x->mc_chans[0] = cmbuffercloud_multichanneloutputs(x, 0);
+	x->mc_chans[1] = cmbuffercloud_multichanneloutputs(x, 1);
 	
 	// CALL THE PERFORM ROUTINE
 	object_method(dsp64, gensym("dsp_add64"), x, cmbuffercloud_perform64, 0, NULL);
@@ -455,10 +1408,60 @@ void cmbuffercloud_perform64(t_cmbuffercloud *x, t_object *dsp64, double **ins,
 	double pan_left, pan_right;
 	double startmedian_curr;
 	double preview_pos;
+	long ch_left, ch_right; // source channels read by the current grain
+	t_bool stereo_grain; // current grain reads two source channels
+	long frame; // current sample index in the signal vector
+	long k; // output channel counter
+	double azimuth, elevation; // grain direction in degrees (speakers mode)
+	cm_spkentry *spk_entry; // speaker gain table entry for the grain direction
+	t_bool spk_mode = (x->attr_outmode == ps_speakers); // output mode: speakers
+	t_bool ambi_mode = (x->attr_outmode == ps_ambisonic); // output mode: ambisonic
+	t_bool bin_mode = (x->attr_outmode == ps_binaural); // output mode: binaural
+	t_bool spatial_mode = (spk_mode || ambi_mode || bin_mode); // spatial output modes render mono grains
+	t_bool spk_locked = false; // speaker gain table locked for this signal vector
+	t_bool hrtf_locked = false; // hrtf convolution state locked for this signal vector
+	t_bool wintable_locked; // window table locked for this signal vector
+	cm_wintable *wintable = NULL; // window table (the window buffer~ is read while the table is replaced)
+	t_uint64 w_phase, w_inc; // window table phase and phase increment of the current grain
+	double w_frac; // window table interpolation fraction
+	cm_hrtf *hrtf = NULL; // hrtf convolution state (binaural mode)
+	double *bus; // bucket buses at the current block position (binaural mode)
+	long out_bus; // stereo output bus of the current grain
+	double cutoff, q; // grain filter parameters
+	double rnd_zero = 0.0; // random range for the grain filter cutoff
+	double rnd_one = 1.0;
+	double cutoff_limit = x->m_sr * 1000.0 * 0.45; // keep the grain filter cutoff below nyquist
+	t_bool file_mode = (x->attr_source == ps_file); // sample source: memory mapped file
+	t_bool stream_mode = (x->attr_source == ps_stream); // sample source: streaming file
+	cm_stream *stream = NULL; // streaming file (stream source)
+	t_bool store_mode = (x->attr_source == ps_store); // sample source: compressed store
+	cm_store *store = NULL; // compressed sample store (store source)
+	t_bool corpus_mode = (x->attr_source == ps_corpus); // sample source: corpus of buffers
+	cm_corpusentry *corpus = NULL; // corpus table (corpus source)
+	cm_corpusentry *entry; // corpus buffer of the current grain
+	t_buffer_obj *corpus_obj = NULL; // corpus buffer object of the current grain
+	float *corpus_sample = NULL; // corpus buffer samples of the current grain
+	t_bool index_locked = false; // analysis indices locked for this signal vector
+	long *zeros; // zero crossing index of the source channel of the current grain
+	long zeros_count; // number of zero crossings of the source channel of the current grain
+	long desc_start; // start frame selected by the target descriptors
+	t_bool psola_grain; // current grain is pitch synchronous
+	t_bool scan_grain; // current grain follows the scan playhead
+	t_bool psola_clock; // grains are triggered at the source period divided by the pitch
+	double scan_hop = 0.0; // scan mode: output samples between grains
+	double scan_step = 0.0; // scan mode: playhead advance per output sample in source frames
+	t_atom underrun_atom; // number of stream underruns
+	t_bool src_locked = false; // mapped file locked for this signal vector
+	cm_mapfile *map = NULL; // memory mapped file (file source)
+	t_bool src_ok; // sample source available
+	long ambi_chans = (x->attr_order + 1) * (x->attr_order + 1); // number of ambisonic channels
+	double ambi_frame[AMBI_CHANS]; // ambisonic channels of the current output frame
+	double grain_sample; // current grain sample (ambisonic mode)
+	double *ambi_coef; // coefficients of the current grain (ambisonic mode)
 	
 	// OUTLETS
 	t_double *out_left 	= (t_double *)outs[0]; // assign pointer to left output
-	t_double *out_right = (t_double *)outs[1]; // assign pointer to right output
+	t_double *out_right = (t_double *)outs[x->mc_chans[0] < numouts ? x->mc_chans[0] : 0]; // assign pointer to right output (first channel of the right outlet)
 	
 	
 	// BUFFER REFERENCES
@@ -469,8 +1472,99 @@ void cmbuffercloud_perform64(t_cmbuffercloud *x, t_object *dsp64, double **ins,
 	t_buffer_obj *buffer_obj = buffer_ref_getobject(x->buffer_ref);
 	t_buffer_obj *w_buffer_obj = buffer_ref_getobject(x->w_buffer_ref);
 	float *b_sample = buffer_locksamples(buffer_obj);
-	float *w_sample = buffer_locksamples(w_buffer_obj);
+	float *w_sample = NULL; // the window buffer~ is only locked while the window table is not available
+	
+	// WINDOW TABLE (never wait for the main thread, the window buffer~ is read while the table is replaced)
+	wintable_locked = (systhread_mutex_trylock(x->wintable_mutex) == 0);
+	if (wintable_locked) {
+		wintable = x->wintable;
+	}
+	if (wintable == NULL) {
+		w_sample = buffer_locksamples(w_buffer_obj);
+	}
+	
+	// SPEAKER GAIN TABLE (never wait for the main thread, new grains are skipped while the table is replaced)
+	if (spk_mode) {
+		spk_locked = (systhread_mutex_trylock(x->spk_mutex) == 0);
+	}
+	// HRTF CONVOLUTION STATE (same as above, grains are skipped and the output is silent while the state is replaced)
+	if (bin_mode) {
+		hrtf_locked = (systhread_mutex_trylock(x->hrtf_mutex) == 0);
+		if (hrtf_locked) {
+			hrtf = x->hrtf;
+		}
+	}
+	
+	// MEMORY MAPPED FILE, STREAMING FILE AND COMPRESSED STORE (same as above, no grains are triggered while the source is replaced)
+	if (file_mode || stream_mode || store_mode || corpus_mode) {
+		src_locked = (systhread_mutex_trylock(x->src_mutex) == 0);
+		if (src_locked) {
+			map = file_mode ? x->map : NULL;
+			stream = stream_mode ? x->stream : NULL;
+			store = store_mode ? x->store : NULL;
+			corpus = (corpus_mode && x->corpus_count) ? x->corpus : NULL;
+		}
+		if (map) { // the file replaces the sample buffer~ information
+			x->b_framecount = map->framecount;
+			x->b_channelcount = map->channelcount;
+			x->b_m_sr = map->samplerate * 0.001;
+			x->sr_ratio = x->b_m_sr / x->m_sr;
+		}
+		else if (stream) {
+			x->b_framecount = stream->fmt.framecount;
+			x->b_channelcount = stream->fmt.channelcount;
+			x->b_m_sr = stream->fmt.samplerate * 0.001;
+			x->sr_ratio = x->b_m_sr / x->m_sr;
+			stream->generation++;
+			if (x->stream_deferred) { // retry the deferred grain at the start of the signal vector
+				x->bang_trigger = true;
+			}
+		}
+		else if (store) {
+			x->b_framecount = store->framecount;
+			x->b_channelcount = store->channelcount;
+			x->b_m_sr = store->samplerate * 0.001;
+			x->sr_ratio = x->b_m_sr / x->m_sr;
+		}
+		else if (corpus && x->corpus_modified) { // refresh the cached buffer information of the corpus table
+			x->corpus_modified = false;
+			for (i = 0; i < x->corpus_count; i++) {
+				corpus_obj = buffer_ref_getobject(corpus[i].ref);
+				corpus[i].framecount = corpus_obj ? buffer_getframecount(corpus_obj) : 0;
+				corpus[i].channelcount = corpus_obj ? buffer_getchannelcount(corpus_obj) : 0;
+				corpus[i].m_sr = corpus_obj ? buffer_getsamplerate(corpus_obj) * 0.001 : 0.0;
+			}
+		}
+		src_ok = (map || stream || store || corpus);
+	}
+	else {
+		src_ok = (b_sample != NULL);
+		// ANALYSIS INDICES OF THE SAMPLE BUFFER~ (grains are not snapped while the indices are replaced)
+		if (x->onset_mode || x->zero_mode || x->attr_descriptors || x->attr_resample || x->attr_psola) {
+			index_locked = (systhread_mutex_trylock(x->index_mutex) == 0);
+		}
+		// RESAMPLED COPY (replaces the sample buffer~ while the indices are locked, the indices are built from the copy)
+		if (index_locked && x->resampled && b_sample) {
+			b_sample = x->resampled->samples;
+			x->b_framecount = x->resampled->framecount;
+			x->b_channelcount = x->resampled->channelcount;
+			x->b_m_sr = x->resampled->samplerate * 0.001;
+			x->sr_ratio = x->b_m_sr / x->m_sr;
+			x->resampled_active = true;
+		}
+		else if (x->resampled_active && buffer_obj) {
+			x->b_framecount = buffer_getframecount(buffer_obj);
+			x->b_channelcount = buffer_getchannelcount(buffer_obj);
+			x->b_m_sr = buffer_getsamplerate(buffer_obj) * 0.001;
+			x->sr_ratio = x->b_m_sr / x->m_sr;
+			x->resampled_active = false;
+		}
+	}
 	
+	// OUTLET CHANNEL CHECK (the dsp chain is rebuilt after the number of output channels has changed)
+	if (numouts != x->mc_chans[0] + x->mc_chans[1]) {
+		goto zero;
+	}
 	
 	// CLOUDSIZE - MEMORY RESIZE
 	if (x->grains_count == 0 && x->resize_request) {
@@ -503,7 +1597,7 @@ void cmbuffercloud_perform64(t_cmbuffercloud *x, t_object *dsp64, double **ins,
 	}
 	
 	// BUFFER CHECKS
-	if (!b_sample || !w_sample) { // if the sample buffer does not exist
+	if ((!b_sample && !file_mode && !stream_mode && !store_mode && !corpus_mode) || (!wintable && !w_sample)) { // if the sample buffer does not exist
 		goto zero;
 	}
 	
@@ -557,9 +1651,38 @@ void cmbuffercloud_perform64(t_cmbuffercloud *x, t_object *dsp64, double **ins,
 		x->grain_params[8] = x->grain_params[9];
 	}
 	
+	// scan mode: the playhead wraps around start min to start max (the whole source if start max is not larger)
+	if (x->attr_scan) {
+		scan_hop = x->attr_hop * x->m_sr;
+		scan_step = x->attr_stretch * x->sr_ratio;
+		x->scan_lo = x->grain_params[0];
+		x->scan_hi = x->grain_params[1] > x->grain_params[0] ? x->grain_params[1] : x->b_framecount;
+		if (x->scan_reset) { // the first grain is triggered immediately
+			x->scan_pos = x->scan_lo;
+			x->scan_timer = scan_hop;
+			x->scan_reset = false;
+		}
+	}
+	
+	// psola mode: grains are triggered every source period divided by the pitch instead of by the trigger input
+	psola_clock = (index_locked && x->attr_psola && x->marks_count && !x->attr_scan);
+	
+	// in speakers and ambisonic mode and with stereo buses, all grains are accumulated into the output channels
+	if (ambi_chans > x->mc_chans[0]) { // order may be higher than the outlet until the dsp chain is rebuilt
+		ambi_chans = x->mc_chans[0];
+	}
+	if (spk_mode || ambi_mode || (!spatial_mode && x->mc_chans[0] > 1)) { // stereo mode with more than one bus
+		for (k = 0; k < numouts; k++) {
+			for (frame = 0; frame < sampleframes; frame++) {
+				outs[k][frame] = 0.0;
+			}
+		}
+	}
+	
 	/************************************************************************************************************************/
 	// DSP LOOP
 	while (n--) {
+		frame = sampleframes - 1 - n;
 		
 		// detect playback position if start-min/start-max have been modified
 		x->playback_timer++;
@@ -577,14 +1700,40 @@ void cmbuffercloud_perform64(t_cmbuffercloud *x, t_object *dsp64, double **ins,
 		}
 		
 		// check for preview request
-		if (x->preview_request && !x->grains_count) {
+		if (x->preview_request && !x->grains_count && src_ok) {
 			preview_pos = x->preview_playhead++ * x->sr_ratio;
+			ch_left = (x->attr_channel - 1) % x->b_channelcount;
 			if (x->b_channelcount > 1 ) {
-				outsample_left = cm_lininterp(preview_pos, b_sample, x->b_channelcount, x->b_framecount, 0);
-				outsample_right = cm_lininterp(preview_pos, b_sample, x->b_channelcount, x->b_framecount, 1);
+				if (map) {
+					outsample_left = cm_mapinterp(map, preview_pos, ch_left);
+					outsample_right = cm_mapinterp(map, preview_pos, (ch_left + 1) % x->b_channelcount);
+				}
+				else if (stream) {
+					outsample_left = cm_streaminterp(stream, preview_pos, ch_left);
+					outsample_right = cm_streaminterp(stream, preview_pos, (ch_left + 1) % x->b_channelcount);
+				}
+				else if (store) {
+					outsample_left = cm_storeinterp(store, preview_pos, ch_left);
+					outsample_right = cm_storeinterp(store, preview_pos, (ch_left + 1) % x->b_channelcount);
+				}
+				else {
+					outsample_left = cm_lininterp(preview_pos, b_sample, x->b_channelcount, x->b_framecount, ch_left);
+					outsample_right = cm_lininterp(preview_pos, b_sample, x->b_channelcount, x->b_framecount, (ch_left + 1) % x->b_channelcount);
+				}
 			}
 			else {
-				b_read = cm_lininterp(preview_pos, b_sample, x->b_channelcount, x->b_framecount, 0);
+				if (map) {
+					b_read = cm_mapinterp(map, preview_pos, 0);
+				}
+				else if (stream) {
+					b_read = cm_streaminterp(stream, preview_pos, 0);
+				}
+				else if (store) {
+					b_read = cm_storeinterp(store, preview_pos, 0);
+				}
+				else {
+					b_read = cm_lininterp(preview_pos, b_sample, x->b_channelcount, x->b_framecount, 0);
+				}
 				outsample_left += b_read;
 				outsample_right += b_read;
 			}
@@ -599,7 +1748,34 @@ void cmbuffercloud_perform64(t_cmbuffercloud *x, t_object *dsp64, double **ins,
 		
 		tr_curr = *tr_sigin++; // get current trigger value
 		
-		if (x->attr_zero) {
+		if (x->attr_scan) {
+			// scan mode: the playhead advances at the stretch speed, grains are triggered at the hop interval
+			x->scan_pos = cmbuffercloud_scanwrap(x, x->scan_pos + scan_step);
+			x->scan_timer += 1.0;
+			if (x->scan_timer >= scan_hop) {
+				x->scan_timer -= scan_hop;
+				trigger = true;
+			}
+			else if (x->bang_trigger) {
+				trigger = true;
+				x->bang_trigger = false;
+			}
+		}
+		else if (psola_clock) {
+			x->psola_timer += 1.0;
+			if (x->psola_timer >= x->psola_hop) {
+				x->psola_timer -= x->psola_hop;
+				if (x->psola_timer >= 1.0) { // no grain has set the interval yet
+					x->psola_timer = 0.0;
+				}
+				trigger = true;
+			}
+			else if (x->bang_trigger) {
+				trigger = true;
+				x->bang_trigger = false;
+			}
+		}
+		else if (x->attr_zero) {
 			if (signbit(tr_curr) != signbit(x->tr_prev)) { // zero crossing from negative to positive
 				trigger = true;
 			}
@@ -620,7 +1796,7 @@ void cmbuffercloud_perform64(t_cmbuffercloud *x, t_object *dsp64, double **ins,
 		
 		/************************************************************************************************************************/
 		// IN CASE OF TRIGGER, LIMIT NOT MODIFIED AND GRAINS COUNT IN THE LEGAL RANGE (AVAILABLE SLOTS)
-		if (trigger && x->grains_count < x->cloudsize && !x->resize_request && !x->length_request && !x->preview_request && b_sample && w_sample) {
+		if (trigger && x->grains_count < x->cloudsize && !x->resize_request && !x->length_request && !x->preview_request && src_ok && (wintable || w_sample) && (!spk_mode || spk_locked) && (!bin_mode || hrtf)) {
 			trigger = false; // reset trigger
 			x->grains_count++; // increment grains_count
 			// FIND A FREE SLOT FOR THE NEW GRAIN
@@ -634,18 +1810,51 @@ void cmbuffercloud_perform64(t_cmbuffercloud *x, t_object *dsp64, double **ins,
 				i++;
 			}
 			
-			// randomize grain parameters
-			for (i = 0; i < 5; i++) {
-				// if currently processing randomized value for pitch (i == 2) and if pitchlist is active
-				if (i == 2 && x->pitchlist_active) {
-					// get random postition from pitchlist and write stored value
-					x->randomized[i] = x->pitchlist[(int)cm_random(&x->pitchlist_zero, &x->pitchlist_size)];
+			// select the corpus buffer of the grain: the cached buffer information replaces the sample buffer~ information
+			if (corpus) {
+				entry = &corpus[cmbuffercloud_grainsource(x)];
+				corpus_obj = buffer_ref_getobject(entry->ref);
+				corpus_sample = (corpus_obj && entry->framecount > 0) ? buffer_locksamples(corpus_obj) : NULL;
+				if (corpus_sample == NULL) {
+					// release the slot, the grain is skipped
+					x->cloud[slot].busy = false;
+					x->grains_count--;
+					goto grain_deferred;
 				}
-				else {
-					r = i * 2;
-					x->randomized[i] = cm_random(&x->grain_params[r], &x->grain_params[r+1]);
+				x->b_framecount = entry->framecount;
+				x->b_channelcount = entry->channelcount;
+				x->b_m_sr = entry->m_sr;
+				x->sr_ratio = x->b_m_sr / x->m_sr;
+				x->grain_params[0] = (x->connect_status[0] ? *ins[1] : x->object_inlets[0]) * x->b_m_sr; // start min
+				x->grain_params[1] = (x->connect_status[1] ? *ins[2] : x->object_inlets[1]) * x->b_m_sr; // start max
+			}
+			
+			// randomize grain parameters (a deferred grain is retried with its stored parameters)
+			if (x->stream_deferred) {
+				for (i = 0; i < 5; i++) {
+					x->randomized[i] = x->deferred_params[i];
+				}
+				x->stream_deferred = false;
+			}
+			else {
+				for (i = 0; i < 5; i++) {
+					// if currently processing randomized value for pitch (i == 2) and if pitchlist is active
+					if (i == 2 && x->pitchlist_active) {
+						// get random postition from pitchlist and write stored value
+						x->randomized[i] = x->pitchlist[(int)cm_random(&x->pitchlist_zero, &x->pitchlist_size)];
+					}
+					else {
+						r = i * 2;
+						x->randomized[i] = cm_random(&x->grain_params[r], &x->grain_params[r+1]);
+					}
 				}
 			}
+			for (i = 0; i < 5; i++) {
+				x->deferred_params[i] = x->randomized[i];
+			}
+			
+			// assign the output bus from the randomized parameters
+			x->cloud[slot].bus = cmbuffercloud_grainbus(x);
 			
 			// check for parameter sanity of the length value
 			if (x->randomized[1] < MIN_GRAINLENGTH * x->m_sr) {
@@ -701,10 +1910,125 @@ void cmbuffercloud_perform64(t_cmbuffercloud *x, t_object *dsp64, double **ins,
 			if (start < 0) {
 				start = 0;
 			}
+			// scan mode: the start is the playhead position, or the position aligned to the previous grain by the alignment thread
+			scan_grain = false;
+			if (x->attr_scan) {
+				start = (long)x->scan_pos;
+				if (x->wsola && !corpus && systhread_mutex_trylock(x->wsola_mutex) == 0) {
+					if (x->wsola->state == WSOLA_DONE) { // a result of a job that was posted for another position is dropped
+						if (labs(x->wsola->target - start) <= x->wsola->range) {
+							start = x->wsola->result;
+						}
+						x->wsola->state = WSOLA_IDLE;
+					}
+					systhread_mutex_unlock(x->wsola_mutex);
+				}
+				if (start > x->b_framecount - pitch_length) {
+					start = x->b_framecount - pitch_length;
+				}
+				if (start < 0) {
+					start = 0;
+				}
+				scan_grain = true;
+			}
+			// select the start position from the frames nearest to the target descriptors, or move it to an onset
+			else if (index_locked && x->attr_descriptors && x->desctree && (desc_start = cmbuffercloud_descstart(x)) >= 0) {
+				start = desc_start;
+				if (start > x->b_framecount - pitch_length) {
+					start = x->b_framecount - pitch_length;
+				}
+			}
+			else if (index_locked && x->onset_mode && x->onsets_count) {
+				start = cmbuffercloud_onsetstart(x, start);
+				if (start > x->b_framecount - pitch_length) {
+					start = x->b_framecount - pitch_length;
+				}
+				if (start < 0) {
+					start = 0;
+				}
+			}
+			// pitch synchronous grain: centered on the pitch mark nearest to the start, the length is a number of periods. the grain
+			// is read at the source rate (the formants are kept), the pitch only sets the interval to the next grain
+			psola_grain = false;
+			if (index_locked && x->attr_psola && x->marks_count && !scan_grain) {
+				k = cm_lowerbound(x->marks, x->marks_count, (double)(start + pitch_length / 2));
+				if (k == x->marks_count || (k > 0 && (start + pitch_length / 2) - x->marks[k - 1] < x->marks[k] - (start + pitch_length / 2))) {
+					k--;
+				}
+				smp_length = (long)((x->mark_periods[k] * x->attr_periods) / x->sr_ratio);
+				if (smp_length < MIN_GRAINLENGTH * x->m_sr) {
+					smp_length = MIN_GRAINLENGTH * x->m_sr;
+				}
+				else if (smp_length > x->grainlength * x->m_sr) {
+					smp_length = x->grainlength * x->m_sr;
+				}
+				pitch_length = smp_length * x->sr_ratio;
+				if (pitch_length > x->b_framecount) {
+					pitch_length = x->b_framecount;
+				}
+				x->cloud[slot].length = smp_length;
+				x->psola_hop = x->mark_periods[k] / x->randomized[2]; // the pitch includes the sample rate ratio
+				start = x->marks[k] - pitch_length / 2;
+				if (start > x->b_framecount - pitch_length) {
+					start = x->b_framecount - pitch_length;
+				}
+				if (start < 0) {
+					start = 0;
+				}
+				psola_grain = true;
+			}
+			// streaming source: chunks that are not cached are requested from the streaming thread
+			if (stream && cm_streamrequest(stream, start, pitch_length + 2)) {
+				x->stream_underruns++;
+				if (x->attr_underrun == ps_defer) {
+					// release the slot, the grain is retried with the same parameters at the next signal vector
+					x->cloud[slot].busy = false;
+					x->grains_count--;
+					x->stream_deferred = true;
+					goto grain_deferred;
+				}
+			}
+			// compute grain direction: random pair from the direction list, or pan value -1 to 1 mapped to azimuth 180 to -180 degrees
+			if (x->dirlist_active) {
+				r = (long)cm_random(&x->dirlist_zero, &x->dirlist_size);
+				azimuth = x->dirlist[r * 2];
+				elevation = x->dirlist[(r * 2) + 1];
+			}
+			else {
+				azimuth = x->randomized[3] * -180.0;
+				elevation = cm_random(&x->elevation_min, &x->elevation_max);
+			}
 			// compute pan values
-			cm_panning(&panstruct, &x->randomized[3], x); // calculate pan values in panstruct
-			pan_left = panstruct.left;
-			pan_right = panstruct.right;
+			if (ambi_mode) {
+				// spherical harmonic coefficients are computed once per grain
+				cm_ambi_encode(x->cloud[slot].ambi_coef, azimuth, elevation, x->attr_order);
+				pan_left = 1.0;
+				pan_right = 1.0;
+			}
+			else if (bin_mode) {
+				// grains are summed into the bus of the nearest hrtf direction
+				x->cloud[slot].bucket = cm_hrtf_bucket(hrtf, azimuth, elevation);
+				pan_left = 1.0;
+				pan_right = 1.0;
+			}
+			else if (spk_mode) {
+				// gains are read from the speaker gain table
+				spk_entry = &x->spk_table[(((long)(((azimuth + 180.0) / 360.0) * SPK_AZSTEPS + 0.5)) % SPK_AZSTEPS) * SPK_ELSTEPS + (long)(((elevation + 90.0) / 180.0) * (SPK_ELSTEPS - 1) + 0.5)];
+				x->cloud[slot].spk_count = 0;
+				for (k = 0; k < spk_entry->count; k++) {
+					if (spk_entry->spk[k] < x->mc_chans[0]) { // layout may be larger than the outlet until the dsp chain is rebuilt
+						x->cloud[slot].spk[x->cloud[slot].spk_count] = spk_entry->spk[k];
+						x->cloud[slot].spk_gain[x->cloud[slot].spk_count++] = spk_entry->gain[k];
+					}
+				}
+				pan_left = 1.0;
+				pan_right = 1.0;
+			}
+			else {
+				cm_panning(&panstruct, &x->randomized[3], x); // calculate pan values in panstruct
+				pan_left = panstruct.left;
+				pan_right = panstruct.right;
+			}
 			// write gain value
 			gain = x->randomized[4];
 			
@@ -735,9 +2059,76 @@ void cmbuffercloud_perform64(t_cmbuffercloud *x, t_object *dsp64, double **ins,
 				}
 			}
 			
-			// grain is written into memory here
+			// select the source channel(s) of the grain
+			ch_left = cmbuffercloud_grainchannel(x);
+			stereo_grain = (x->b_channelcount > 1 && x->attr_stereo && !spatial_mode); // spatial output modes render mono grains
+			ch_right = stereo_grain ? (ch_left + 1) % x->b_channelcount : ch_left;
+			
+			// move the start (and end) of the grain to zero crossings of the (left) source channel
+			if (index_locked && x->zero_mode && !psola_grain && !scan_grain && ch_left < x->zeros_channels && x->zeros_count[ch_left]) {
+				zeros = x->zeros[ch_left];
+				zeros_count = x->zeros_count[ch_left];
+				start = cm_nearest(zeros, zeros_count, (double)start);
+				if (start > x->b_framecount - pitch_length) { // the start stays on a crossing: the last one that leaves room for the grain
+					k = cm_lowerbound(zeros, zeros_count, (double)(x->b_framecount - pitch_length + 1)) - 1;
+					start = (k >= 0) ? zeros[k] : x->b_framecount - pitch_length;
+				}
+				// the end moves to the last crossing before the end, the grain only gets shorter
+				if (x->zero_mode == 2) {
+					k = cm_lowerbound(zeros, zeros_count, (double)(start + pitch_length)) - 1;
+					if (k >= 0 && zeros[k] > start && (double)(zeros[k] - start) / x->randomized[2] >= MIN_GRAINLENGTH * x->m_sr) {
+						pitch_length = zeros[k] - start;
+						smp_length = (long)(pitch_length / x->randomized[2]);
+						x->cloud[slot].length = smp_length;
+						if (x->cloud[slot].reverse) {
+							x->cloud[slot].pos = x->cloud[slot].length - 1;
+						}
+					}
+				}
+			}
+			
+			// copy the source frames read by the grain into contiguous memory (planar read path)
+			if (corpus) { // the corpus buffer is only locked while it is read
+				cm_deinterleave(x->scratch_left, corpus_sample, x->b_channelcount, x->b_framecount, ch_left, start, pitch_length + 2);
+				if (stereo_grain) {
+					cm_deinterleave(x->scratch_right, corpus_sample, x->b_channelcount, x->b_framecount, ch_right, start, pitch_length + 2);
+				}
+				buffer_unlocksamples(corpus_obj);
+			}
+			else {
+				cmbuffercloud_sourceread(x, x->scratch_left, b_sample, map, stream, store, ch_left, start, pitch_length + 2);
+				if (stereo_grain) {
+					cmbuffercloud_sourceread(x, x->scratch_right, b_sample, map, stream, store, ch_right, start, pitch_length + 2);
+				}
+			}
+			
+			// scan mode: the next grain is aligned by the alignment thread while the current grain plays (corpus buffers change per grain)
+			if (scan_grain && x->wsola && !corpus) {
+				cmbuffercloud_wsolapost(x, b_sample, map, stream, store, ch_left, start, scan_hop);
+			}
+			
+			// GET THE GRAIN SAMPLES FROM THE PLANAR SOURCE ARRAYS (unity, integer and 1/2 pitch ratios without interpolation)
+			cm_pitchread(x->cloud[slot].left, x->scratch_left, smp_length, pitch_length, x->attr_sinterp);
+			if (stereo_grain) {
+				cm_pitchread(x->cloud[slot].right, x->scratch_right, smp_length, pitch_length, x->attr_sinterp);
+			}
+			
+			// grain is written into memory here (the window table is read with a phase increment of 2^64 / grain length, no division per sample)
+			w_phase = 0;
+			w_inc = (t_uint64)(18446744073709549568.0 / (double)smp_length); // largest double below 2^64
 			for (readpos = 0; readpos < smp_length; readpos++) {
-				if (x->attr_winterp) {
+				if (wintable) {
+					index = (w_phase >> wintable->shift) & wintable->mask;
+					if (x->attr_winterp) {
+						w_frac = (w_phase & wintable->fracmask) * wintable->fracscale;
+						w_read = wintable->window[index] + w_frac * (wintable->window[index + 1] - wintable->window[index]);
+					}
+					else {
+						w_read = wintable->window[index];
+					}
+					w_phase += w_inc;
+				}
+				else if (x->attr_winterp) {
 					distance = ((double)readpos / (double)smp_length) * (double)x->w_framecount;
 					w_read = cm_lininterp(distance, w_sample, x->w_channelcount, x->w_framecount, 0);
 				}
@@ -745,59 +2136,50 @@ void cmbuffercloud_perform64(t_cmbuffercloud *x, t_object *dsp64, double **ins,
 					index = (long)(((double)readpos / (double)smp_length) * (double)x->w_framecount);
 					w_read = w_sample[index];
 				}
-				// GET GRAIN SAMPLE FROM SAMPLE BUFFER
-				distance = start + (((double)readpos / (double)smp_length) * (double)pitch_length);
 				
-				if (x->b_channelcount > 1 && x->attr_stereo) { // if more than one channel
-					if (x->attr_sinterp) {
-						// get interpolated sample
-						x->cloud[slot].left[readpos] = ((cm_lininterp(distance, b_sample, x->b_channelcount, x->b_framecount, 0) * w_read) * pan_left) * gain;
-						x->cloud[slot].right[readpos] = ((cm_lininterp(distance, b_sample, x->b_channelcount, x->b_framecount, 1) * w_read) * pan_right) * gain;
-					}
-					else {
-						// get non-interpolated sample
-						x->cloud[slot].left[readpos] = ((b_sample[(long)distance * x->b_channelcount] * w_read) * pan_left) * gain;
-						x->cloud[slot].right[readpos] = ((b_sample[((long)distance * x->b_channelcount) + 1] * w_read) * pan_right) * gain;
-					}
+				if (stereo_grain) { // if more than one channel
+					x->cloud[slot].left[readpos] = ((x->cloud[slot].left[readpos] * w_read) * pan_left) * gain;
+					x->cloud[slot].right[readpos] = ((x->cloud[slot].right[readpos] * w_read) * pan_right) * gain;
 				}
 				else { // if only one channel
-					if (x->attr_sinterp) {
-						b_read = cm_lininterp(distance, b_sample, x->b_channelcount, x->b_framecount, 0) * w_read; // get interpolated sample
-						x->cloud[slot].left[readpos] = (b_read * pan_left) * gain;
+					b_read = x->cloud[slot].left[readpos] * w_read;
+					x->cloud[slot].left[readpos] = (b_read * pan_left) * gain;
+					if (!spatial_mode) {
 						x->cloud[slot].right[readpos] = (b_read * pan_right) * gain;
 					}
-					else {
-						x->cloud[slot].left[readpos] = ((b_sample[(long)distance * x->b_channelcount] * w_read) * pan_left) * gain;
-						x->cloud[slot].right[readpos] = ((b_sample[(long)distance * x->b_channelcount] * w_read) * pan_right) * gain;
-					}
+				}
+			}
+			
+			// filter the grain (cutoff is randomized on an exponential scale)
+			if (x->filter_type) {
+				cutoff = x->cutoff_min * pow(x->cutoff_max / x->cutoff_min, cm_random(&rnd_zero, &rnd_one));
+				if (cutoff > cutoff_limit) {
+					cutoff = cutoff_limit;
+				}
+				q = cm_random(&x->q_min, &x->q_max);
+				cm_svf(x->cloud[slot].left, smp_length, cutoff, q, x->m_sr * 1000.0, x->filter_type);
+				if (!spatial_mode) {
+					cm_svf(x->cloud[slot].right, smp_length, cutoff, q, x->m_sr * 1000.0, x->filter_type);
 				}
 			}
 		}
+grain_deferred:
 		
 		/************************************************************************************************************************/
 		// CONTINUE WITH THE PLAYBACK ROUTINE
 		
 		// playback only if there are grains to play
-		if (x->grains_count) {
-			for (i = 0; i < x->cloudsize; i++) {
-				if (x->cloud[i].busy) {
-					if (x->cloud[i].reverse) {
-						r = x->cloud[i].pos--;
-						outsample_left += x->cloud[i].left[r];
-						outsample_right += x->cloud[i].right[r];
-						if (x->cloud[i].pos < 0) {
-							x->cloud[i].busy = false;
-							x->grains_count--;
-							if (x->grains_count < 0) {
-								x->grains_count = 0;
-							}
+		if (bin_mode) {
+			// binaural mode: grains are summed into their bucket bus, the buses are convolved once per block
+			if (x->grains_count) {
+				bus = hrtf ? hrtf->bus_in + hrtf->pos : NULL;
+				for (i = 0; i < x->cloudsize; i++) {
+					if (x->cloud[i].busy) {
+						r = x->cloud[i].reverse ? x->cloud[i].pos-- : x->cloud[i].pos++;
+						if (bus && x->cloud[i].bucket < hrtf->buckets) { // buckets may have changed while the grain was playing
+							bus[x->cloud[i].bucket * CONV_BLOCK] += x->cloud[i].left[r];
 						}
-					}
-					else {
-						r = x->cloud[i].pos++;
-						outsample_left += x->cloud[i].left[r];
-						outsample_right += x->cloud[i].right[r];
-						if (x->cloud[i].pos == x->cloud[i].length) {
+						if ((x->cloud[i].reverse && x->cloud[i].pos < 0) || (!x->cloud[i].reverse && x->cloud[i].pos == x->cloud[i].length)) {
 							x->cloud[i].pos = 0;
 							x->cloud[i].busy = false;
 							x->grains_count--;
@@ -808,13 +2190,101 @@ void cmbuffercloud_perform64(t_cmbuffercloud *x, t_object *dsp64, double **ins,
 					}
 				}
 			}
+			// the convolution runs with a latency of one block, also while no grains are playing (reverb tail)
+			if (hrtf) {
+				outsample_left += hrtf->out_left[hrtf->pos];
+				outsample_right += hrtf->out_right[hrtf->pos];
+				if (++hrtf->pos == CONV_BLOCK) {
+					cm_hrtf_process(hrtf);
+					hrtf->pos = 0;
+				}
+			}
 		}
-		
-		/************************************************************************************************************************/
+		else if (x->grains_count && ambi_mode) {
+			// ambisonic mode: all channels of a grain are accumulated into a contiguous frame (vectorized across channels)
+			for (k = 0; k < ambi_chans; k++) {
+				ambi_frame[k] = 0.0;
+			}
+			for (i = 0; i < x->cloudsize; i++) {
+				if (x->cloud[i].busy) {
+					r = x->cloud[i].reverse ? x->cloud[i].pos-- : x->cloud[i].pos++;
+					grain_sample = x->cloud[i].left[r];
+					ambi_coef = x->cloud[i].ambi_coef;
+					for (k = 0; k < ambi_chans; k++) {
+						ambi_frame[k] += ambi_coef[k] * grain_sample;
+					}
+					if ((x->cloud[i].reverse && x->cloud[i].pos < 0) || (!x->cloud[i].reverse && x->cloud[i].pos == x->cloud[i].length)) {
+						x->cloud[i].pos = 0;
+						x->cloud[i].busy = false;
+						x->grains_count--;
+						if (x->grains_count < 0) {
+							x->grains_count = 0;
+						}
+					}
+				}
+			}
+			for (k = 0; k < ambi_chans; k++) {
+				outs[k][frame] = ambi_frame[k];
+			}
+		}
+		else if (x->grains_count && spk_mode) {
+			// speakers mode: every grain only touches its speakers with non-zero gain
+			for (i = 0; i < x->cloudsize; i++) {
+				if (x->cloud[i].busy) {
+					r = x->cloud[i].reverse ? x->cloud[i].pos-- : x->cloud[i].pos++;
+					for (k = 0; k < x->cloud[i].spk_count; k++) {
+						outs[x->cloud[i].spk[k]][frame] += x->cloud[i].left[r] * x->cloud[i].spk_gain[k];
+					}
+					if ((x->cloud[i].reverse && x->cloud[i].pos < 0) || (!x->cloud[i].reverse && x->cloud[i].pos == x->cloud[i].length)) {
+						x->cloud[i].pos = 0;
+						x->cloud[i].busy = false;
+						x->grains_count--;
+						if (x->grains_count < 0) {
+							x->grains_count = 0;
+						}
+					}
+				}
+			}
+		}
+		else if (x->grains_count) {
+			for (i = 0; i < x->cloudsize; i++) {
+				if (x->cloud[i].busy) {
+					r = x->cloud[i].reverse ? x->cloud[i].pos-- : x->cloud[i].pos++;
+					out_bus = x->cloud[i].bus < x->mc_chans[0] ? x->cloud[i].bus : 0; // number of buses may have changed while the grain was playing
+					if (out_bus == 0) {
+						outsample_left += x->cloud[i].left[r];
+						outsample_right += x->cloud[i].right[r];
+					}
+					else {
+						outs[out_bus][frame] += x->cloud[i].left[r];
+						outs[x->mc_chans[0] + out_bus][frame] += x->cloud[i].right[r];
+					}
+					if ((x->cloud[i].reverse && x->cloud[i].pos < 0) || (!x->cloud[i].reverse && x->cloud[i].pos == x->cloud[i].length)) {
+						x->cloud[i].pos = 0;
+						x->cloud[i].busy = false;
+						x->grains_count--;
+						if (x->grains_count < 0) {
+							x->grains_count = 0;
+						}
+					}
+				}
+			}
+		}
+		
+		/************************************************************************************************************************/
 		x->tr_prev = tr_curr; // store current trigger value in object structure
 		
-		*out_left++ = outsample_left; // write added sample values to left output vector
-		*out_right++ = outsample_right; // write added sample values to right output vector
+		if (ambi_mode) {
+			out_left[frame] += (outsample_left + outsample_right) * 0.5; // preview playback on the omnidirectional channel
+		}
+		else if (spk_mode) {
+			out_left[frame] += outsample_left; // preview playback on the first two speakers
+			outs[x->mc_chans[0] > 1 ? 1 : 0][frame] += outsample_right;
+		}
+		else {
+			*out_left++ = outsample_left; // write added sample values to left output vector
+			*out_right++ = outsample_right; // write added sample values to right output vector
+		}
 		
 		outsample_left = 0.0;
 		outsample_right = 0.0;
@@ -823,17 +2293,57 @@ void cmbuffercloud_perform64(t_cmbuffercloud *x, t_object *dsp64, double **ins,
 	/************************************************************************************************************************/
 	// STORE UPDATED RUNNING VALUES INTO THE OBJECT STRUCTURE
 	buffer_unlocksamples(buffer_obj);
-	buffer_unlocksamples(w_buffer_obj);
+	if (w_sample) {
+		buffer_unlocksamples(w_buffer_obj);
+	}
+	if (wintable_locked) {
+		systhread_mutex_unlock(x->wintable_mutex);
+	}
+	if (spk_locked) {
+		systhread_mutex_unlock(x->spk_mutex);
+	}
+	if (hrtf_locked) {
+		systhread_mutex_unlock(x->hrtf_mutex);
+	}
+	if (src_locked) {
+		systhread_mutex_unlock(x->src_mutex);
+	}
+	if (index_locked) {
+		systhread_mutex_unlock(x->index_mutex);
+	}
+	if (x->stream_underruns != x->stream_underruns_out) { // send the number of stream underruns to the status outlet
+		x->stream_underruns_out = x->stream_underruns;
+		atom_setlong(&underrun_atom, x->stream_underruns);
+		outlet_anything(x->status_out, gensym("underruns"), 1, &underrun_atom);
+	}
 	outlet_int(x->grains_count_out, x->grains_count); // send number of currently playing grains to the outlet
 	return;
 	
 zero:
-	while (n--) {
-		*out_left++ = 0.0;
-		*out_right++ = 0.0;
+	for (k = 0; k < numouts; k++) {
+		for (frame = 0; frame < sampleframes; frame++) {
+			outs[k][frame] = 0.0;
+		}
 	}
 	buffer_unlocksamples(buffer_obj);
-	buffer_unlocksamples(w_buffer_obj);
+	if (w_sample) {
+		buffer_unlocksamples(w_buffer_obj);
+	}
+	if (wintable_locked) {
+		systhread_mutex_unlock(x->wintable_mutex);
+	}
+	if (spk_locked) {
+		systhread_mutex_unlock(x->spk_mutex);
+	}
+	if (hrtf_locked) {
+		systhread_mutex_unlock(x->hrtf_mutex);
+	}
+	if (src_locked) {
+		systhread_mutex_unlock(x->src_mutex);
+	}
+	if (index_locked) {
+		systhread_mutex_unlock(x->index_mutex);
+	}
 	return; // THIS RETURN WAS MISSING FOR A LONG, LONG TIME. MAYBE THIS HELPS WITH STABILITY!?
 }
 
@@ -882,10 +2392,26 @@ void cmbuffercloud_assist(t_cmbuffercloud *x, void *b, long msg, long arg, char
 	else if (msg == ASSIST_OUTLET) {
 		switch (arg) {
 			case 0:
-				snprintf_zero(dst, 256, "(signal) output ch1");
+				if (x->attr_outmode == ps_speakers) {
+					snprintf_zero(dst, 256, "(multichannel signal) speaker outputs");
+				}
+				else if (x->attr_outmode == ps_ambisonic) {
+					snprintf_zero(dst, 256, "(multichannel signal) ambisonic outputs (ACN/SN3D)");
+				}
+				else if (x->attr_outmode == ps_stereo && x->attr_buses > 1) {
+					snprintf_zero(dst, 256, "(multichannel signal) output ch1 of all buses");
+				}
+				else {
+					snprintf_zero(dst, 256, "(signal) output ch1");
+				}
 				break;
 			case 1:
-				snprintf_zero(dst, 256, "(signal) output ch2");
+				if (x->attr_outmode == ps_stereo && x->attr_buses > 1) {
+					snprintf_zero(dst, 256, "(multichannel signal) output ch2 of all buses");
+				}
+				else {
+					snprintf_zero(dst, 256, "(signal) output ch2");
+				}
 				break;
 			case 2:
 				snprintf_zero(dst, 256, "(int) current grain count");
@@ -913,6 +2439,69 @@ void cmbuffercloud_free(t_cmbuffercloud *x) {
 	}
 	sysmem_freeptr(x->cloud);
 	sysmem_freeptr(x->pitchlist);
+	sysmem_freeptr(x->chanlist);
+	sysmem_freeptr(x->spk_azimuth);
+	sysmem_freeptr(x->spk_elevation);
+	sysmem_freeptr(x->spk_table);
+	sysmem_freeptr(x->dirlist);
+	if (x->spk_mutex) {
+		systhread_mutex_free(x->spk_mutex);
+	}
+	cm_hrtf_free(x->hrtf);
+	if (x->hrtf_mutex) {
+		systhread_mutex_free(x->hrtf_mutex);
+	}
+	if (x->prefetch_thread) {
+		unsigned int ret;
+		x->prefetch_quit = true;
+		systhread_join(x->prefetch_thread, &ret);
+	}
+	if (x->wsola_thread) {
+		unsigned int ret;
+		x->wsola_quit = true;
+		systhread_join(x->wsola_thread, &ret);
+	}
+	cm_wsola_free(x->wsola);
+	if (x->wsola_mutex) {
+		systhread_mutex_free(x->wsola_mutex);
+	}
+	cmbuffercloud_loadcancel(x);
+	if (x->load_qelem) {
+		qelem_free(x->load_qelem);
+	}
+	cm_mapfile_close(x->map);
+	cm_stream_close(x->stream);
+	cm_store_free(x->store);
+	cm_corpus_free(x->corpus, x->corpus_count);
+	sysmem_freeptr(x->corpusweights);
+	cmbuffercloud_analysiscancel(x);
+	if (x->analysis_qelem) {
+		qelem_free(x->analysis_qelem);
+	}
+	sysmem_freeptr(x->onsets);
+	cm_zeros_free(x->zeros, x->zeros_count, x->zeros_channels);
+	cm_desctree_free(x->desctree);
+	cm_resampled_free(x->resampled);
+	if (x->wintable_qelem) {
+		qelem_free(x->wintable_qelem);
+	}
+	cm_wintable_free(x->wintable);
+	if (x->wintable_mutex) {
+		systhread_mutex_free(x->wintable_mutex);
+	}
+	sysmem_freeptr(x->marks);
+	sysmem_freeptr(x->mark_periods);
+	if (x->index_mutex) {
+		systhread_mutex_free(x->index_mutex);
+	}
+	if (x->src_mutex) {
+		systhread_mutex_free(x->src_mutex);
+	}
+	if (x->map_mutex) {
+		systhread_mutex_free(x->map_mutex);
+	}
+	sysmem_freeptr(x->scratch_left);
+	sysmem_freeptr(x->scratch_right);
 	
 	sysmem_freeptr(x->object_inlets); // free memory allocated to the object inlets array
 	sysmem_freeptr(x->grain_params); // free memory allocated to the grain parameters array
@@ -1041,16 +2630,29 @@ t_max_err cmbuffercloud_notify(t_cmbuffercloud *x, t_symbol *s, t_symbol *msg, v
 	
 	if (msg == ps_buffer_modified) {
 		x->buffer_modified = true;
+		if (buffer_name == x->buffer_name) { // rebuild the analysis indices of the sample buffer~
+			cmbuffercloud_analysisrequest(x);
+			if (x->store && x->store_buffer) { // recompress the store, it holds the samples from before the modification
+				defer_low(x, (method)cmbuffercloud_dostore, ps_buffer_modified, 0, NULL);
+			}
+		}
 	}
 	if (buffer_name == x->w_buffer_name) { // check if calling object was the window buffer
+		if (msg == ps_buffer_modified) { // rewrite the window table
+			qelem_set(x->wintable_qelem);
+		}
 		return buffer_ref_notify(x->w_buffer_ref, s, msg, sender, data); // return with the calling buffer
 	}
 	else if (buffer_name == x->buffer_name) { // check if calling object was the sample buffer
 		return buffer_ref_notify(x->buffer_ref, s, msg, sender, data); // return with the calling buffer
 	}
-	else { // if calling object was none of the expected buffers
-		return MAX_ERR_NONE; // return generic MAX_ERR_NONE
+	for (long i = 0; i < x->corpus_count; i++) { // check if calling object was a corpus buffer
+		if (buffer_name == x->corpus[i].name) {
+			x->corpus_modified = true;
+			return buffer_ref_notify(x->corpus[i].ref, s, msg, sender, data);
+		}
 	}
+	return MAX_ERR_NONE; // if calling object was none of the expected buffers, return generic MAX_ERR_NONE
 }
 
 
@@ -1099,9 +2701,8 @@ void cmbuffercloud_doset(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
 		x->w_buffer_name = atom_getsym(av+1); // write buffer name into object structure
 		buffer_ref_set(x->buffer_ref, x->buffer_name);
 		buffer_ref_set(x->w_buffer_ref, x->w_buffer_name);
-		if (buffer_getchannelcount((t_object *)(buffer_ref_getobject(x->buffer_ref))) > 2) {
-			object_error((t_object *)x, "referenced sample buffer has more than 2 channels. using channels 1 and 2.");
-		}
+		cmbuffercloud_analysisrequest(x);
+		qelem_set(x->wintable_qelem);
 		if (buffer_getchannelcount((t_object *)(buffer_ref_getobject(x->w_buffer_ref))) > 1) {
 			object_error((t_object *)x, "referenced window buffer has more than 1 channel. expect strange results.");
 		}
@@ -1111,6 +2712,30 @@ void cmbuffercloud_doset(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
 	}
 }
 
+/************************************************************************************************************************/
+/* THE WINDOW TABLE QUEUE FUNCTION (MAIN THREAD): WRITES THE WINDOW TABLE FROM THE WINDOW BUFFER~ AND REPLACES THE TABLE */
+/************************************************************************************************************************/
+void cmbuffercloud_wintablequeue(t_cmbuffercloud *x) {
+	cm_wintable *wintable = NULL;
+	cm_wintable *wintable_old;
+	t_buffer_obj *w_buffer_obj = x->w_buffer_ref ? buffer_ref_getobject(x->w_buffer_ref) : NULL;
+	float *w_sample;
+	if (w_buffer_obj) {
+		w_sample = buffer_locksamples(w_buffer_obj);
+		if (w_sample) {
+			wintable = cm_wintable_new(w_sample, buffer_getchannelcount(w_buffer_obj), buffer_getframecount(w_buffer_obj), x->attr_winterp);
+			buffer_unlocksamples(w_buffer_obj);
+		}
+	}
+	// the perform routine reads the window buffer~ while the table is replaced
+	systhread_mutex_lock(x->wintable_mutex);
+	wintable_old = x->wintable;
+	x->wintable = wintable;
+	systhread_mutex_unlock(x->wintable_mutex);
+	cm_wintable_free(wintable_old);
+}
+
+
 /************************************************************************************************************************/
 /* THE BUFFER SET METHOD																								*/
 /************************************************************************************************************************/
@@ -1202,6 +2827,15 @@ t_bool cmbuffercloud_resize(t_cmbuffercloud *x) {
 			return false;
 		}
 	}
+	
+	// RESIZE THE PLANAR GRAIN SOURCE ARRAYS
+	x->scratch_left = (double *)sysmem_resizeptrclear(x->scratch_left, (((x->grainlength * x->m_sr) * MAX_PITCH) + 2) * sizeof(double));
+	x->scratch_right = (double *)sysmem_resizeptrclear(x->scratch_right, (((x->grainlength * x->m_sr) * MAX_PITCH) + 2) * sizeof(double));
+	if (x->scratch_left == NULL || x->scratch_right == NULL) {
+		object_error((t_object *)x, "out of memory");
+		x->resize_verify = false;
+		return false;
+	}
 	outlet_anything(x->status_out, gensym("resize"), 0, NIL);
 	return true;
 }
@@ -1245,138 +2879,4242 @@ void cmbuffercloud_pitchlist(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *a
 }
 
 /************************************************************************************************************************/
-/* THE PREVIEW METHOD                                                                                                   */
+/* THE CHANLIST METHOD                                                                                                  */
 /************************************************************************************************************************/
-void cmbuffercloud_preview(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
-	long arg = atom_getlong(av);
-	if (ac && av) {
-		if (arg < 1) {
-			x->preview_request = false;
-		}
-		else {
-			x->preview_playhead = 0;
-			x->preview_request = true;
+void cmbuffercloud_chanlist(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	long value;
+	if (ac < 1) {
+		object_error((t_object *)x, "minimum number of channel values is 1");
+	}
+	else if (ac <= CHANLIST) {
+		// write args into array (channels are supplied 1-based and stored 0-based)
+		for (int i = 0; i < ac; i++) {
+			value = atom_getlong(av+i);
+			if (value < 1) {
+				object_error((t_object *)x, "value of element %d (%ld) must be 1 or higher - setting value to 1", (i+1), value);
+				value = 1;
+			}
+			x->chanlist[i] = value - 1;
 		}
+		x->chanlist_size = (double)ac;
 	}
 	else {
-		object_error((t_object *)x, "argument required (preview start / stop)");
+		object_error((t_object *)x, "maximum number of channel values is %d", CHANLIST);
 	}
 }
 
+
 /************************************************************************************************************************/
-/* THE BANG METHOD                                                                                                      */
+/* THE GRAIN CHANNEL SELECTION FUNCTION                                                                                 */
 /************************************************************************************************************************/
-void cmbuffercloud_bang(t_cmbuffercloud *x) {
-	x->bang_trigger = true;
+// returns the 0-based source channel for a new grain, wrapped to the channel count of the sample buffer
+long cmbuffercloud_grainchannel(t_cmbuffercloud *x) {
+	long channel;
+	double chan_max = (double)x->b_channelcount;
+	if (x->attr_chanmode == gensym("random")) {
+		channel = (long)cm_random(&x->chanlist_zero, &chan_max);
+	}
+	else if (x->attr_chanmode == gensym("list") && x->chanlist_size > 0) {
+		channel = x->chanlist[(long)cm_random(&x->chanlist_zero, &x->chanlist_size)];
+	}
+	else {
+		channel = x->attr_channel - 1;
+	}
+	return channel % x->b_channelcount;
+}
+
+/************************************************************************************************************************/
+/* THE GRAIN OUTPUT BUS METHOD (AUDIO THREAD)                                                                           */
+/************************************************************************************************************************/
+long cmbuffercloud_grainbus(t_cmbuffercloud *x) {
+	long bus = 0;
+	long param;
+	double bus_zero = 0.0;
+	double bus_max = (double)x->attr_buses;
+	double range;
+	double rnd;
+	if (x->attr_buses < 2) {
+		return 0;
+	}
+	if (x->attr_busmode == gensym("weighted") && x->busweights_count > 0) {
+		// pick a bus from the cumulative weights
+		rnd = cm_random(&bus_zero, &x->busweights[x->busweights_count - 1]);
+		while (bus < x->busweights_count - 1 && rnd >= x->busweights[bus]) {
+			bus++;
+		}
+	}
+	else if (x->attr_busmode == gensym("range")) {
+		// the min/max range of the selected parameter is split into one equal part per bus
+		if (x->attr_busparam == gensym("start")) {
+			param = 0;
+		}
+		else if (x->attr_busparam == gensym("length")) {
+			param = 1;
+		}
+		else if (x->attr_busparam == gensym("pitch")) {
+			param = 2;
+		}
+		else if (x->attr_busparam == gensym("gain")) {
+			param = 4;
+		}
+		else {
+			param = 3;
+		}
+		range = x->grain_params[(param * 2) + 1] - x->grain_params[param * 2];
+		if (range > 0.0) {
+			bus = (long)(((x->randomized[param] - x->grain_params[param * 2]) / range) * bus_max);
+		}
+		else if (range < 0.0) { // min and max swapped
+			bus = (long)(((x->grain_params[param * 2] - x->randomized[param]) / -range) * bus_max);
+		}
+		if (bus < 0) {
+			bus = 0;
+		}
+	}
+	else {
+		bus = (long)cm_random(&bus_zero, &bus_max);
+	}
+	return bus < x->attr_buses ? bus : x->attr_buses - 1;
 }
 
 
 /************************************************************************************************************************/
-/* THE STEREO ATTRIBUTE SET METHOD                                                                                      */
+/* THE BUS WEIGHTS METHOD                                                                                               */
 /************************************************************************************************************************/
-t_max_err cmbuffercloud_stereo_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
-	if (ac && av) {
-		x->attr_stereo = atom_getlong(av)? 1 : 0;
+void cmbuffercloud_busweights(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	double weights[MAX_BUSES];
+	double sum = 0.0;
+	if (ac < 1 || ac > MAX_BUSES) {
+		object_error((t_object *)x, "between 1 and %d bus weights required", MAX_BUSES);
+		return;
 	}
-	return MAX_ERR_NONE;
+	for (int i = 0; i < ac; i++) {
+		weights[i] = atom_getfloat(av + i);
+		if (weights[i] < 0.0) {
+			object_error((t_object *)x, "bus weight %d must not be negative - setting to 0", (i+1));
+			weights[i] = 0.0;
+		}
+		sum += weights[i];
+		weights[i] = sum;
+	}
+	if (sum <= 0.0) {
+		object_error((t_object *)x, "at least one bus weight must be greater than 0");
+		return;
+	}
+	x->busweights_count = 0; // weights are not read while being written
+	for (int i = 0; i < ac; i++) {
+		x->busweights[i] = weights[i];
+	}
+	x->busweights_count = ac;
 }
 
 
 /************************************************************************************************************************/
-/* THE WINDOW INTERPOLATION ATTRIBUTE SET METHOD                                                                        */
+/* THE SPEAKERS METHOD                                                                                                  */
 /************************************************************************************************************************/
-t_max_err cmbuffercloud_winterp_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
-	if (ac && av) {
-		x->attr_winterp = atom_getlong(av)? 1 : 0;
+void cmbuffercloud_speakers(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	long i;
+	if (ac < 4 || ac % 2) {
+		object_error((t_object *)x, "azimuth/elevation pairs required for at least 2 speakers");
+	}
+	else if (ac / 2 > MAX_SPEAKERS) {
+		object_error((t_object *)x, "maximum number of speakers is %d", MAX_SPEAKERS);
+	}
+	else {
+		for (i = 0; i < ac / 2; i++) {
+			x->spk_azimuth[i] = atom_getfloat(av + (i * 2));
+			x->spk_elevation[i] = atom_getfloat(av + (i * 2) + 1);
+			if (x->spk_elevation[i] < -90.0 || x->spk_elevation[i] > 90.0) {
+				object_error((t_object *)x, "elevation of speaker %ld must be between -90 and 90 - clipping value", (i+1));
+				x->spk_elevation[i] = x->spk_elevation[i] < -90.0 ? -90.0 : 90.0;
+			}
+		}
+		x->spk_count = ac / 2;
+		cmbuffercloud_spktable_build(x);
+		if (x->attr_chans != x->spk_count) {
+			x->attr_chans = x->spk_count;
+			cmbuffercloud_dspchain_update(x);
+		}
 	}
-	return MAX_ERR_NONE;
 }
 
 
 /************************************************************************************************************************/
-/* THE SAMPLE INTERPOLATION ATTRIBUTE SET METHOD                                                                        */
+/* THE ELEVATION METHOD                                                                                                 */
 /************************************************************************************************************************/
-t_max_err cmbuffercloud_sinterp_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
-	if (ac && av) {
-		x->attr_sinterp = atom_getlong(av)? 1 : 0;
+void cmbuffercloud_elevation(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	double min, max;
+	if (ac == 2) {
+		min = atom_getfloat(av);
+		max = atom_getfloat(av + 1);
+		if (min < -90.0 || max > 90.0 || min > max) {
+			object_error((t_object *)x, "elevation values must be between -90 and 90 (min/max)");
+		}
+		else {
+			x->elevation_min = min;
+			x->elevation_max = max;
+		}
+	}
+	else {
+		object_error((t_object *)x, "%d arguments required (min/max elevation)", 2);
 	}
-	return MAX_ERR_NONE;
 }
 
 
 /************************************************************************************************************************/
-/* THE ZERO CROSSING ATTRIBUTE SET METHOD                                                                               */
+/* THE CUTOFF METHOD                                                                                                    */
 /************************************************************************************************************************/
-t_max_err cmbuffercloud_zero_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
-	if (ac && av) {
-		x->attr_zero = atom_getlong(av)? 1 : 0;
+void cmbuffercloud_cutoff(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	double min, max;
+	if (ac == 2) {
+		min = atom_getfloat(av);
+		max = atom_getfloat(av + 1);
+		if (min < MIN_CUTOFF || max > MAX_CUTOFF || min > max) {
+			object_error((t_object *)x, "cutoff values must be between %d and %d Hz (min/max)", (int)MIN_CUTOFF, (int)MAX_CUTOFF);
+		}
+		else {
+			x->cutoff_min = min;
+			x->cutoff_max = max;
+		}
+	}
+	else {
+		object_error((t_object *)x, "%d arguments required (min/max cutoff)", 2);
 	}
-	return MAX_ERR_NONE;
 }
 
+
 /************************************************************************************************************************/
-/* THE REVERSE ATTRIBUTE SET METHOD                                                                                     */
+/* THE Q METHOD                                                                                                         */
 /************************************************************************************************************************/
-t_max_err cmbuffercloud_reverse_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
-	if (ac && av) {
-		t_symbol *arg = atom_getsym(av);
-		t_symbol *off = gensym("off");
-		t_symbol *on = gensym("on");
-		t_symbol *random = gensym("random");
-		t_symbol *direction = gensym("direction");
-		if (arg != off && arg != on && arg != random && arg != direction) {
-			object_error((t_object *)x, "invalid attribute value");
-			object_error((t_object *)x, "valid attribute values are off | on | random | direction");
+void cmbuffercloud_q(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	double min, max;
+	if (ac == 2) {
+		min = atom_getfloat(av);
+		max = atom_getfloat(av + 1);
+		if (min < MIN_Q || max > MAX_Q || min > max) {
+			object_error((t_object *)x, "q values must be between %.1f and %.1f (min/max)", MIN_Q, MAX_Q);
 		}
 		else {
-			x->attr_reverse = arg;
+			x->q_min = min;
+			x->q_max = max;
 		}
 	}
-	return MAX_ERR_NONE;
+	else {
+		object_error((t_object *)x, "%d arguments required (min/max q)", 2);
+	}
 }
 
 
 /************************************************************************************************************************/
-/* CUSTOM FUNCTIONS																										*/
+/* THE DIRECTIONS METHOD                                                                                                */
 /************************************************************************************************************************/
-// constant power stereo function
-void cm_panning(cm_panstruct *panstruct, double *pos, t_cmbuffercloud *x) {
-	panstruct->left = x->root2ovr2 * (cos((*pos * x->piovr2) * 0.5) - sin((*pos * x->piovr2) * 0.5));
-	panstruct->right = x->root2ovr2 * (cos((*pos * x->piovr2) * 0.5) + sin((*pos * x->piovr2) * 0.5));
-	return;
+void cmbuffercloud_directions(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	double elevation;
+	if (ac == 1 && atom_getfloat(av) == 0) {
+		x->dirlist_active = false;
+	}
+	else if (ac < 2 || ac % 2) {
+		object_error((t_object *)x, "azimuth/elevation pairs required");
+	}
+	else if (ac / 2 <= DIRLIST) {
+		x->dirlist_active = false; // direction list is not read while being written
+		for (int i = 0; i < ac / 2; i++) {
+			elevation = atom_getfloat(av + (i * 2) + 1);
+			if (elevation < -90.0 || elevation > 90.0) {
+				object_error((t_object *)x, "elevation of direction %d must be between -90 and 90 - clipping value", (i+1));
+				elevation = elevation < -90.0 ? -90.0 : 90.0;
+			}
+			x->dirlist[i * 2] = atom_getfloat(av + (i * 2));
+			x->dirlist[(i * 2) + 1] = elevation;
+		}
+		x->dirlist_size = (double)(ac / 2);
+		x->dirlist_active = true;
+	}
+	else {
+		object_error((t_object *)x, "maximum number of directions is %d", DIRLIST);
+	}
 }
-// RANDOM NUMBER GENERATOR (USE POINTERS FOR MORE EFFICIENCY)
-double cm_random(double *min, double *max) {
-#ifdef MAC_VERSION
-	return *min + ((*max - *min) * (((double)arc4random_uniform(RANDMAX)) / (double)RANDMAX));
-#endif
-#ifdef WIN_VERSION
-	return *min + ((*max - *min) * ((double)(rand() % RANDMAX) / (double)RANDMAX));
-#endif
+
+
+/************************************************************************************************************************/
+/* THE HRTF METHOD (MAIN THREAD)                                                                                        */
+/************************************************************************************************************************/
+void cmbuffercloud_hrtf(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	t_symbol *name;
+	long length;
+	long buckets;
+	double azel[MAX_BUCKETS * 2];
+	t_buffer_ref *hrir_ref;
+	t_buffer_obj *hrir_obj;
+	float *hrir_sample;
+	long channelcount;
+	cm_hrtf *hrtf_new;
+	cm_hrtf *hrtf_old;
+	
+	if (ac < 4 || ac % 2 || atom_gettype(av) != A_SYM) {
+		object_error((t_object *)x, "hrtf requires a buffer~ name, the hrir length and azimuth/elevation pairs");
+		return;
+	}
+	name = atom_getsym(av);
+	length = atom_getlong(av + 1);
+	buckets = (ac - 2) / 2;
+	if (length < 1 || length > MAX_HRIRLENGTH) {
+		object_error((t_object *)x, "hrir length must be between 1 and %d", MAX_HRIRLENGTH);
+		return;
+	}
+	if (buckets > MAX_BUCKETS) {
+		object_error((t_object *)x, "maximum number of hrtf directions is %d", MAX_BUCKETS);
+		return;
+	}
+	for (int i = 0; i < buckets * 2; i++) {
+		azel[i] = atom_getfloat(av + 2 + i);
+	}
+	
+	// the hrir set is read once from the buffer~, the object does not follow later changes of the buffer~
+	hrir_ref = buffer_ref_new((t_object *)x, name);
+	hrir_obj = buffer_ref_getobject(hrir_ref);
+	if (hrir_obj == NULL) {
+		object_error((t_object *)x, "hrir buffer~ %s does not exist", name->s_name);
+		object_free(hrir_ref);
+		return;
+	}
+	channelcount = buffer_getchannelcount(hrir_obj);
+	if (buffer_getframecount(hrir_obj) < length * buckets) {
+		object_error((t_object *)x, "hrir buffer~ %s must hold %ld frames (%ld directions of %ld samples)", name->s_name, length * buckets, buckets, length);
+		object_free(hrir_ref);
+		return;
+	}
+	if (buffer_getsamplerate(hrir_obj) != x->m_sr * 1000.0) {
+		object_warn((t_object *)x, "hrir buffer~ sample rate differs from the dsp sample rate");
+	}
+	hrir_sample = buffer_locksamples(hrir_obj);
+	if (hrir_sample == NULL) {
+		object_error((t_object *)x, "hrir buffer~ %s could not be read", name->s_name);
+		object_free(hrir_ref);
+		return;
+	}
+	hrtf_new = cm_hrtf_new(hrir_sample, channelcount, length, azel, buckets);
+	buffer_unlocksamples(hrir_obj);
+	object_free(hrir_ref);
+	if (hrtf_new == NULL) {
+		object_error((t_object *)x, "out of memory");
+		return;
+	}
+	
+	// the perform routine holds the lock while it runs the convolution
+	systhread_mutex_lock(x->hrtf_mutex);
+	hrtf_old = x->hrtf;
+	x->hrtf = hrtf_new;
+	systhread_mutex_unlock(x->hrtf_mutex);
+	cm_hrtf_free(hrtf_old);
 }
-// RANDOM REVERSE FLAG GENERATOR
-t_bool cm_randomreverse() {
-	double flag;
-#ifdef MAC_VERSION
-	flag = 0.0 + ((1.0 - 0.0) * (((double)arc4random_uniform(RANDMAX)) / (double)RANDMAX));
-#endif
-#ifdef WIN_VERSION
-	flag = 0.0 + ((1.0 - 0.0) * ((double)(rand() % RANDMAX) / (double)RANDMAX));
-#endif
-	if (flag > 0.5) {
-		return true;
+
+
+/************************************************************************************************************************/
+/* THE FILE METHOD                                                                                                      */
+/************************************************************************************************************************/
+void cmbuffercloud_file(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	if (ac == 1 && atom_gettype(av) == A_SYM) {
+		defer(x, (method)cmbuffercloud_dofile, s, ac, av);
 	}
 	else {
-		return false;
+		object_error((t_object *)x, "file name required");
 	}
 }
-// LINEAR INTERPOLATION FUNCTION
-double cm_lininterp(double distance, float *buffer, t_atom_long b_channelcount, t_atom_long b_framecount, short channel) {
-	long index = (long)distance; // get truncated index
-	long next = index + 1;
-	if (next > b_framecount) {
-		next = 0;
+
+
+/************************************************************************************************************************/
+/* THE ACTUAL FILE METHOD (MAIN THREAD)                                                                                 */
+/************************************************************************************************************************/
+void cmbuffercloud_dofile(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	char filename[MAX_PATH_CHARS];
+	char fullpath[MAX_PATH_CHARS];
+	char syspath[MAX_PATH_CHARS];
+	short path;
+	t_fourcc type;
+	cm_mapfile *map_new;
+	cm_mapfile *map_old;
+	
+	strncpy_zero(filename, atom_getsym(av)->s_name, MAX_PATH_CHARS);
+	if (locatefile_extended(filename, &path, &type, NULL, 0)) {
+		object_error((t_object *)x, "file %s not found", atom_getsym(av)->s_name);
+		return;
 	}
-	distance -= (long)distance; // calculate fraction value for interpolation
+	path_toabsolutesystempath(path, filename, fullpath);
+	path_nameconform(fullpath, syspath, PATH_STYLE_NATIVE, PATH_TYPE_BOTH);
+	map_new = cm_mapfile_open((t_object *)x, syspath);
+	if (map_new == NULL) {
+		return;
+	}
+	if (!cmbuffercloud_prefetchstart(x)) {
+		cm_mapfile_close(map_new);
+		return;
+	}
+	
+	// the perform routine and the prefetch thread hold the locks while they read the mapped file
+	systhread_mutex_lock(x->map_mutex);
+	systhread_mutex_lock(x->src_mutex);
+	map_old = x->map;
+	x->map = map_new;
+	systhread_mutex_unlock(x->src_mutex);
+	systhread_mutex_unlock(x->map_mutex);
+	cm_mapfile_close(map_old);
+	object_attr_setsym(x, gensym("source"), ps_file);
+	outlet_anything(x->status_out, gensym("file"), 0, NIL);
+}
+
+
+/************************************************************************************************************************/
+/* THE STREAM METHOD                                                                                                    */
+/************************************************************************************************************************/
+void cmbuffercloud_stream(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	if (ac == 1 && atom_gettype(av) == A_SYM) {
+		defer(x, (method)cmbuffercloud_dostream, s, ac, av);
+	}
+	else {
+		object_error((t_object *)x, "file name required");
+	}
+}
+
+
+/************************************************************************************************************************/
+/* THE ACTUAL STREAM METHOD (MAIN THREAD)                                                                               */
+/************************************************************************************************************************/
+void cmbuffercloud_dostream(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	char filename[MAX_PATH_CHARS];
+	short path;
+	t_fourcc type;
+	cm_stream *stream_new;
+	cm_stream *stream_old;
+	
+	strncpy_zero(filename, atom_getsym(av)->s_name, MAX_PATH_CHARS);
+	if (locatefile_extended(filename, &path, &type, NULL, 0)) {
+		object_error((t_object *)x, "file %s not found", atom_getsym(av)->s_name);
+		return;
+	}
+	stream_new = cm_stream_open((t_object *)x, filename, path);
+	if (stream_new == NULL) {
+		return;
+	}
+	if (!cmbuffercloud_prefetchstart(x)) {
+		cm_stream_close(stream_new);
+		return;
+	}
+	
+	// the perform routine and the streaming thread hold the locks while they read the stream cache
+	systhread_mutex_lock(x->map_mutex);
+	systhread_mutex_lock(x->src_mutex);
+	stream_old = x->stream;
+	x->stream = stream_new;
+	x->stream_deferred = false;
+	systhread_mutex_unlock(x->src_mutex);
+	systhread_mutex_unlock(x->map_mutex);
+	cm_stream_close(stream_old);
+	object_attr_setsym(x, gensym("source"), ps_stream);
+	outlet_anything(x->status_out, gensym("stream"), 0, NIL);
+}
+
+
+/************************************************************************************************************************/
+/* THE STORE METHOD                                                                                                     */
+/************************************************************************************************************************/
+void cmbuffercloud_store(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	defer(x, (method)cmbuffercloud_dostore, s, ac, av);
+}
+
+
+/************************************************************************************************************************/
+/* THE ACTUAL STORE METHOD (MAIN THREAD): COMPRESSES THE SAMPLE BUFFER~ INTO THE STORE                                  */
+/************************************************************************************************************************/
+void cmbuffercloud_dostore(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	t_buffer_obj *buffer_obj = x->buffer_ref ? buffer_ref_getobject(x->buffer_ref) : NULL;
+	float *samples;
+	cm_store *store_new;
+	cm_store *store_old;
+	
+	if (buffer_obj == NULL) {
+		object_error((t_object *)x, "sample buffer~ %s does not exist", x->buffer_name->s_name);
+		return;
+	}
+	store_new = cm_store_new(buffer_getframecount(buffer_obj), buffer_getchannelcount(buffer_obj), buffer_getsamplerate(buffer_obj), cmbuffercloud_storeformat(x));
+	if (store_new == NULL) {
+		object_error((t_object *)x, "out of memory");
+		return;
+	}
+	samples = buffer_locksamples(buffer_obj);
+	if (samples == NULL) {
+		object_error((t_object *)x, "sample buffer~ %s could not be read", x->buffer_name->s_name);
+		cm_store_free(store_new);
+		return;
+	}
+	cm_store_encode(store_new, samples, store_new->channelcount, 0, store_new->framecount);
+	buffer_unlocksamples(buffer_obj);
+	
+	// the perform routine holds the lock while it reads the store
+	systhread_mutex_lock(x->src_mutex);
+	store_old = x->store;
+	x->store = store_new;
+	x->store_buffer = true;
+	systhread_mutex_unlock(x->src_mutex);
+	cm_store_free(store_old);
+	if (s == ps_buffer_modified) { // rebuilt after the sample buffer~ was modified, the source is not changed
+		return;
+	}
+	object_attr_setsym(x, gensym("source"), ps_store);
+	outlet_anything(x->status_out, gensym("store"), 0, NIL);
+}
+
+
+/************************************************************************************************************************/
+/* THE STORE FORMAT OF THE STOREFORMAT ATTRIBUTE                                                                        */
+/************************************************************************************************************************/
+short cmbuffercloud_storeformat(t_cmbuffercloud *x) {
+	if (x->attr_storeformat == gensym("bfp8")) {
+		return STORE_BFP8;
+	}
+	else if (x->attr_storeformat == gensym("bfp16")) {
+		return STORE_BFP16;
+	}
+	return STORE_INT16;
+}
+
+
+/************************************************************************************************************************/
+/* THE LOAD METHOD                                                                                                      */
+/************************************************************************************************************************/
+void cmbuffercloud_load(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	if (ac == 1 && atom_gettype(av) == A_SYM) {
+		defer(x, (method)cmbuffercloud_doload, s, ac, av);
+	}
+	else {
+		object_error((t_object *)x, "file name required");
+	}
+}
+
+
+/************************************************************************************************************************/
+/* THE ACTUAL LOAD METHOD (MAIN THREAD): READS THE HEADER AND STARTS THE LOAD THREAD                                    */
+/************************************************************************************************************************/
+void cmbuffercloud_doload(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	char filename[MAX_PATH_CHARS];
+	short path;
+	t_fourcc type;
+	cm_load *load;
+	
+	strncpy_zero(filename, atom_getsym(av)->s_name, MAX_PATH_CHARS);
+	if (locatefile_extended(filename, &path, &type, NULL, 0)) {
+		object_error((t_object *)x, "file %s not found", atom_getsym(av)->s_name);
+		return;
+	}
+	// a load in progress is replaced by the new one
+	cmbuffercloud_loadcancel(x);
+	load = (cm_load *)sysmem_newptrclear(sizeof(cm_load));
+	if (load == NULL) {
+		object_error((t_object *)x, "out of memory");
+		return;
+	}
+	if (path_opensysfile(filename, path, &load->fh, READ_PERM)) {
+		object_error((t_object *)x, "file %s could not be opened", filename);
+		sysmem_freeptr(load);
+		return;
+	}
+	if (!cm_fileheader((t_object *)x, filename, load->fh, &load->fmt, &load->dataoffset)) {
+		sysfile_close(load->fh);
+		sysmem_freeptr(load);
+		return;
+	}
+	load->store = cm_store_new(load->fmt.framecount, load->fmt.channelcount, load->fmt.samplerate, cmbuffercloud_storeformat(x));
+	if (load->store == NULL) {
+		object_error((t_object *)x, "out of memory");
+		sysfile_close(load->fh);
+		sysmem_freeptr(load);
+		return;
+	}
+	load->progress = 0.0;
+	load->state = LOAD_RUNNING;
+	x->load = load;
+	x->load_cancel = false;
+	if (systhread_create((method)cmbuffercloud_loadthread, x, 0, 0, 0, &x->load_thread) != MAX_ERR_NONE) {
+		x->load_thread = NULL;
+		object_error((t_object *)x, "load thread could not be started");
+		cmbuffercloud_loadcancel(x); // frees the load job
+	}
+}
+
+
+/************************************************************************************************************************/
+/* THE LOAD THREAD: DECODES THE FILE CHUNK BY CHUNK INTO THE STORE OF THE LOAD JOB                                      */
+/************************************************************************************************************************/
+void *cmbuffercloud_loadthread(t_cmbuffercloud *x) {
+	cm_load *load = x->load;
+	cm_mapfile *fmt = &load->fmt;
+	unsigned char *bytes = (unsigned char *)sysmem_newptr((t_ptr_size)LOAD_CHUNKFRAMES * fmt->framebytes);
+	float *samples = (float *)sysmem_newptr(LOAD_CHUNKFRAMES * fmt->channelcount * sizeof(float));
+	long frame, frames, i;
+	t_ptr_size count;
+	
+	if (!bytes || !samples) {
+		load->state = LOAD_FAILED;
+	}
+	for (frame = 0; frame < fmt->framecount && load->state == LOAD_RUNNING; frame += LOAD_CHUNKFRAMES) {
+		if (x->load_cancel) {
+			load->state = LOAD_FAILED;
+			break;
+		}
+		frames = fmt->framecount - frame;
+		if (frames > LOAD_CHUNKFRAMES) {
+			frames = LOAD_CHUNKFRAMES;
+		}
+		count = (t_ptr_size)frames * fmt->framebytes;
+		sysfile_setpos(load->fh, SYSFILE_FROMSTART, load->dataoffset + ((t_int64)frame * fmt->framebytes));
+		if (sysfile_read(load->fh, &count, bytes) || count != (t_ptr_size)frames * fmt->framebytes) {
+			load->state = LOAD_FAILED;
+			break;
+		}
+		for (i = 0; i < frames * fmt->channelcount; i++) {
+			samples[i] = (float)cm_mapsample(bytes + (i * fmt->bytes), fmt->format, fmt->bigendian);
+		}
+		cm_store_encode(load->store, samples, fmt->channelcount, frame, frames);
+		load->progress = (double)(frame + frames) / fmt->framecount;
+		qelem_set(x->load_qelem);
+	}
+	if (load->state == LOAD_RUNNING) {
+		load->state = LOAD_DONE;
+	}
+	sysmem_freeptr(bytes);
+	sysmem_freeptr(samples);
+	qelem_set(x->load_qelem);
+	systhread_exit(0);
+	return NULL;
+}
+
+
+/************************************************************************************************************************/
+/* THE LOAD QUEUE FUNCTION (MAIN THREAD): SENDS THE PROGRESS, SWITCHES THE STORE WHEN THE LOAD THREAD IS DONE           */
+/************************************************************************************************************************/
+void cmbuffercloud_loadqueue(t_cmbuffercloud *x) {
+	cm_load *load = x->load;
+	cm_store *store_old;
+	t_atom progress_atom;
+	
+	if (load == NULL) {
+		return;
+	}
+	atom_setfloat(&progress_atom, load->progress);
+	outlet_anything(x->status_out, gensym("progress"), 1, &progress_atom);
+	if (load->state == LOAD_RUNNING) {
+		return;
+	}
+	if (load->state == LOAD_DONE) {
+		// the perform routine holds the lock while it reads the store
+		systhread_mutex_lock(x->src_mutex);
+		store_old = x->store;
+		x->store = load->store;
+		x->store_buffer = false;
+		systhread_mutex_unlock(x->src_mutex);
+		load->store = store_old; // freed with the load job
+		cmbuffercloud_loadcancel(x);
+		object_attr_setsym(x, gensym("source"), ps_store);
+		outlet_anything(x->status_out, gensym("load"), 0, NIL);
+	}
+	else {
+		cmbuffercloud_loadcancel(x);
+		object_error((t_object *)x, "file could not be loaded");
+	}
+}
+
+
+/************************************************************************************************************************/
+/* STOPS THE LOAD THREAD AND FREES THE LOAD JOB (MAIN THREAD)                                                           */
+/************************************************************************************************************************/
+void cmbuffercloud_loadcancel(t_cmbuffercloud *x) {
+	unsigned int ret;
+	if (x->load_thread) {
+		x->load_cancel = true;
+		systhread_join(x->load_thread, &ret);
+		x->load_thread = NULL;
+	}
+	if (x->load) {
+		sysfile_close(x->load->fh);
+		cm_store_free(x->load->store);
+		sysmem_freeptr(x->load);
+		x->load = NULL;
+	}
+}
+
+
+/************************************************************************************************************************/
+/* THE CORPUS METHOD                                                                                                    */
+/************************************************************************************************************************/
+void cmbuffercloud_corpus(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	for (long i = 0; i < ac; i++) {
+		if (atom_gettype(av + i) != A_SYM) {
+			object_error((t_object *)x, "buffer names required");
+			return;
+		}
+	}
+	if (ac < 1 || ac > MAX_CORPUS) {
+		object_error((t_object *)x, "between 1 and %d buffer names required", MAX_CORPUS);
+		return;
+	}
+	defer(x, (method)cmbuffercloud_docorpus, s, ac, av);
+}
+
+
+/************************************************************************************************************************/
+/* THE ACTUAL CORPUS METHOD (MAIN THREAD): BUILDS THE CORPUS TABLE FROM A BUFFER LIST OR THE BUFFERS OF A POLYBUFFER~   */
+/************************************************************************************************************************/
+void cmbuffercloud_docorpus(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	char name[MAX_PATH_CHARS];
+	t_symbol *names[MAX_CORPUS];
+	t_buffer_ref *probe;
+	t_buffer_obj *buffer_obj;
+	cm_corpusentry *corpus_new;
+	cm_corpusentry *corpus_old;
+	long count = 0;
+	long count_old;
+	long i;
+	
+	// a single name is expanded to the buffers of a polybuffer~ (name.1, name.2, ...) if these exist
+	if (ac == 1) {
+		snprintf_zero(name, MAX_PATH_CHARS, "%s.1", atom_getsym(av)->s_name);
+		probe = buffer_ref_new((t_object *)x, gensym(name));
+		while (count < MAX_CORPUS && buffer_ref_exists(probe)) {
+			names[count++] = gensym(name);
+			snprintf_zero(name, MAX_PATH_CHARS, "%s.%ld", atom_getsym(av)->s_name, count + 1);
+			buffer_ref_set(probe, gensym(name));
+		}
+		object_free(probe);
+	}
+	if (count == 0) {
+		for (i = 0; i < ac; i++) {
+			names[count++] = atom_getsym(av + i);
+		}
+	}
+	corpus_new = (cm_corpusentry *)sysmem_newptrclear(count * sizeof(cm_corpusentry));
+	if (corpus_new == NULL) {
+		object_error((t_object *)x, "out of memory");
+		return;
+	}
+	for (i = 0; i < count; i++) {
+		corpus_new[i].name = names[i];
+		corpus_new[i].ref = buffer_ref_new((t_object *)x, names[i]);
+		buffer_obj = buffer_ref_getobject(corpus_new[i].ref);
+		if (buffer_obj) {
+			corpus_new[i].framecount = buffer_getframecount(buffer_obj);
+			corpus_new[i].channelcount = buffer_getchannelcount(buffer_obj);
+			corpus_new[i].m_sr = buffer_getsamplerate(buffer_obj) * 0.001;
+		}
+		else {
+			object_error((t_object *)x, "corpus buffer~ %s does not exist", names[i]->s_name);
+		}
+	}
+	
+	// the perform routine holds the lock while it reads the corpus table
+	systhread_mutex_lock(x->src_mutex);
+	corpus_old = x->corpus;
+	count_old = x->corpus_count;
+	x->corpus = corpus_new;
+	x->corpus_count = count;
+	x->corpus_modified = false;
+	systhread_mutex_unlock(x->src_mutex);
+	cm_corpus_free(corpus_old, count_old);
+	object_attr_setsym(x, gensym("source"), ps_corpus);
+	outlet_anything(x->status_out, gensym("corpus"), 0, NIL);
+}
+
+
+/************************************************************************************************************************/
+/* THE CORPUS BUFFER SELECTION METHOD (AUDIO THREAD)                                                                    */
+/************************************************************************************************************************/
+long cmbuffercloud_grainsource(t_cmbuffercloud *x) {
+	long index = 0;
+	long count = x->corpus_count;
+	double index_zero = 0.0;
+	double index_max = (double)count;
+	double rnd;
+	if (x->attr_corpusmode == gensym("index")) {
+		index = x->corpus_index;
+	}
+	else if (x->attr_corpusmode == gensym("weighted") && x->corpusweights_count > 0) {
+		// pick a buffer from the cumulative weights, buffers without weight are not selected
+		if (x->corpusweights_count < count) {
+			count = x->corpusweights_count;
+		}
+		rnd = cm_random(&index_zero, &x->corpusweights[count - 1]);
+		while (index < count - 1 && rnd >= x->corpusweights[index]) {
+			index++;
+		}
+	}
+	else {
+		index = (long)cm_random(&index_zero, &index_max);
+	}
+	return index < x->corpus_count ? index : x->corpus_count - 1;
+}
+
+
+/************************************************************************************************************************/
+/* THE CORPUS WEIGHTS METHOD                                                                                            */
+/************************************************************************************************************************/
+void cmbuffercloud_corpusweights(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	double *weights;
+	double *weights_old;
+	double sum = 0.0;
+	if (ac < 1 || ac > MAX_CORPUS) {
+		object_error((t_object *)x, "between 1 and %d corpus weights required", MAX_CORPUS);
+		return;
+	}
+	weights = (double *)sysmem_newptr(ac * sizeof(double));
+	if (weights == NULL) {
+		object_error((t_object *)x, "out of memory");
+		return;
+	}
+	for (int i = 0; i < ac; i++) {
+		weights[i] = atom_getfloat(av + i);
+		if (weights[i] < 0.0) {
+			object_error((t_object *)x, "corpus weight %d must not be negative - setting to 0", (i+1));
+			weights[i] = 0.0;
+		}
+		sum += weights[i];
+		weights[i] = sum;
+	}
+	if (sum <= 0.0) {
+		object_error((t_object *)x, "at least one corpus weight must be greater than 0");
+		sysmem_freeptr(weights);
+		return;
+	}
+	// the perform routine holds the lock while it reads the weights
+	systhread_mutex_lock(x->src_mutex);
+	weights_old = x->corpusweights;
+	x->corpusweights = weights;
+	x->corpusweights_count = ac;
+	systhread_mutex_unlock(x->src_mutex);
+	sysmem_freeptr(weights_old);
+}
+
+
+/************************************************************************************************************************/
+/* THE CORPUS INDEX METHOD                                                                                              */
+/************************************************************************************************************************/
+void cmbuffercloud_corpusindex(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	long arg = atom_getlong(av);
+	if (ac && av) {
+		if (arg < 1) {
+			object_error((t_object *)x, "corpus index must be greater than 0 - setting to 1");
+			arg = 1;
+		}
+		x->corpus_index = arg - 1; // limited to the corpus size when read
+	}
+}
+
+
+/************************************************************************************************************************/
+/* THE ANALYSIS REQUEST METHOD: THE INDICES ARE REBUILT ON THE MAIN THREAD                                               */
+/************************************************************************************************************************/
+void cmbuffercloud_analysisrequest(t_cmbuffercloud *x) {
+	if (!x->onset_mode && !x->zero_mode && !x->attr_descriptors && !x->attr_resample && !x->attr_psola) { // no index is used
+		return;
+	}
+	x->analysis_request = true;
+	if (x->analysis_qelem) {
+		qelem_set(x->analysis_qelem);
+	}
+}
+
+
+/************************************************************************************************************************/
+/* THE ANALYSIS QUEUE FUNCTION (MAIN THREAD): REPORTS FINISHED INDICES, COPIES THE SAMPLE BUFFER~ AND STARTS THE THREAD  */
+/************************************************************************************************************************/
+void cmbuffercloud_analysisqueue(t_cmbuffercloud *x) {
+	t_buffer_ref *buffer_ref;
+	t_buffer_obj *buffer_obj;
+	float *samples;
+	t_atom count_atom;
+	unsigned int ret;
+	
+	if (x->analysis_thread && x->analysis_done) {
+		systhread_join(x->analysis_thread, &ret);
+		x->analysis_thread = NULL;
+		if (x->onset_mode) {
+			atom_setlong(&count_atom, x->onsets_count);
+			outlet_anything(x->status_out, gensym("onsets"), 1, &count_atom);
+		}
+		if (x->zero_mode) {
+			atom_setlong(&count_atom, x->zeros_channels ? x->zeros_count[0] : 0);
+			outlet_anything(x->status_out, gensym("zerocrossings"), 1, &count_atom);
+		}
+		if (x->attr_descriptors) {
+			atom_setlong(&count_atom, x->desctree ? x->desctree->count : 0);
+			outlet_anything(x->status_out, gensym("descriptors"), 1, &count_atom);
+		}
+		if (x->attr_resample) {
+			atom_setlong(&count_atom, x->resampled ? x->resampled->framecount : 0);
+			outlet_anything(x->status_out, gensym("resampled"), 1, &count_atom);
+		}
+		if (x->attr_psola) {
+			atom_setlong(&count_atom, x->marks_count);
+			outlet_anything(x->status_out, gensym("pitchmarks"), 1, &count_atom);
+		}
+	}
+	if (!x->analysis_request) {
+		return;
+	}
+	x->analysis_request = false;
+	cmbuffercloud_analysiscancel(x);
+	// the analysis thread reads a copy, the sample buffer~ is only locked while it is copied
+	buffer_ref = buffer_ref_new((t_object *)x, x->buffer_name);
+	buffer_obj = buffer_ref_getobject(buffer_ref);
+	if (buffer_obj == NULL) {
+		object_error((t_object *)x, "sample buffer~ %s does not exist", x->buffer_name->s_name);
+		object_free(buffer_ref);
+		return;
+	}
+	x->analysis_framecount = buffer_getframecount(buffer_obj);
+	x->analysis_channelcount = buffer_getchannelcount(buffer_obj);
+	x->analysis_samplerate = buffer_getsamplerate(buffer_obj);
+	x->analysis_dsprate = x->m_sr * 1000.0;
+	strncpy_zero(x->analysis_cachedir, x->cache_dir, MAX_PATH_CHARS);
+	x->analysis_samples = (float *)sysmem_newptr(x->analysis_framecount * x->analysis_channelcount * sizeof(float));
+	samples = buffer_locksamples(buffer_obj);
+	if (x->analysis_samples == NULL || samples == NULL) {
+		object_error((t_object *)x, "sample buffer~ %s could not be analyzed", x->buffer_name->s_name);
+		if (samples) {
+			buffer_unlocksamples(buffer_obj);
+		}
+		sysmem_freeptr(x->analysis_samples);
+		x->analysis_samples = NULL;
+		object_free(buffer_ref);
+		return;
+	}
+	memcpy(x->analysis_samples, samples, x->analysis_framecount * x->analysis_channelcount * sizeof(float));
+	buffer_unlocksamples(buffer_obj);
+	object_free(buffer_ref);
+	x->analysis_cancel = false;
+	x->analysis_done = false;
+	systhread_create((method)cmbuffercloud_analysisthread, x, 0, 0, 0, &x->analysis_thread);
+}
+
+
+/************************************************************************************************************************/
+/* STOPS THE ANALYSIS THREAD (MAIN THREAD)                                                                              */
+/************************************************************************************************************************/
+void cmbuffercloud_analysiscancel(t_cmbuffercloud *x) {
+	unsigned int ret;
+	if (x->analysis_thread) {
+		x->analysis_cancel = true;
+		systhread_join(x->analysis_thread, &ret);
+		x->analysis_thread = NULL;
+	}
+	sysmem_freeptr(x->analysis_samples);
+	x->analysis_samples = NULL;
+}
+
+
+/************************************************************************************************************************/
+/* THE ANALYSIS THREAD: BUILDS THE INDICES FROM THE COPY OF THE SAMPLE BUFFER~                                          */
+/************************************************************************************************************************/
+void *cmbuffercloud_analysisthread(t_cmbuffercloud *x) {
+	long *onsets = NULL;
+	long *onsets_old;
+	long onsets_count = 0;
+	long **zeros = NULL;
+	long **zeros_old;
+	long *zeros_count = NULL;
+	long *zeros_count_old;
+	long zeros_channels = 0;
+	long zeros_channels_old;
+	cm_descframe *descframes = NULL;
+	long descframes_count;
+	cm_desctree *desctree = NULL;
+	cm_desctree *desctree_old;
+	t_bool cache = (x->analysis_cachedir[0] != '\0');
+	t_uint64 hash = 0;
+	t_int64 *zeros_bytes;
+	void *blocks[2];
+	t_int64 bytes[2];
+	float *samples = x->analysis_samples;
+	long framecount = x->analysis_framecount;
+	double samplerate = x->analysis_samplerate;
+	cm_resampled *resampled = NULL;
+	cm_resampled *resampled_old;
+	long *marks = NULL;
+	long *marks_old;
+	long *mark_periods = NULL;
+	long *mark_periods_old;
+	long marks_count = 0;
+	long c;
+	
+	if (cache) { // the hash is taken over the sample buffer~ content, so the resampled copy can be cached as well
+		hash = cm_hash(samples, x->analysis_channelcount, framecount, samplerate, &x->analysis_cancel);
+	}
+	// the copy at the dsp sample rate replaces the sample buffer~, so the indices are built from it
+	if (x->attr_resample && x->analysis_dsprate > 0.0 && samplerate > 0.0 && samplerate != x->analysis_dsprate) {
+		double ratio = x->analysis_dsprate / samplerate;
+		resampled = (cm_resampled *)sysmem_newptrclear(sizeof(cm_resampled));
+		if (resampled) {
+			resampled->channelcount = x->analysis_channelcount;
+			resampled->samplerate = x->analysis_dsprate;
+			if (cache && cm_cacheread(x->analysis_cachedir, hash, CACHE_RESAMPLED, ratio, 1, blocks, bytes) == 1) {
+				resampled->samples = (float *)blocks[0];
+				resampled->framecount = (long)(bytes[0] / ((t_int64)x->analysis_channelcount * sizeof(float)));
+			}
+			else {
+				resampled->framecount = cm_resample(&resampled->samples, samples, x->analysis_channelcount, framecount, ratio, &x->analysis_cancel);
+				if (cache && resampled->framecount && !x->analysis_cancel) {
+					blocks[0] = resampled->samples;
+					bytes[0] = (t_int64)resampled->framecount * x->analysis_channelcount * sizeof(float);
+					cm_cachewrite(x->analysis_cachedir, hash, CACHE_RESAMPLED, ratio, 1, blocks, bytes);
+				}
+			}
+			if (resampled->framecount) {
+				samples = resampled->samples;
+				framecount = resampled->framecount;
+				samplerate = resampled->samplerate;
+				hash = (hash ^ (t_uint64)samplerate) * 1099511628211ULL; // the indices of the copy are cached apart from the ones of the original
+			}
+			else {
+				cm_resampled_free(resampled);
+				resampled = NULL;
+			}
+		}
+	}
+	if (x->onset_mode) {
+		if (cache && cm_cacheread(x->analysis_cachedir, hash, CACHE_ONSETS, x->attr_onsetthresh, 1, blocks, bytes) == 1) {
+			onsets = (long *)blocks[0];
+			onsets_count = (long)(bytes[0] / sizeof(long));
+		}
+		else {
+			onsets_count = cm_onsets(&onsets, samples, x->analysis_channelcount, framecount, x->attr_onsetthresh, &x->analysis_cancel);
+			if (cache && !x->analysis_cancel) {
+				blocks[0] = onsets;
+				bytes[0] = onsets_count * sizeof(long);
+				cm_cachewrite(x->analysis_cachedir, hash, CACHE_ONSETS, x->attr_onsetthresh, 1, blocks, bytes);
+			}
+		}
+	}
+	if (x->zero_mode) {
+		zeros = (long **)sysmem_newptrclear(x->analysis_channelcount * sizeof(long *));
+		zeros_count = (long *)sysmem_newptrclear(x->analysis_channelcount * sizeof(long));
+		zeros_bytes = (t_int64 *)sysmem_newptrclear(x->analysis_channelcount * sizeof(t_int64));
+		if (zeros && zeros_count && zeros_bytes) {
+			zeros_channels = x->analysis_channelcount;
+			if (cache && cm_cacheread(x->analysis_cachedir, hash, CACHE_ZEROS, 0.0, zeros_channels, (void **)zeros, zeros_bytes) == zeros_channels) {
+				for (c = 0; c < zeros_channels; c++) {
+					zeros_count[c] = (long)(zeros_bytes[c] / sizeof(long));
+				}
+			}
+			else {
+				for (c = 0; c < zeros_channels && !x->analysis_cancel; c++) {
+					zeros_count[c] = cm_zerocrossings(&zeros[c], samples, x->analysis_channelcount, framecount, c);
+					zeros_bytes[c] = zeros_count[c] * sizeof(long);
+				}
+				if (cache && !x->analysis_cancel) {
+					cm_cachewrite(x->analysis_cachedir, hash, CACHE_ZEROS, 0.0, zeros_channels, (void **)zeros, zeros_bytes);
+				}
+			}
+		}
+		sysmem_freeptr(zeros_bytes);
+	}
+	if (x->attr_descriptors) {
+		if (cache && cm_cacheread(x->analysis_cachedir, hash, CACHE_DESCRIPTORS, 0.0, 2, blocks, bytes) == 2) {
+			// the cached tree is stored as minimum and range followed by the nodes
+			desctree = (cm_desctree *)sysmem_newptrclear(sizeof(cm_desctree));
+			if (desctree && bytes[0] == DESC_DIMS * 2 * sizeof(double)) {
+				memcpy(desctree->min, blocks[0], DESC_DIMS * sizeof(double));
+				memcpy(desctree->range, (double *)blocks[0] + DESC_DIMS, DESC_DIMS * sizeof(double));
+				desctree->nodes = (cm_descframe *)blocks[1];
+				desctree->count = (long)(bytes[1] / sizeof(cm_descframe));
+			}
+			else {
+				sysmem_freeptr(blocks[1]);
+				sysmem_freeptr(desctree);
+				desctree = NULL;
+			}
+			sysmem_freeptr(blocks[0]);
+		}
+		else {
+			descframes_count = cm_descriptors(&descframes, samples, x->analysis_channelcount, framecount, samplerate, &x->analysis_cancel);
+			if (descframes_count && !x->analysis_cancel) {
+				desctree = cm_desctree_new(descframes, descframes_count); // takes the frames
+			}
+			else {
+				sysmem_freeptr(descframes);
+			}
+			if (cache && desctree && !x->analysis_cancel) {
+				double range[DESC_DIMS * 2];
+				memcpy(range, desctree->min, DESC_DIMS * sizeof(double));
+				memcpy(range + DESC_DIMS, desctree->range, DESC_DIMS * sizeof(double));
+				blocks[0] = range;
+				bytes[0] = sizeof(range);
+				blocks[1] = desctree->nodes;
+				bytes[1] = desctree->count * sizeof(cm_descframe);
+				cm_cachewrite(x->analysis_cachedir, hash, CACHE_DESCRIPTORS, 0.0, 2, blocks, bytes);
+			}
+		}
+	}
+	if (x->attr_psola) {
+		if (cache && cm_cacheread(x->analysis_cachedir, hash, CACHE_MARKS, 0.0, 2, blocks, bytes) == 2) {
+			marks = (long *)blocks[0];
+			mark_periods = (long *)blocks[1];
+			marks_count = (long)(bytes[0] / sizeof(long));
+		}
+		else {
+			marks_count = cm_pitchmarks(&marks, &mark_periods, samples, x->analysis_channelcount, framecount, samplerate, &x->analysis_cancel);
+			if (cache && !x->analysis_cancel) {
+				blocks[0] = marks;
+				blocks[1] = mark_periods;
+				bytes[0] = marks_count * sizeof(long);
+				bytes[1] = marks_count * sizeof(long);
+				cm_cachewrite(x->analysis_cachedir, hash, CACHE_MARKS, 0.0, 2, blocks, bytes);
+			}
+		}
+	}
+	if (!x->analysis_cancel) {
+		// the perform routine holds the lock while it reads the indices
+		systhread_mutex_lock(x->index_mutex);
+		onsets_old = x->onsets;
+		x->onsets = onsets;
+		x->onsets_count = onsets_count;
+		zeros_old = x->zeros;
+		zeros_count_old = x->zeros_count;
+		zeros_channels_old = x->zeros_channels;
+		x->zeros = zeros;
+		x->zeros_count = zeros_count;
+		x->zeros_channels = zeros_channels;
+		desctree_old = x->desctree;
+		x->desctree = desctree;
+		resampled_old = x->resampled;
+		x->resampled = resampled;
+		marks_old = x->marks;
+		mark_periods_old = x->mark_periods;
+		x->marks = marks;
+		x->mark_periods = mark_periods;
+		x->marks_count = marks_count;
+		systhread_mutex_unlock(x->index_mutex);
+		cm_resampled_free(resampled_old);
+		sysmem_freeptr(marks_old);
+		sysmem_freeptr(mark_periods_old);
+		sysmem_freeptr(onsets_old);
+		cm_zeros_free(zeros_old, zeros_count_old, zeros_channels_old);
+		cm_desctree_free(desctree_old);
+		x->analysis_done = true;
+		qelem_set(x->analysis_qelem);
+	}
+	else {
+		sysmem_freeptr(onsets);
+		cm_zeros_free(zeros, zeros_count, zeros_channels);
+		cm_desctree_free(desctree);
+		cm_resampled_free(resampled);
+		sysmem_freeptr(marks);
+		sysmem_freeptr(mark_periods);
+	}
+	systhread_exit(0);
+	return NULL;
+}
+
+
+/************************************************************************************************************************/
+/* THE ONSET START METHOD (AUDIO THREAD): NEAREST ONSET, OR A RANDOM ONSET BETWEEN START MIN AND START MAX              */
+/************************************************************************************************************************/
+long cmbuffercloud_onsetstart(t_cmbuffercloud *x, long start) {
+	double start_min = x->grain_params[0] < x->grain_params[1] ? x->grain_params[0] : x->grain_params[1];
+	double start_max = x->grain_params[0] < x->grain_params[1] ? x->grain_params[1] : x->grain_params[0];
+	double first, last;
+	if (x->onset_mode == 2) {
+		first = (double)cm_lowerbound(x->onsets, x->onsets_count, start_min);
+		last = (double)cm_lowerbound(x->onsets, x->onsets_count, start_max);
+		if (last > first) { // at least one onset in the start range
+			return x->onsets[(long)cm_random(&first, &last)];
+		}
+	}
+	return cm_nearest(x->onsets, x->onsets_count, (double)start);
+}
+
+
+/************************************************************************************************************************/
+/* THE DESCRIPTOR START METHOD (AUDIO THREAD): RANDOM FRAME OF THE K NEAREST FRAMES WITHIN THE TOLERANCE (-1 IF NONE)   */
+/************************************************************************************************************************/
+long cmbuffercloud_descstart(t_cmbuffercloud *x) {
+	cm_desctree *tree = x->desctree;
+	double query[DESC_DIMS];
+	double best_dist[MAX_NEIGHBORS];
+	long best_frame[MAX_NEIGHBORS];
+	long found = 0;
+	double zero = 0.0;
+	double max;
+	// the target is normalized like the tree (rms in dBFS, centroid and pitch in octaves)
+	query[0] = (x->desc_target[0] - tree->min[0]) / tree->range[0];
+	query[1] = (log2(x->desc_target[1] > 20.0 ? x->desc_target[1] : 20.0) - tree->min[1]) / tree->range[1];
+	query[2] = (x->desc_target[2] - tree->min[2]) / tree->range[2];
+	query[3] = x->desc_target[3] > 0.0 ? (log2(x->desc_target[3]) - tree->min[3]) / tree->range[3] : DESC_UNVOICED;
+	cm_kdsearch(tree->nodes, 0, tree->count, 0, query, x->desc_weight, x->attr_tolerance * x->attr_tolerance, x->attr_neighbors, best_dist, best_frame, &found);
+	if (found == 0) {
+		return -1;
+	}
+	max = (double)found;
+	found = (long)cm_random(&zero, &max);
+	return best_frame[found < (long)max ? found : (long)max - 1];
+}
+
+
+/************************************************************************************************************************/
+/* THE TARGET METHOD: DESCRIPTOR NAME/VALUE PAIRS, DESCRIPTORS THAT ARE NOT LISTED ARE IGNORED                          */
+/************************************************************************************************************************/
+void cmbuffercloud_target(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	double target[DESC_DIMS] = {0.0, 0.0, 0.0, 0.0};
+	double weight[DESC_DIMS] = {0.0, 0.0, 0.0, 0.0};
+	t_symbol *name;
+	long d;
+	if (ac < 2 || ac % 2) {
+		object_error((t_object *)x, "descriptor name/value pairs required (rms, centroid, flatness, pitch)");
+		return;
+	}
+	for (long i = 0; i < ac; i += 2) {
+		name = atom_getsym(av + i);
+		if (name == gensym("rms")) {
+			d = 0;
+		}
+		else if (name == gensym("centroid")) {
+			d = 1;
+		}
+		else if (name == gensym("flatness")) {
+			d = 2;
+		}
+		else if (name == gensym("pitch")) {
+			d = 3;
+		}
+		else {
+			object_error((t_object *)x, "unknown descriptor %s (valid descriptors are rms | centroid | flatness | pitch)", name->s_name);
+			return;
+		}
+		target[d] = atom_getfloat(av + i + 1);
+		weight[d] = 1.0;
+	}
+	// the perform routine reads the target while holding the index lock
+	systhread_mutex_lock(x->index_mutex);
+	for (d = 0; d < DESC_DIMS; d++) {
+		x->desc_target[d] = target[d];
+		x->desc_weight[d] = weight[d];
+	}
+	systhread_mutex_unlock(x->index_mutex);
+}
+
+
+/************************************************************************************************************************/
+/* THE PREFETCH THREAD: ADVISES THE PAGES OF THE CURRENT START RANGE (FILE SOURCE) OR LOADS THE CACHE (STREAM SOURCE)   */
+/************************************************************************************************************************/
+void *cmbuffercloud_prefetch(t_cmbuffercloud *x) {
+	double start_min, start_max, chunk;
+	t_int64 frames;
+	while (!x->prefetch_quit) {
+		systhread_mutex_lock(x->map_mutex);
+		if (x->stream && x->attr_source == ps_stream) {
+			cmbuffercloud_streamservice(x);
+			systhread_mutex_unlock(x->map_mutex);
+			systhread_sleep(STREAM_INTERVAL);
+			continue;
+		}
+		if (x->map && x->attr_source == ps_file) {
+			// grains read from start min up to start max plus the longest grain at max pitch
+			start_min = x->grain_params[0] < x->grain_params[1] ? x->grain_params[0] : x->grain_params[1];
+			start_max = x->grain_params[0] < x->grain_params[1] ? x->grain_params[1] : x->grain_params[0];
+			frames = (t_int64)(start_max - start_min) + (t_int64)(x->grainlength * x->map->samplerate * 0.001 * MAX_PITCH);
+			// a start range larger than the prefetch size is covered by a random part per interval
+			if (frames * x->map->framebytes > PREFETCH_MAX) {
+				frames = PREFETCH_MAX / x->map->framebytes;
+				chunk = start_max - frames;
+				start_min = cm_random(&start_min, &chunk);
+			}
+			cm_mapprefetch(x->map, (t_int64)start_min, frames);
+		}
+		systhread_mutex_unlock(x->map_mutex);
+		systhread_sleep(PREFETCH_INTERVAL);
+	}
+	systhread_exit(0);
+	return NULL;
+}
+
+
+/************************************************************************************************************************/
+/* THE PREFETCH THREAD START (MAIN THREAD): THE THREAD IS STARTED THE FIRST TIME A FILE OR STREAM SOURCE IS OPENED      */
+/************************************************************************************************************************/
+t_bool cmbuffercloud_prefetchstart(t_cmbuffercloud *x) {
+	if (x->prefetch_thread) {
+		return true;
+	}
+	x->prefetch_quit = false;
+	if (systhread_create((method)cmbuffercloud_prefetch, x, 0, 0, 0, &x->prefetch_thread) != MAX_ERR_NONE) {
+		x->prefetch_thread = NULL;
+		object_error((t_object *)x, "prefetch thread could not be started");
+		return false;
+	}
+	return true;
+}
+
+
+/************************************************************************************************************************/
+/* THE STREAM CACHE SERVICE (STREAMING THREAD): LOADS REQUESTED CHUNKS FIRST, THEN THE LOOKAHEAD WINDOW                 */
+/************************************************************************************************************************/
+void cmbuffercloud_streamservice(t_cmbuffercloud *x) {
+	cm_stream *stream = x->stream;
+	double start_min, start_max, chunk_max;
+	long first, last, span, chunk, victim, i;
+	long cap = (stream->slots * 3) / 4; // a quarter of the cache is kept for requested chunks
+	t_ptr_size count;
+	t_int64 pos;
+	
+	// lookahead window: the chunks between start min and start max plus the longest grain at max pitch
+	start_min = x->grain_params[0] < x->grain_params[1] ? x->grain_params[0] : x->grain_params[1];
+	start_max = x->grain_params[0] < x->grain_params[1] ? x->grain_params[1] : x->grain_params[0];
+	first = (long)start_min / STREAM_CHUNKFRAMES;
+	last = ((long)start_max + (long)(x->grainlength * stream->fmt.samplerate * 0.001 * MAX_PITCH)) / STREAM_CHUNKFRAMES;
+	if (first < 0) {
+		first = 0;
+	}
+	if (last >= stream->chunkcount) {
+		last = stream->chunkcount - 1;
+	}
+	span = last - first + 1;
+	if (span > cap) {
+		// a start range larger than the cache is covered by a window that moves to a random position every STREAM_WINDOW ms
+		if (stream->window_first < first || stream->window_last > last || stream->window_last - stream->window_first + 1 != cap
+			|| gettime() - stream->window_time > STREAM_WINDOW) {
+			chunk_max = (double)(last - cap + 1);
+			start_min = (double)first;
+			stream->window_first = (long)cm_random(&start_min, &chunk_max);
+			stream->window_last = stream->window_first + cap - 1;
+			stream->window_time = gettime();
+		}
+	}
+	else {
+		stream->window_first = first;
+		stream->window_last = last;
+	}
+	
+	while (!x->prefetch_quit) {
+		// pick the next chunk: requested chunks first, then the first chunk of the window that is not cached
+		systhread_mutex_lock(x->src_mutex);
+		chunk = -1;
+		while (stream->queue_head != stream->queue_tail && chunk < 0) {
+			chunk = stream->queue[stream->queue_head];
+			stream->queue_head = (stream->queue_head + 1) % STREAM_QUEUE;
+			if (stream->chunk_slot[chunk] >= 0) {
+				chunk = -1;
+			}
+		}
+		for (i = stream->window_first; chunk < 0 && i <= stream->window_last; i++) {
+			if (stream->chunk_slot[i] < 0) {
+				chunk = i;
+			}
+		}
+		if (chunk < 0) {
+			systhread_mutex_unlock(x->src_mutex);
+			return;
+		}
+		// replace an empty slot or the least recently used slot outside the window
+		victim = -1;
+		for (i = 0; i < stream->slots; i++) {
+			if (stream->slot_chunk[i] < 0) {
+				victim = i;
+				break;
+			}
+			if (stream->slot_ready[i] && (stream->slot_chunk[i] < stream->window_first || stream->slot_chunk[i] > stream->window_last)
+				&& (victim < 0 || stream->slot_used[i] < stream->slot_used[victim])) {
+				victim = i;
+			}
+		}
+		if (victim < 0) {
+			systhread_mutex_unlock(x->src_mutex);
+			return;
+		}
+		if (stream->slot_chunk[victim] >= 0) {
+			stream->chunk_slot[stream->slot_chunk[victim]] = -1;
+		}
+		stream->slot_chunk[victim] = chunk;
+		stream->slot_ready[victim] = false;
+		stream->chunk_slot[chunk] = victim;
+		systhread_mutex_unlock(x->src_mutex);
+		
+		// the audio thread does not read the slot while it is loaded
+		pos = stream->dataoffset + ((t_int64)chunk * stream->chunkbytes);
+		count = stream->chunkbytes;
+		if (chunk == stream->chunkcount - 1) {
+			count = (t_ptr_size)((stream->fmt.framecount - ((t_int64)chunk * STREAM_CHUNKFRAMES)) * stream->fmt.framebytes);
+		}
+		sysfile_setpos(stream->fh, SYSFILE_FROMSTART, (t_ptr_int)pos);
+		sysfile_read(stream->fh, &count, stream->cache + ((t_int64)victim * stream->chunkbytes));
+		
+		systhread_mutex_lock(x->src_mutex);
+		stream->slot_ready[victim] = true;
+		stream->slot_used[victim] = stream->generation;
+		systhread_mutex_unlock(x->src_mutex);
+	}
+}
+
+
+/************************************************************************************************************************/
+/* THE SPEAKER GAIN TABLE BUILD METHOD (MAIN THREAD)                                                                    */
+/************************************************************************************************************************/
+void cmbuffercloud_spktable_build(t_cmbuffercloud *x) {
+	cm_spkentry *table_old;
+	cm_spkentry *table_new = cm_spktable_new(x->spk_azimuth, x->spk_elevation, x->spk_count, x->attr_panlaw == gensym("dbap"));
+	if (table_new == NULL) {
+		object_error((t_object *)x, "out of memory");
+		return;
+	}
+	// the perform routine holds the lock while it reads the table
+	systhread_mutex_lock(x->spk_mutex);
+	table_old = x->spk_table;
+	x->spk_table = table_new;
+	systhread_mutex_unlock(x->spk_mutex);
+	sysmem_freeptr(table_old);
+}
+
+
+/************************************************************************************************************************/
+/* THE MULTICHANNEL OUTPUTS METHOD                                                                                      */
+/************************************************************************************************************************/
+long cmbuffercloud_multichanneloutputs(t_cmbuffercloud *x, long outletindex) {
+	if (x->attr_outmode == ps_speakers && outletindex == 0) {
+		return x->attr_chans;
+	}
+	if (x->attr_outmode == ps_ambisonic && outletindex == 0) {
+		return (x->attr_order + 1) * (x->attr_order + 1);
+	}
+	if (x->attr_outmode == ps_stereo && outletindex < 2) {
+		return x->attr_buses;
+	}
+	return 1;
+}
+
+
+/************************************************************************************************************************/
+/* THE DSP CHAIN UPDATE METHOD (NUMBER OF OUTPUT CHANNELS CHANGED)                                                      */
+/************************************************************************************************************************/
+void cmbuffercloud_dspchain_update(t_cmbuffercloud *x) {
+	t_dspchain *chain = dspchain_fromobject((t_object *)x);
+	if (chain) {
+		dspchain_setbroken(chain);
+	}
+}
+
+/************************************************************************************************************************/
+/* THE PREVIEW METHOD                                                                                                   */
+/************************************************************************************************************************/
+void cmbuffercloud_preview(t_cmbuffercloud *x, t_symbol *s, long ac, t_atom *av) {
+	long arg = atom_getlong(av);
+	if (ac && av) {
+		if (arg < 1) {
+			x->preview_request = false;
+		}
+		else if (x->attr_source == ps_corpus) {
+			object_error((t_object *)x, "preview is not available for the corpus source");
+		}
+		else {
+			x->preview_playhead = 0;
+			x->preview_request = true;
+		}
+	}
+	else {
+		object_error((t_object *)x, "argument required (preview start / stop)");
+	}
+}
+
+/************************************************************************************************************************/
+/* THE BANG METHOD                                                                                                      */
+/************************************************************************************************************************/
+void cmbuffercloud_bang(t_cmbuffercloud *x) {
+	x->bang_trigger = true;
+}
+
+
+/************************************************************************************************************************/
+/* THE STEREO ATTRIBUTE SET METHOD                                                                                      */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_stereo_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		x->attr_stereo = atom_getlong(av)? 1 : 0;
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE WINDOW INTERPOLATION ATTRIBUTE SET METHOD                                                                        */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_winterp_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		x->attr_winterp = atom_getlong(av)? 1 : 0;
+		if (x->wintable_qelem) { // the window table is rewritten with or without interpolation
+			qelem_set(x->wintable_qelem);
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE SAMPLE INTERPOLATION ATTRIBUTE SET METHOD                                                                        */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_sinterp_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		x->attr_sinterp = atom_getlong(av)? 1 : 0;
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE ZERO CROSSING ATTRIBUTE SET METHOD                                                                               */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_zero_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		x->attr_zero = atom_getlong(av)? 1 : 0;
+	}
+	return MAX_ERR_NONE;
+}
+
+/************************************************************************************************************************/
+/* THE REVERSE ATTRIBUTE SET METHOD                                                                                     */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_reverse_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		t_symbol *off = gensym("off");
+		t_symbol *on = gensym("on");
+		t_symbol *random = gensym("random");
+		t_symbol *direction = gensym("direction");
+		if (arg != off && arg != on && arg != random && arg != direction) {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are off | on | random | direction");
+		}
+		else {
+			x->attr_reverse = arg;
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE CHANNEL ATTRIBUTE SET METHOD                                                                                     */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_channel_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		if (atom_getlong(av) < 1) {
+			object_error((t_object *)x, "source channel must be 1 or higher");
+		}
+		else {
+			x->attr_channel = atom_getlong(av);
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE CHANNEL MODE ATTRIBUTE SET METHOD                                                                                */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_chanmode_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		t_symbol *fixed = gensym("fixed");
+		t_symbol *random = gensym("random");
+		t_symbol *list = gensym("list");
+		if (arg != fixed && arg != random && arg != list) {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are fixed | random | list");
+		}
+		else {
+			x->attr_chanmode = arg;
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE OUTPUT MODE ATTRIBUTE SET METHOD                                                                                 */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_outmode_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		if (arg != ps_stereo && arg != ps_speakers && arg != ps_ambisonic && arg != ps_binaural) {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are stereo | speakers | ambisonic | binaural");
+		}
+		else if (arg != x->attr_outmode) {
+			x->attr_outmode = arg;
+			cmbuffercloud_dspchain_update(x);
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE PANNING LAW ATTRIBUTE SET METHOD                                                                                 */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_panlaw_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		t_symbol *vbap = gensym("vbap");
+		t_symbol *dbap = gensym("dbap");
+		if (arg != vbap && arg != dbap) {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are vbap | dbap");
+		}
+		else {
+			x->attr_panlaw = arg;
+			if (x->spk_mutex) { // rebuild the speaker gain table once the object has been set up
+				cmbuffercloud_spktable_build(x);
+			}
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE CHANS ATTRIBUTE SET METHOD                                                                                       */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_chans_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	long i;
+	if (ac && av) {
+		long arg = atom_getlong(av);
+		if (arg < 2 || arg > MAX_SPEAKERS) {
+			object_error((t_object *)x, "number of speakers must be between 2 and %d", MAX_SPEAKERS);
+		}
+		else if (arg != x->attr_chans) {
+			x->attr_chans = arg;
+			if (x->spk_mutex) { // reset to an equally spaced ring once the object has been set up
+				x->spk_count = arg;
+				for (i = 0; i < arg; i++) {
+					x->spk_azimuth[i] = -360.0 * i / arg;
+					if (x->spk_azimuth[i] < -180.0) {
+						x->spk_azimuth[i] += 360.0;
+					}
+					x->spk_elevation[i] = 0.0;
+				}
+				cmbuffercloud_spktable_build(x);
+				cmbuffercloud_dspchain_update(x);
+			}
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE AMBISONIC ORDER ATTRIBUTE SET METHOD                                                                             */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_order_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		long arg = atom_getlong(av);
+		if (arg < 1 || arg > MAX_ORDER) {
+			object_error((t_object *)x, "ambisonic order must be between 1 and %d", MAX_ORDER);
+		}
+		else if (arg != x->attr_order) {
+			x->attr_order = arg;
+			if (x->attr_outmode == ps_ambisonic) {
+				cmbuffercloud_dspchain_update(x);
+			}
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE OUTPUT BUSES ATTRIBUTE SET METHOD                                                                                */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_buses_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		long arg = atom_getlong(av);
+		if (arg < 1 || arg > MAX_BUSES) {
+			object_error((t_object *)x, "number of output buses must be between 1 and %d", MAX_BUSES);
+		}
+		else if (arg != x->attr_buses) {
+			x->attr_buses = arg;
+			if (x->attr_outmode == ps_stereo) {
+				cmbuffercloud_dspchain_update(x);
+			}
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE BUS MODE ATTRIBUTE SET METHOD                                                                                    */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_busmode_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		if (arg != gensym("random") && arg != gensym("weighted") && arg != gensym("range")) {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are random | weighted | range");
+		}
+		else {
+			x->attr_busmode = arg;
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE BUS PARAMETER ATTRIBUTE SET METHOD                                                                               */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_busparam_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		if (arg != gensym("start") && arg != gensym("length") && arg != gensym("pitch") && arg != gensym("pan") && arg != gensym("gain")) {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are start | length | pitch | pan | gain");
+		}
+		else {
+			x->attr_busparam = arg;
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE FILTER ATTRIBUTE SET METHOD                                                                                      */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_filter_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		if (arg == gensym("off")) {
+			x->filter_type = 0;
+		}
+		else if (arg == gensym("lowpass")) {
+			x->filter_type = 1;
+		}
+		else if (arg == gensym("highpass")) {
+			x->filter_type = 2;
+		}
+		else if (arg == gensym("bandpass")) {
+			x->filter_type = 3;
+		}
+		else if (arg == gensym("notch")) {
+			x->filter_type = 4;
+		}
+		else {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are off | lowpass | highpass | bandpass | notch");
+			return MAX_ERR_NONE;
+		}
+		x->attr_filter = arg;
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE SOURCE ATTRIBUTE SET METHOD                                                                                      */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_source_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		if (arg != gensym("buffer") && arg != ps_file && arg != ps_stream && arg != ps_store && arg != ps_corpus) {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are buffer | file | stream | store | corpus");
+		}
+		else {
+			x->attr_source = arg;
+			x->buffer_modified = true; // restore the sample buffer~ information
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE UNDERRUN ATTRIBUTE SET METHOD                                                                                    */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_underrun_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		if (arg != gensym("silence") && arg != gensym("defer")) {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are silence | defer");
+		}
+		else {
+			x->attr_underrun = arg;
+			x->stream_deferred = false;
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE STORE FORMAT ATTRIBUTE SET METHOD                                                                                */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_storeformat_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		if (arg != gensym("int16") && arg != gensym("bfp16") && arg != gensym("bfp8")) {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are int16 | bfp16 | bfp8");
+		}
+		else {
+			x->attr_storeformat = arg; // used by the next store message
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE CORPUS MODE ATTRIBUTE SET METHOD                                                                                 */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_corpusmode_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		if (arg != gensym("random") && arg != gensym("weighted") && arg != gensym("index")) {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are random | weighted | index");
+		}
+		else {
+			x->attr_corpusmode = arg;
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE ONSET MODE ATTRIBUTE SET METHOD                                                                                  */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_onsetmode_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		if (arg == gensym("off")) {
+			x->onset_mode = 0;
+		}
+		else if (arg == gensym("snap")) {
+			x->onset_mode = 1;
+		}
+		else if (arg == gensym("constrain")) {
+			x->onset_mode = 2;
+		}
+		else {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are off | snap | constrain");
+			return MAX_ERR_NONE;
+		}
+		x->attr_onsetmode = arg;
+		if (x->onset_mode && !x->onsets) { // the index is built the first time it is used
+			cmbuffercloud_analysisrequest(x);
+		}
+		else if (!x->onset_mode && x->onsets) { // the index is freed when it is no longer used
+			long *onsets_old;
+			systhread_mutex_lock(x->index_mutex);
+			onsets_old = x->onsets;
+			x->onsets = NULL;
+			x->onsets_count = 0;
+			systhread_mutex_unlock(x->index_mutex);
+			sysmem_freeptr(onsets_old);
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE ZERO CROSSING SNAP ATTRIBUTE SET METHOD                                                                          */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_zerosnap_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		if (arg == gensym("off")) {
+			x->zero_mode = 0;
+		}
+		else if (arg == gensym("start")) {
+			x->zero_mode = 1;
+		}
+		else if (arg == gensym("both")) {
+			x->zero_mode = 2;
+		}
+		else {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are off | start | both");
+			return MAX_ERR_NONE;
+		}
+		x->attr_zerosnap = arg;
+		if (x->zero_mode && !x->zeros) { // the index is built the first time it is used
+			cmbuffercloud_analysisrequest(x);
+		}
+		else if (!x->zero_mode && x->zeros) { // the index is freed when it is no longer used
+			long **zeros_old;
+			long *zeros_count_old;
+			long zeros_channels_old;
+			systhread_mutex_lock(x->index_mutex);
+			zeros_old = x->zeros;
+			zeros_count_old = x->zeros_count;
+			zeros_channels_old = x->zeros_channels;
+			x->zeros = NULL;
+			x->zeros_count = NULL;
+			x->zeros_channels = 0;
+			systhread_mutex_unlock(x->index_mutex);
+			cm_zeros_free(zeros_old, zeros_count_old, zeros_channels_old);
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE DESCRIPTORS ATTRIBUTE SET METHOD                                                                                 */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_descriptors_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		x->attr_descriptors = atom_getlong(av) ? 1 : 0;
+		if (x->attr_descriptors && !x->desctree) { // the tree is built the first time it is used
+			cmbuffercloud_analysisrequest(x);
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE PSOLA ATTRIBUTE SET METHOD                                                                                       */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_psola_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		x->attr_psola = atom_getlong(av) ? 1 : 0;
+		x->psola_hop = 0.0; // the first grain is triggered immediately
+		if (x->attr_psola && !x->marks) { // the marks are built the first time they are used
+			cmbuffercloud_analysisrequest(x);
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE PERIODS ATTRIBUTE SET METHOD                                                                                     */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_periods_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		double arg = atom_getfloat(av);
+		if (arg < 1.0) {
+			object_error((t_object *)x, "periods must be 1 or larger - setting to 1");
+			arg = 1.0;
+		}
+		else if (arg > MAX_PERIODS) {
+			object_error((t_object *)x, "periods must not be larger than %d - setting to %d", MAX_PERIODS, MAX_PERIODS);
+			arg = MAX_PERIODS;
+		}
+		x->attr_periods = arg;
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE RESAMPLE ATTRIBUTE SET METHOD                                                                                    */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_resample_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		x->attr_resample = atom_getlong(av) ? 1 : 0;
+		// the copy is made (or removed) together with the indices
+		if (x->attr_resample != (x->resampled != NULL)) {
+			x->analysis_request = true; // not through the request method, which ignores requests without indices
+			if (x->analysis_qelem) {
+				qelem_set(x->analysis_qelem);
+			}
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE SCAN ATTRIBUTE SET METHOD                                                                                        */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_scan_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		x->attr_scan = atom_getlong(av) ? 1 : 0;
+		if (x->attr_scan && !x->wsola) { // the alignment job is allocated the first time scan mode is used
+			x->wsola = cm_wsola_new();
+			if (!x->wsola) {
+				object_error((t_object *)x, "memory allocation failed for the scan alignment");
+				x->attr_scan = 0;
+				return MAX_ERR_NONE;
+			}
+		}
+		if (x->attr_scan && !x->wsola_thread) { // the alignment thread only runs while scan mode is on
+			x->wsola_quit = false;
+			if (systhread_create((method)cmbuffercloud_wsolathread, x, 0, 0, 0, &x->wsola_thread) != MAX_ERR_NONE) {
+				x->wsola_thread = NULL;
+				object_error((t_object *)x, "scan alignment thread could not be started");
+				x->attr_scan = 0;
+			}
+		}
+		else if (!x->attr_scan && x->wsola_thread) {
+			unsigned int ret;
+			x->wsola_quit = true;
+			systhread_join(x->wsola_thread, &ret);
+			x->wsola_thread = NULL;
+			systhread_mutex_lock(x->wsola_mutex);
+			x->wsola->state = WSOLA_IDLE; // a result that was not collected is dropped
+			systhread_mutex_unlock(x->wsola_mutex);
+		}
+		x->scan_reset = true;
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE STRETCH ATTRIBUTE SET METHOD                                                                                     */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_stretch_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		double arg = atom_getfloat(av);
+		if (arg < -MAX_STRETCH) {
+			object_error((t_object *)x, "stretch must not be smaller than %.1f - setting to %.1f", -MAX_STRETCH, -MAX_STRETCH);
+			arg = -MAX_STRETCH;
+		}
+		else if (arg > MAX_STRETCH) {
+			object_error((t_object *)x, "stretch must not be larger than %.1f - setting to %.1f", MAX_STRETCH, MAX_STRETCH);
+			arg = MAX_STRETCH;
+		}
+		x->attr_stretch = arg;
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE HOP ATTRIBUTE SET METHOD                                                                                         */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_hop_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		double arg = atom_getfloat(av);
+		if (arg < MIN_HOP) {
+			object_error((t_object *)x, "hop must be %.1f ms or larger - setting to %.1f", MIN_HOP, MIN_HOP);
+			arg = MIN_HOP;
+		}
+		else if (arg > MAX_HOP) {
+			object_error((t_object *)x, "hop must not be larger than %.1f ms - setting to %.1f", MAX_HOP, MAX_HOP);
+			arg = MAX_HOP;
+		}
+		x->attr_hop = arg;
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE SEEK ATTRIBUTE SET METHOD                                                                                        */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_seek_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		double arg = atom_getfloat(av);
+		if (arg < 0.0) {
+			object_error((t_object *)x, "seek must not be negative - setting to 0");
+			arg = 0.0;
+		}
+		else if (arg > MAX_SEEK) {
+			object_error((t_object *)x, "seek must not be larger than %.1f ms - setting to %.1f", MAX_SEEK, MAX_SEEK);
+			arg = MAX_SEEK;
+		}
+		x->attr_seek = arg;
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE SCAN WRAP METHOD: WRAPS A PLAYHEAD POSITION INTO THE SCAN RANGE                                                  */
+/************************************************************************************************************************/
+double cmbuffercloud_scanwrap(t_cmbuffercloud *x, double pos) {
+	double span = x->scan_hi - x->scan_lo;
+	if (span <= 0.0) {
+		return x->scan_lo;
+	}
+	if (pos < x->scan_lo || pos >= x->scan_hi) {
+		pos = x->scan_lo + fmod(pos - x->scan_lo, span);
+		if (pos < x->scan_lo) {
+			pos += span;
+		}
+	}
+	return pos;
+}
+
+
+/************************************************************************************************************************/
+/* THE SCAN ALIGNMENT POST METHOD (AUDIO THREAD): COPIES THE FRAMES COMPARED FOR THE NEXT GRAIN INTO THE ALIGNMENT JOB  */
+/************************************************************************************************************************/
+void cmbuffercloud_wsolapost(t_cmbuffercloud *x, float *b_sample, cm_mapfile *map, cm_stream *stream, cm_store *store, long channel, long start, double hop) {
+	cm_wsola *wsola = x->wsola;
+	long length = (long)(hop * x->randomized[2]); // frames read by the current grain during one hop
+	long range = (long)(x->attr_seek * x->b_m_sr);
+	long reference = start + length; // the next grain continues the current grain one hop after its start
+	long target = (long)cmbuffercloud_scanwrap(x, x->scan_pos + hop * x->attr_stretch * x->sr_ratio);
+	long search_start;
+	if (length > WSOLA_MAXLEN) {
+		length = WSOLA_MAXLEN;
+	}
+	if (range > WSOLA_MAXSEEK) {
+		range = WSOLA_MAXSEEK;
+	}
+	if (length < 1 || range < 1 || reference + length > x->b_framecount || length + 2 * range > x->b_framecount) {
+		return;
+	}
+	search_start = target - range;
+	if (search_start > x->b_framecount - length - 2 * range) {
+		search_start = x->b_framecount - length - 2 * range;
+	}
+	if (search_start < 0) {
+		search_start = 0;
+	}
+	// streaming source: frames that are not cached yet are requested, the next grain is not aligned
+	if (stream && (cm_streamrequest(stream, reference, length) || cm_streamrequest(stream, search_start, length + 2 * range))) {
+		return;
+	}
+	// a job the alignment thread has not started yet is replaced, a running job is not touched
+	if (systhread_mutex_trylock(x->wsola_mutex) == 0) {
+		if (wsola->state != WSOLA_RUNNING) {
+			cmbuffercloud_sourceread(x, wsola->ref, b_sample, map, stream, store, channel, reference, length);
+			cmbuffercloud_sourceread(x, wsola->search, b_sample, map, stream, store, channel, search_start, length + 2 * range);
+			wsola->length = length;
+			wsola->range = range;
+			wsola->search_start = search_start;
+			wsola->target = target;
+			wsola->state = WSOLA_PENDING;
+		}
+		systhread_mutex_unlock(x->wsola_mutex);
+	}
+}
+
+
+/************************************************************************************************************************/
+/* THE ALIGNMENT THREAD: COMPUTES THE ALIGNED START OF THE NEXT SCAN GRAIN                                              */
+/************************************************************************************************************************/
+void *cmbuffercloud_wsolathread(t_cmbuffercloud *x) {
+	cm_wsola *wsola = x->wsola;
+	t_bool run;
+	long lag;
+	while (!x->wsola_quit) {
+		systhread_mutex_lock(x->wsola_mutex);
+		run = (wsola->state == WSOLA_PENDING);
+		if (run) {
+			wsola->state = WSOLA_RUNNING;
+		}
+		systhread_mutex_unlock(x->wsola_mutex);
+		if (run) { // the perform routine does not write the job while it is running
+			lag = cm_wsola_align(wsola);
+			systhread_mutex_lock(x->wsola_mutex);
+			wsola->result = wsola->search_start + lag;
+			wsola->state = WSOLA_DONE;
+			systhread_mutex_unlock(x->wsola_mutex);
+			continue;
+		}
+		systhread_sleep(WSOLA_INTERVAL);
+	}
+	systhread_exit(0);
+	return NULL;
+}
+
+
+/************************************************************************************************************************/
+/* THE SOURCE READ METHOD: COPIES ONE CHANNEL OF THE SAMPLE SOURCE INTO CONTIGUOUS MEMORY (PLANAR READ PATH)            */
+/************************************************************************************************************************/
+void cmbuffercloud_sourceread(t_cmbuffercloud *x, double *dest, float *b_sample, cm_mapfile *map, cm_stream *stream, cm_store *store, long channel, long start, long frames) {
+	if (map) {
+		cm_mapread(dest, map, channel, start, frames);
+	}
+	else if (stream) { // chunks that are not cached are read as silence
+		cm_streamread(dest, stream, channel, start, frames);
+	}
+	else if (store) { // the compressed store is decoded block by block
+		cm_storeread(dest, store, channel, start, frames);
+	}
+	else {
+		cm_deinterleave(dest, b_sample, x->b_channelcount, x->b_framecount, channel, start, frames);
+	}
+}
+
+
+/************************************************************************************************************************/
+/* THE CACHE ATTRIBUTE SET METHOD                                                                                       */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_cache_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	char name[MAX_FILENAME_CHARS];
+	char fullpath[MAX_PATH_CHARS];
+	short path;
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		x->cache_dir[0] = '\0';
+		if (arg != gensym("")) {
+			if (path_frompathname(arg->s_name, &path, name) || name[0] != '\0') {
+				object_error((t_object *)x, "cache folder %s does not exist", arg->s_name);
+				arg = gensym("");
+			}
+			else {
+				path_toabsolutesystempath(path, "", fullpath);
+				path_nameconform(fullpath, x->cache_dir, PATH_STYLE_NATIVE, PATH_TYPE_ABSOLUTE);
+			}
+		}
+		x->attr_cache = arg;
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE TOLERANCE ATTRIBUTE SET METHOD                                                                                   */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_tolerance_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		double arg = atom_getfloat(av);
+		if (arg <= 0.0) {
+			object_error((t_object *)x, "tolerance must be greater than 0 - setting to 0.1");
+			arg = 0.1;
+		}
+		x->attr_tolerance = arg;
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE NEIGHBORS ATTRIBUTE SET METHOD                                                                                   */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_neighbors_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_atom_long arg = atom_getlong(av);
+		if (arg < 1) {
+			object_error((t_object *)x, "neighbors must be 1 or larger - setting to 1");
+			arg = 1;
+		}
+		else if (arg > MAX_NEIGHBORS) {
+			object_error((t_object *)x, "neighbors must not be larger than %d - setting to %d", MAX_NEIGHBORS, MAX_NEIGHBORS);
+			arg = MAX_NEIGHBORS;
+		}
+		x->attr_neighbors = arg;
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE ONSET THRESHOLD ATTRIBUTE SET METHOD                                                                             */
+/************************************************************************************************************************/
+t_max_err cmbuffercloud_onsetthresh_set(t_cmbuffercloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		double arg = atom_getfloat(av);
+		if (arg < 1.0) {
+			object_error((t_object *)x, "onset threshold must be 1 or larger - setting to 1");
+			arg = 1.0;
+		}
+		x->attr_onsetthresh = arg;
+		cmbuffercloud_analysisrequest(x);
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* CUSTOM FUNCTIONS																										*/
+/************************************************************************************************************************/
+// constant power stereo function
+void cm_panning(cm_panstruct *panstruct, double *pos, t_cmbuffercloud *x) {
+	panstruct->left = x->root2ovr2 * (cos((*pos * x->piovr2) * 0.5) - sin((*pos * x->piovr2) * 0.5));
+	panstruct->right = x->root2ovr2 * (cos((*pos * x->piovr2) * 0.5) + sin((*pos * x->piovr2) * 0.5));
+	return;
+}
+// RANDOM NUMBER GENERATOR (USE POINTERS FOR MORE EFFICIENCY)
+double cm_random(double *min, double *max) {
+#ifdef MAC_VERSION
+	return *min + ((*max - *min) * (((double)arc4random_uniform(RANDMAX)) / (double)RANDMAX));
+#endif
+#ifdef WIN_VERSION
+	return *min + ((*max - *min) * ((double)(rand() % RANDMAX) / (double)RANDMAX));
+#endif
+}
+// RANDOM REVERSE FLAG GENERATOR
+t_bool cm_randomreverse() {
+	double flag;
+#ifdef MAC_VERSION
+	flag = 0.0 + ((1.0 - 0.0) * (((double)arc4random_uniform(RANDMAX)) / (double)RANDMAX));
+#endif
+#ifdef WIN_VERSION
+	flag = 0.0 + ((1.0 - 0.0) * ((double)(rand() % RANDMAX) / (double)RANDMAX));
+#endif
+	if (flag > 0.5) {
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+// LINEAR INTERPOLATION FUNCTION
+double cm_lininterp(double distance, float *buffer, t_atom_long b_channelcount, t_atom_long b_framecount, short channel) {
+	long index = (long)distance; // get truncated index
+	long next = index + 1;
+	if (next > b_framecount) {
+		next = 0;
+	}
+	distance -= (long)distance; // calculate fraction value for interpolation
 	return buffer[index * b_channelcount + channel] + distance * (buffer[next * b_channelcount + channel] - buffer[index * b_channelcount + channel]);
 }
+// SPEAKER GAIN TABLE: gains for all quantized grain directions (azimuth major, elevation minor)
+cm_spkentry *cm_spktable_new(double *azimuth, double *elevation, long count, t_bool dbap) {
+	long a, e, i;
+	double dir[3];
+	double spk[MAX_SPEAKERS][3];
+	t_bool planar = true;
+	cm_spkentry *table = (cm_spkentry *)sysmem_newptrclear(SPK_AZSTEPS * SPK_ELSTEPS * sizeof(cm_spkentry));
+	if (table == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < count; i++) {
+		cm_direction(spk[i], azimuth[i], elevation[i]);
+		if (fabs(elevation[i]) > 0.5) {
+			planar = false;
+		}
+	}
+	for (a = 0; a < SPK_AZSTEPS; a++) {
+		for (e = 0; e < SPK_ELSTEPS; e++) {
+			if (planar && e > 0 && !dbap) { // horizontal layouts only depend on the azimuth
+				table[a * SPK_ELSTEPS + e] = table[a * SPK_ELSTEPS];
+				continue;
+			}
+			cm_direction(dir, ((double)a * 360.0 / SPK_AZSTEPS) - 180.0, planar && !dbap ? 0.0 : ((double)e * 180.0 / (SPK_ELSTEPS - 1)) - 90.0);
+			if (dbap) {
+				cm_dbap(&table[a * SPK_ELSTEPS + e], dir, spk, count);
+			}
+			else {
+				cm_vbap(&table[a * SPK_ELSTEPS + e], dir, spk, count, planar);
+			}
+		}
+	}
+	return table;
+}
+// VBAP: of all speaker pairs (planar) or triplets of the nearest speakers that enclose the direction, use the one with the smallest gain sum (smallest aperture)
+void cm_vbap(cm_spkentry *entry, double *dir, double (*spk)[3], long count, t_bool planar) {
+	long i, j, k, m, t;
+	long near[SPK_NEAREST];
+	long nearcount = 0;
+	double dot, det, norm;
+	double g[3];
+	double best_sum = -1.0;
+	double best_dot = -2.0;
+	entry->count = 0;
+	if (planar) {
+		for (i = 0; i < count; i++) {
+			for (j = i + 1; j < count; j++) {
+				det = spk[i][0] * spk[j][1] - spk[i][1] * spk[j][0];
+				if (fabs(det) < 1e-9) {
+					continue;
+				}
+				g[0] = (dir[0] * spk[j][1] - dir[1] * spk[j][0]) / det;
+				g[1] = (spk[i][0] * dir[1] - spk[i][1] * dir[0]) / det;
+				if (g[0] > -1e-9 && g[1] > -1e-9 && (best_sum < 0.0 || g[0] + g[1] < best_sum)) {
+					best_sum = g[0] + g[1];
+					entry->spk[0] = i;
+					entry->spk[1] = j;
+					entry->gain[0] = g[0] > 0.0 ? g[0] : 0.0;
+					entry->gain[1] = g[1] > 0.0 ? g[1] : 0.0;
+					entry->count = 2;
+				}
+			}
+		}
+	}
+	else {
+		// find the nearest speakers (insertion sort by dot product)
+		for (i = 0; i < count; i++) {
+			dot = dir[0] * spk[i][0] + dir[1] * spk[i][1] + dir[2] * spk[i][2];
+			for (m = nearcount; m > 0; m--) {
+				if (dir[0] * spk[near[m-1]][0] + dir[1] * spk[near[m-1]][1] + dir[2] * spk[near[m-1]][2] >= dot) {
+					break;
+				}
+				if (m < SPK_NEAREST) {
+					near[m] = near[m-1];
+				}
+			}
+			if (m < SPK_NEAREST) {
+				near[m] = i;
+				if (nearcount < SPK_NEAREST) {
+					nearcount++;
+				}
+			}
+		}
+		for (i = 0; i < nearcount; i++) {
+			for (j = i + 1; j < nearcount; j++) {
+				for (k = j + 1; k < nearcount; k++) {
+					double *l1 = spk[near[i]];
+					double *l2 = spk[near[j]];
+					double *l3 = spk[near[k]];
+					det = l1[0] * (l2[1] * l3[2] - l2[2] * l3[1]) - l1[1] * (l2[0] * l3[2] - l2[2] * l3[0]) + l1[2] * (l2[0] * l3[1] - l2[1] * l3[0]);
+					if (fabs(det) < 1e-9) {
+						continue;
+					}
+					// cramer's rule for dir = g1 * l1 + g2 * l2 + g3 * l3
+					g[0] = (dir[0] * (l2[1] * l3[2] - l2[2] * l3[1]) - dir[1] * (l2[0] * l3[2] - l2[2] * l3[0]) + dir[2] * (l2[0] * l3[1] - l2[1] * l3[0])) / det;
+					g[1] = (l1[0] * (dir[1] * l3[2] - dir[2] * l3[1]) - l1[1] * (dir[0] * l3[2] - dir[2] * l3[0]) + l1[2] * (dir[0] * l3[1] - dir[1] * l3[0])) / det;
+					g[2] = (l1[0] * (l2[1] * dir[2] - l2[2] * dir[1]) - l1[1] * (l2[0] * dir[2] - l2[2] * dir[0]) + l1[2] * (l2[0] * dir[1] - l2[1] * dir[0])) / det;
+					if (g[0] > -1e-9 && g[1] > -1e-9 && g[2] > -1e-9 && (best_sum < 0.0 || g[0] + g[1] + g[2] < best_sum)) {
+						best_sum = g[0] + g[1] + g[2];
+						entry->spk[0] = near[i];
+						entry->spk[1] = near[j];
+						entry->spk[2] = near[k];
+						for (t = 0; t < 3; t++) {
+							entry->gain[t] = g[t] > 0.0 ? g[t] : 0.0;
+						}
+						entry->count = 3;
+					}
+				}
+			}
+		}
+	}
+	if (entry->count == 0) { // direction outside of the layout: use the nearest speaker
+		for (i = 0; i < count; i++) {
+			dot = dir[0] * spk[i][0] + dir[1] * spk[i][1] + dir[2] * spk[i][2];
+			if (dot > best_dot) {
+				best_dot = dot;
+				entry->spk[0] = i;
+			}
+		}
+		entry->gain[0] = 1.0;
+		entry->count = 1;
+		return;
+	}
+	// drop speakers with zero gain, then apply constant power normalization
+	m = 0;
+	for (t = 0; t < entry->count; t++) {
+		if (entry->gain[t] > 1e-6) {
+			entry->spk[m] = entry->spk[t];
+			entry->gain[m++] = entry->gain[t];
+		}
+	}
+	entry->count = m;
+	norm = 0.0;
+	for (t = 0; t < entry->count; t++) {
+		norm += entry->gain[t] * entry->gain[t];
+	}
+	norm = norm > 0.0 ? 1.0 / sqrt(norm) : 0.0;
+	for (t = 0; t < entry->count; t++) {
+		entry->gain[t] *= norm;
+	}
+}
+// DBAP: inverse distance gains (6 dB rolloff) limited to the three loudest speakers
+void cm_dbap(cm_spkentry *entry, double *dir, double (*spk)[3], long count) {
+	long i, m, t;
+	double d, gain, norm;
+	entry->count = 0;
+	for (i = 0; i < count; i++) {
+		d = (dir[0] - spk[i][0]) * (dir[0] - spk[i][0]) + (dir[1] - spk[i][1]) * (dir[1] - spk[i][1]) + (dir[2] - spk[i][2]) * (dir[2] - spk[i][2]);
+		gain = 1.0 / sqrt(d + DBAP_BLUR * DBAP_BLUR);
+		// keep the entry sorted by gain (descending)
+		for (m = entry->count; m > 0 && entry->gain[m-1] < gain; m--) {
+			if (m < SPK_ACTIVE) {
+				entry->spk[m] = entry->spk[m-1];
+				entry->gain[m] = entry->gain[m-1];
+			}
+		}
+		if (m < SPK_ACTIVE) {
+			entry->spk[m] = i;
+			entry->gain[m] = gain;
+			if (entry->count < SPK_ACTIVE) {
+				entry->count++;
+			}
+		}
+	}
+	// constant power normalization
+	norm = 0.0;
+	for (t = 0; t < entry->count; t++) {
+		norm += entry->gain[t] * entry->gain[t];
+	}
+	norm = norm > 0.0 ? 1.0 / sqrt(norm) : 0.0;
+	for (t = 0; t < entry->count; t++) {
+		entry->gain[t] *= norm;
+	}
+}
+// UNIT VECTOR FOR AZIMUTH/ELEVATION IN DEGREES (azimuth counterclockwise from the front, elevation upwards)
+void cm_direction(double *dir, double azimuth, double elevation) {
+	double az = azimuth * M_PI / 180.0;
+	double el = elevation * M_PI / 180.0;
+	dir[0] = cos(el) * cos(az);
+	dir[1] = cos(el) * sin(az);
+	dir[2] = sin(el);
+}
+// AMBISONIC ENCODING: real spherical harmonics up to 3rd order in ACN channel order with SN3D normalization (AmbiX)
+void cm_ambi_encode(double *coef, double azimuth, double elevation, long order) {
+	double az = azimuth * M_PI / 180.0;
+	double el = elevation * M_PI / 180.0;
+	double sin_el = sin(el);
+	double cos_el = cos(el);
+	coef[0] = 1.0;
+	coef[1] = sin(az) * cos_el;
+	coef[2] = sin_el;
+	coef[3] = cos(az) * cos_el;
+	if (order > 1) {
+		coef[4] = (sqrt(3.0) / 2.0) * sin(2.0 * az) * cos_el * cos_el;
+		coef[5] = (sqrt(3.0) / 2.0) * sin(az) * sin(2.0 * el);
+		coef[6] = 0.5 * (3.0 * sin_el * sin_el - 1.0);
+		coef[7] = (sqrt(3.0) / 2.0) * cos(az) * sin(2.0 * el);
+		coef[8] = (sqrt(3.0) / 2.0) * cos(2.0 * az) * cos_el * cos_el;
+	}
+	if (order > 2) {
+		coef[9] = sqrt(5.0 / 8.0) * sin(3.0 * az) * cos_el * cos_el * cos_el;
+		coef[10] = (sqrt(15.0) / 2.0) * sin(2.0 * az) * sin_el * cos_el * cos_el;
+		coef[11] = sqrt(3.0 / 8.0) * sin(az) * cos_el * (5.0 * sin_el * sin_el - 1.0);
+		coef[12] = 0.5 * sin_el * (5.0 * sin_el * sin_el - 3.0);
+		coef[13] = sqrt(3.0 / 8.0) * cos(az) * cos_el * (5.0 * sin_el * sin_el - 1.0);
+		coef[14] = (sqrt(15.0) / 2.0) * cos(2.0 * az) * sin_el * cos_el * cos_el;
+		coef[15] = sqrt(5.0 / 8.0) * cos(3.0 * az) * cos_el * cos_el * cos_el;
+	}
+	// the channels above the order are silent (the grain may have been encoded at a higher order before)
+	for (long k = (order + 1) * (order + 1); k < AMBI_CHANS; k++) {
+		coef[k] = 0.0;
+	}
+}
+// HRTF CONVOLUTION STATE: the hrirs of all directions are stored one after another in the buffer~ (channel 1 left ear, channel 2 right ear)
+cm_hrtf *cm_hrtf_new(float *hrir, long channelcount, long length, double *azel, long buckets) {
+	long b, p, i, frame;
+	long bins = CONV_BLOCK + 1;
+	long spec_size;
+	double *spec;
+	cm_hrtf *hrtf = (cm_hrtf *)sysmem_newptrclear(sizeof(cm_hrtf));
+	if (hrtf == NULL) {
+		return NULL;
+	}
+	hrtf->buckets = buckets;
+	hrtf->partitions = (length + CONV_BLOCK - 1) / CONV_BLOCK;
+	spec_size = buckets * hrtf->partitions * bins * 2;
+	hrtf->dir = (double *)sysmem_newptrclear(buckets * 3 * sizeof(double));
+	hrtf->spec_left = (double *)sysmem_newptrclear(spec_size * sizeof(double));
+	hrtf->spec_right = (double *)sysmem_newptrclear(spec_size * sizeof(double));
+	hrtf->fdl = (double *)sysmem_newptrclear(spec_size * sizeof(double));
+	hrtf->bus_in = (double *)sysmem_newptrclear(buckets * CONV_BLOCK * sizeof(double));
+	hrtf->bus_prev = (double *)sysmem_newptrclear(buckets * CONV_BLOCK * sizeof(double));
+	hrtf->idle = (long *)sysmem_newptrclear(buckets * sizeof(long));
+	hrtf->out_left = (double *)sysmem_newptrclear(CONV_BLOCK * sizeof(double));
+	hrtf->out_right = (double *)sysmem_newptrclear(CONV_BLOCK * sizeof(double));
+	hrtf->fft_buf = (double *)sysmem_newptrclear(CONV_FFTSIZE * 2 * sizeof(double));
+	hrtf->acc_left = (double *)sysmem_newptrclear(bins * 2 * sizeof(double));
+	hrtf->acc_right = (double *)sysmem_newptrclear(bins * 2 * sizeof(double));
+	hrtf->twiddle = (double *)sysmem_newptrclear(CONV_FFTSIZE * sizeof(double));
+	hrtf->bitrev = (long *)sysmem_newptrclear(CONV_FFTSIZE * sizeof(long));
+	if (!hrtf->dir || !hrtf->spec_left || !hrtf->spec_right || !hrtf->fdl || !hrtf->bus_in || !hrtf->bus_prev || !hrtf->idle || !hrtf->out_left
+		|| !hrtf->out_right || !hrtf->fft_buf || !hrtf->acc_left || !hrtf->acc_right || !hrtf->twiddle || !hrtf->bitrev) {
+		cm_hrtf_free(hrtf);
+		return NULL;
+	}
+	// fft tables
+	cm_fft_tables(hrtf->twiddle, hrtf->bitrev, CONV_FFTSIZE);
+	// bucket directions and partitioned hrir spectra (each partition is zero padded to the fft size)
+	for (b = 0; b < buckets; b++) {
+		cm_direction(hrtf->dir + (b * 3), azel[b * 2], azel[(b * 2) + 1]);
+		for (p = 0; p < hrtf->partitions; p++) {
+			for (short ear = 0; ear < 2; ear++) {
+				for (i = 0; i < CONV_FFTSIZE * 2; i++) {
+					hrtf->fft_buf[i] = 0.0;
+				}
+				for (i = 0; i < CONV_BLOCK && (p * CONV_BLOCK) + i < length; i++) {
+					frame = (b * length) + (p * CONV_BLOCK) + i;
+					hrtf->fft_buf[i * 2] = hrir[(frame * channelcount) + (channelcount > 1 ? ear : 0)];
+				}
+				cm_fft(hrtf->fft_buf, CONV_FFTSIZE, hrtf->twiddle, hrtf->bitrev, false);
+				spec = (ear ? hrtf->spec_right : hrtf->spec_left) + ((b * hrtf->partitions) + p) * bins * 2;
+				for (i = 0; i < bins * 2; i++) {
+					spec[i] = hrtf->fft_buf[i];
+				}
+			}
+		}
+	}
+	return hrtf;
+}
+void cm_hrtf_free(cm_hrtf *hrtf) {
+	if (hrtf == NULL) {
+		return;
+	}
+	sysmem_freeptr(hrtf->dir);
+	sysmem_freeptr(hrtf->spec_left);
+	sysmem_freeptr(hrtf->spec_right);
+	sysmem_freeptr(hrtf->fdl);
+	sysmem_freeptr(hrtf->bus_in);
+	sysmem_freeptr(hrtf->bus_prev);
+	sysmem_freeptr(hrtf->idle);
+	sysmem_freeptr(hrtf->out_left);
+	sysmem_freeptr(hrtf->out_right);
+	sysmem_freeptr(hrtf->fft_buf);
+	sysmem_freeptr(hrtf->acc_left);
+	sysmem_freeptr(hrtf->acc_right);
+	sysmem_freeptr(hrtf->twiddle);
+	sysmem_freeptr(hrtf->bitrev);
+	sysmem_freeptr(hrtf);
+}
+// NEAREST HRTF DIRECTION BUCKET
+long cm_hrtf_bucket(cm_hrtf *hrtf, double azimuth, double elevation) {
+	double dir[3];
+	double dot;
+	double dot_max = -2.0;
+	long bucket = 0;
+	cm_direction(dir, azimuth, elevation);
+	for (long b = 0; b < hrtf->buckets; b++) {
+		dot = dir[0] * hrtf->dir[b * 3] + dir[1] * hrtf->dir[(b * 3) + 1] + dir[2] * hrtf->dir[(b * 3) + 2];
+		if (dot > dot_max) {
+			dot_max = dot;
+			bucket = b;
+		}
+	}
+	return bucket;
+}
+// HRTF CONVOLUTION OF ONE BLOCK: uniformly partitioned overlap-save convolution of every bucket bus, the ear spectra of all buckets
+// are accumulated in the frequency domain so that only one inverse fft per block is needed (left ear real part, right ear imaginary part)
+void cm_hrtf_process(cm_hrtf *hrtf) {
+	long b, p, i, m;
+	long bins = CONV_BLOCK + 1;
+	long slot;
+	t_bool silent;
+	double *in, *prev, *spec, *h_left, *h_right;
+	double *buf = hrtf->fft_buf;
+	double *acc_l = hrtf->acc_left;
+	double *acc_r = hrtf->acc_right;
+	double norm = 1.0 / CONV_FFTSIZE;
+	
+	for (i = 0; i < bins * 2; i++) {
+		acc_l[i] = 0.0;
+		acc_r[i] = 0.0;
+	}
+	for (b = 0; b < hrtf->buckets; b++) {
+		in = hrtf->bus_in + (b * CONV_BLOCK);
+		prev = hrtf->bus_prev + (b * CONV_BLOCK);
+		silent = true;
+		for (i = 0; i < CONV_BLOCK; i++) {
+			if (in[i] != 0.0) {
+				silent = false;
+				break;
+			}
+		}
+		// a bucket that has been silent for longer than its hrir has an empty delay line and is skipped
+		if (!silent) {
+			hrtf->idle[b] = 0;
+		}
+		else if (hrtf->idle[b] > hrtf->partitions + 1) {
+			continue;
+		}
+		else {
+			hrtf->idle[b]++;
+		}
+		// input spectrum of the previous and the current block
+		for (i = 0; i < CONV_BLOCK; i++) {
+			buf[i * 2] = prev[i];
+			buf[(i * 2) + 1] = 0.0;
+			buf[(CONV_BLOCK + i) * 2] = in[i];
+			buf[((CONV_BLOCK + i) * 2) + 1] = 0.0;
+			prev[i] = in[i];
+			in[i] = 0.0;
+		}
+		cm_fft(buf, CONV_FFTSIZE, hrtf->twiddle, hrtf->bitrev, false);
+		spec = hrtf->fdl + ((b * hrtf->partitions) + hrtf->fdl_pos) * bins * 2;
+		for (i = 0; i < bins * 2; i++) {
+			spec[i] = buf[i];
+		}
+		// complex multiply-accumulate of the delay line with the hrir partitions
+		for (p = 0; p < hrtf->partitions; p++) {
+			slot = (hrtf->fdl_pos - p + hrtf->partitions) % hrtf->partitions;
+			spec = hrtf->fdl + ((b * hrtf->partitions) + slot) * bins * 2;
+			h_left = hrtf->spec_left + ((b * hrtf->partitions) + p) * bins * 2;
+			h_right = hrtf->spec_right + ((b * hrtf->partitions) + p) * bins * 2;
+			for (i = 0; i < bins * 2; i += 2) {
+				acc_l[i] += spec[i] * h_left[i] - spec[i + 1] * h_left[i + 1];
+				acc_l[i + 1] += spec[i] * h_left[i + 1] + spec[i + 1] * h_left[i];
+				acc_r[i] += spec[i] * h_right[i] - spec[i + 1] * h_right[i + 1];
+				acc_r[i + 1] += spec[i] * h_right[i + 1] + spec[i + 1] * h_right[i];
+			}
+		}
+	}
+	hrtf->fdl_pos = (hrtf->fdl_pos + 1) % hrtf->partitions;
+	// both ear spectra are hermitian: combine them into one complex spectrum (left + i * right)
+	for (i = 0; i < bins; i++) {
+		buf[i * 2] = acc_l[i * 2] - acc_r[(i * 2) + 1];
+		buf[(i * 2) + 1] = acc_l[(i * 2) + 1] + acc_r[i * 2];
+	}
+	for (i = bins; i < CONV_FFTSIZE; i++) {
+		m = CONV_FFTSIZE - i;
+		buf[i * 2] = acc_l[m * 2] + acc_r[(m * 2) + 1];
+		buf[(i * 2) + 1] = acc_r[m * 2] - acc_l[(m * 2) + 1];
+	}
+	cm_fft(buf, CONV_FFTSIZE, hrtf->twiddle, hrtf->bitrev, true);
+	// overlap-save: the second half of the block is the valid output
+	for (i = 0; i < CONV_BLOCK; i++) {
+		hrtf->out_left[i] = buf[(CONV_BLOCK + i) * 2] * norm;
+		hrtf->out_right[i] = buf[((CONV_BLOCK + i) * 2) + 1] * norm;
+	}
+}
+// MEMORY MAPPED FILE: maps the whole file read-only, the page cache only holds the parts that are actually read
+cm_mapfile *cm_mapfile_open(t_object *x, const char *path) {
+	cm_mapfile *map = (cm_mapfile *)sysmem_newptrclear(sizeof(cm_mapfile));
+	if (map == NULL) {
+		object_error(x, "out of memory");
+		return NULL;
+	}
+#ifdef MAC_VERSION
+	struct stat info;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &info) != 0) {
+		object_error(x, "file %s could not be opened", path);
+		if (fd >= 0) {
+			close(fd);
+		}
+		sysmem_freeptr(map);
+		return NULL;
+	}
+	map->size = (t_int64)info.st_size;
+	map->filesize = map->size;
+	map->base = (unsigned char *)mmap(NULL, (size_t)map->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd); // the mapping keeps the file open
+	if (map->base == (unsigned char *)MAP_FAILED) {
+		map->base = NULL;
+	}
+	else {
+		madvise(map->base, (size_t)map->size, MADV_RANDOM); // grains read at random positions, readahead is done by the prefetch thread
+	}
+#endif
+#ifdef WIN_VERSION
+	LARGE_INTEGER filesize;
+	map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (map->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(map->file, &filesize)) {
+		object_error(x, "file %s could not be opened", path);
+		if (map->file != INVALID_HANDLE_VALUE) {
+			CloseHandle(map->file);
+		}
+		sysmem_freeptr(map);
+		return NULL;
+	}
+	map->size = (t_int64)filesize.QuadPart;
+	map->filesize = map->size;
+	map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	map->base = map->mapping ? (unsigned char *)MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+#endif
+	if (map->base == NULL) {
+		object_error(x, "file %s could not be mapped into memory", path);
+		cm_mapfile_close(map);
+		return NULL;
+	}
+	if (!cm_mapfile_parse(map)) {
+		object_error(x, "file %s is not an uncompressed WAV, AIFF or CAF file", path);
+		cm_mapfile_close(map);
+		return NULL;
+	}
+	if (map->framecount > LONG_MAX) { // grain positions are long
+		object_error(x, "file %s has more frames than can be addressed", path);
+		cm_mapfile_close(map);
+		return NULL;
+	}
+	return map;
+}
+void cm_mapfile_close(cm_mapfile *map) {
+	if (map == NULL) {
+		return;
+	}
+#ifdef MAC_VERSION
+	if (map->base) {
+		munmap(map->base, (size_t)map->size);
+	}
+#endif
+#ifdef WIN_VERSION
+	if (map->base) {
+		UnmapViewOfFile(map->base);
+	}
+	if (map->mapping) {
+		CloseHandle(map->mapping);
+	}
+	if (map->file && map->file != INVALID_HANDLE_VALUE) {
+		CloseHandle(map->file);
+	}
+#endif
+	sysmem_freeptr(map);
+}
+// BYTE ORDER HELPERS FOR THE FILE HEADERS
+t_uint32 cm_le32(const unsigned char *p) {
+	return (t_uint32)p[0] | ((t_uint32)p[1] << 8) | ((t_uint32)p[2] << 16) | ((t_uint32)p[3] << 24);
+}
+t_uint32 cm_be32(const unsigned char *p) {
+	return ((t_uint32)p[0] << 24) | ((t_uint32)p[1] << 16) | ((t_uint32)p[2] << 8) | (t_uint32)p[3];
+}
+t_uint64 cm_be64(const unsigned char *p) {
+	return ((t_uint64)cm_be32(p) << 32) | (t_uint64)cm_be32(p + 4);
+}
+// FILE HEADER PARSER: finds the format and the sample data of WAV/RF64, AIFF/AIFC and CAF files (the chunk headers
+// are read from the first size bytes, the sample data may extend up to filesize)
+t_bool cm_mapfile_parse(cm_mapfile *map) {
+	const unsigned char *p = map->base;
+	const unsigned char *end = map->base + map->size;
+	const unsigned char *chunk;
+	t_uint64 chunksize;
+	t_int64 datasize = -1;
+	long bits = 0;
+	t_bool isfloat = false;
+	t_bool found_format = false;
+	double mantissa;
+	int exponent;
+	if (map->size < 12) {
+		return false;
+	}
+	if ((!memcmp(p, "RIFF", 4) || !memcmp(p, "RF64", 4) || !memcmp(p, "BW64", 4)) && !memcmp(p + 8, "WAVE", 4)) {
+		map->bigendian = false;
+		chunk = p + 12;
+		while (chunk + 8 <= end) {
+			chunksize = cm_le32(chunk + 4);
+			if (!memcmp(chunk, "fmt ", 4) && chunksize >= 16 && chunk + 24 <= end) {
+				long tag = chunk[8] | (chunk[9] << 8);
+				if (tag == 0xFFFE && chunksize >= 40 && chunk + 34 <= end) { // extensible format: the sub format holds the tag
+					tag = chunk[32] | (chunk[33] << 8);
+				}
+				map->channelcount = chunk[10] | (chunk[11] << 8);
+				map->samplerate = (double)cm_le32(chunk + 12);
+				bits = chunk[22] | (chunk[23] << 8);
+				isfloat = (tag == 3);
+				found_format = (tag == 1 || tag == 3);
+			}
+			else if (!memcmp(chunk, "data", 4)) {
+				map->data = (unsigned char *)chunk + 8;
+				datasize = (chunksize == 0xFFFFFFFF || memcmp(p, "RIFF", 4)) ? map->filesize - (map->data - map->base) : (t_int64)chunksize; // RF64: data runs to the end of the file
+				break;
+			}
+			chunk += 8 + chunksize + (chunksize & 1);
+		}
+	}
+	else if (!memcmp(p, "FORM", 4) && (!memcmp(p + 8, "AIFF", 4) || !memcmp(p + 8, "AIFC", 4))) {
+		map->bigendian = true;
+		chunk = p + 12;
+		while (chunk + 8 <= end) {
+			chunksize = cm_be32(chunk + 4);
+			if (!memcmp(chunk, "COMM", 4) && chunk + 26 <= end) {
+				map->channelcount = (chunk[8] << 8) | chunk[9];
+				bits = (chunk[14] << 8) | chunk[15];
+				// 80 bit extended sample rate
+				exponent = ((chunk[16] & 0x7F) << 8 | chunk[17]) - 16383 - 63;
+				mantissa = (double)cm_be64(chunk + 18);
+				map->samplerate = ldexp(mantissa, exponent);
+				found_format = true;
+				if (!memcmp(p + 8, "AIFC", 4) && chunk + 30 <= end) {
+					if (!memcmp(chunk + 26, "sowt", 4)) {
+						map->bigendian = false;
+					}
+					else if (!memcmp(chunk + 26, "fl32", 4) || !memcmp(chunk + 26, "FL32", 4)) {
+						isfloat = true;
+						bits = 32;
+					}
+					else if (!memcmp(chunk + 26, "fl64", 4) || !memcmp(chunk + 26, "FL64", 4)) {
+						isfloat = true;
+						bits = 64;
+					}
+					else if (memcmp(chunk + 26, "NONE", 4) && memcmp(chunk + 26, "in24", 4) && memcmp(chunk + 26, "in32", 4)) {
+						found_format = false; // compressed
+					}
+				}
+			}
+			else if (!memcmp(chunk, "SSND", 4) && chunk + 16 <= end) {
+				map->data = (unsigned char *)chunk + 16 + cm_be32(chunk + 8);
+				datasize = (t_int64)chunksize - 8 - cm_be32(chunk + 8);
+			}
+			chunk += 8 + chunksize + (chunksize & 1);
+		}
+	}
+	else if (!memcmp(p, "caff", 4)) {
+		chunk = p + 8;
+		while (chunk + 12 <= end) {
+			chunksize = cm_be64(chunk + 4);
+			if (!memcmp(chunk, "desc", 4) && chunk + 44 <= end) {
+				t_uint64 rate = cm_be64(chunk + 12);
+				t_uint32 flags = cm_be32(chunk + 24);
+				memcpy(&map->samplerate, &rate, sizeof(double));
+				map->channelcount = cm_be32(chunk + 36);
+				bits = cm_be32(chunk + 40);
+				isfloat = (flags & 1);
+				map->bigendian = !(flags & 2);
+				found_format = !memcmp(chunk + 20, "lpcm", 4);
+			}
+			else if (!memcmp(chunk, "data", 4)) {
+				map->data = (unsigned char *)chunk + 16; // skip the edit count
+				datasize = (chunksize == 0xFFFFFFFFFFFFFFFFULL) ? map->filesize - (map->data - map->base) : (t_int64)chunksize - 4; // size -1: data runs to the end of the file
+				break;
+			}
+			if (chunksize > (t_uint64)(end - chunk)) {
+				break;
+			}
+			chunk += 12 + chunksize;
+		}
+	}
+	if (!found_format || map->data == NULL || map->channelcount < 1 || map->samplerate <= 0.0) {
+		return false;
+	}
+	if (isfloat) {
+		map->format = (bits == 64) ? MAP_FLOAT64 : (bits == 32 ? MAP_FLOAT32 : 0);
+	}
+	else {
+		map->format = (bits == 16) ? MAP_INT16 : (bits == 24 ? MAP_INT24 : (bits == 32 ? MAP_INT32 : 0));
+	}
+	if (!map->format) {
+		return false;
+	}
+	map->bytes = (short)(bits / 8);
+	map->framebytes = map->bytes * map->channelcount;
+	if (datasize < 0 || (map->data - map->base) + datasize > map->filesize) { // truncated files are played up to their end
+		datasize = map->filesize - (map->data - map->base);
+	}
+	map->framecount = datasize / map->framebytes;
+	return (map->framecount > 0);
+}
+// MAPPED SAMPLE CONVERSION
+double cm_mapsample(const unsigned char *p, short format, t_bool bigendian) {
+	t_uint32 u32;
+	t_uint64 u64;
+	float f32;
+	double f64;
+	switch (format) {
+		case MAP_INT16:
+			return (double)(short)(bigendian ? (p[0] << 8 | p[1]) : (p[1] << 8 | p[0])) / 32768.0;
+		case MAP_INT24:
+			u32 = bigendian ? ((t_uint32)p[0] << 24 | (t_uint32)p[1] << 16 | (t_uint32)p[2] << 8) : ((t_uint32)p[2] << 24 | (t_uint32)p[1] << 16 | (t_uint32)p[0] << 8);
+			return (double)(int)u32 / 2147483648.0;
+		case MAP_INT32:
+			u32 = bigendian ? cm_be32(p) : cm_le32(p);
+			return (double)(int)u32 / 2147483648.0;
+		case MAP_FLOAT32:
+			u32 = bigendian ? cm_be32(p) : cm_le32(p);
+			memcpy(&f32, &u32, sizeof(float));
+			return (double)f32;
+		case MAP_FLOAT64:
+			u64 = bigendian ? cm_be64(p) : ((t_uint64)cm_le32(p + 4) << 32 | (t_uint64)cm_le32(p));
+			memcpy(&f64, &u64, sizeof(double));
+			return f64;
+	}
+	return 0.0;
+}
+// PLANAR READ FROM THE MAPPED FILE: same as cm_deinterleave, converts the sample format
+void cm_mapread(double *dest, cm_mapfile *map, long channel, t_int64 start, long frames) {
+	long i;
+	t_int64 avail = map->framecount - start;
+	const unsigned char *src = map->data + ((t_int64)start * map->framebytes) + (channel * map->bytes);
+	if (avail > frames) {
+		avail = frames;
+	}
+	for (i = 0; i < avail; i++) {
+		dest[i] = cm_mapsample(src + ((t_int64)i * map->framebytes), map->format, map->bigendian);
+	}
+	for (; i < frames; i++) {
+		dest[i] = 0.0;
+	}
+}
+// LINEAR INTERPOLATION FROM THE MAPPED FILE
+double cm_mapinterp(cm_mapfile *map, double distance, long channel) {
+	double frame[2];
+	t_int64 index = (t_int64)distance;
+	if (index >= map->framecount) {
+		return 0.0;
+	}
+	cm_mapread(frame, map, channel, index, 2);
+	return frame[0] + (distance - index) * (frame[1] - frame[0]);
+}
+// PREFETCH: asks the system to read the pages of a frame range into the page cache
+void cm_mapprefetch(cm_mapfile *map, t_int64 start, t_int64 frames) {
+	t_int64 offset, length;
+	if (start < 0) {
+		start = 0;
+	}
+	if (start >= map->framecount) {
+		return;
+	}
+	if (start + frames > map->framecount) {
+		frames = map->framecount - start;
+	}
+	offset = (map->data - map->base) + ((t_int64)start * map->framebytes);
+	length = (t_int64)frames * map->framebytes + (offset % MAP_PAGESIZE);
+	offset -= offset % MAP_PAGESIZE;
+#ifdef MAC_VERSION
+	madvise(map->base + offset, (size_t)length, MADV_WILLNEED);
+#endif
+#ifdef WIN_VERSION
+	// touch one byte per page (the read blocks the prefetch thread, never the audio thread)
+	volatile unsigned char touch;
+	for (t_int64 i = 0; i < length && offset + i < map->size; i += MAP_PAGESIZE) {
+		touch = map->base[offset + i];
+	}
+#endif
+}
+// FILE HEADER: parses the header from the beginning of an open file, the header itself is not kept
+t_bool cm_fileheader(t_object *x, const char *filename, t_filehandle fh, cm_mapfile *fmt, t_int64 *dataoffset) {
+	t_ptr_size eof, count;
+	sysfile_geteof(fh, &eof);
+	count = eof < STREAM_HEADER ? eof : STREAM_HEADER;
+	fmt->base = (unsigned char *)sysmem_newptr(count);
+	if (fmt->base == NULL) {
+		object_error(x, "out of memory");
+		return false;
+	}
+	sysfile_setpos(fh, SYSFILE_FROMSTART, 0);
+	sysfile_read(fh, &count, fmt->base);
+	fmt->size = (t_int64)count;
+	fmt->filesize = (t_int64)eof;
+	if (!cm_mapfile_parse(fmt)) {
+		object_error(x, "file %s is not an uncompressed WAV, AIFF or CAF file", filename);
+		sysmem_freeptr(fmt->base);
+		fmt->base = NULL;
+		return false;
+	}
+	if (fmt->framecount > LONG_MAX) { // grain positions are long
+		object_error(x, "file %s has more frames than can be addressed", filename);
+		sysmem_freeptr(fmt->base);
+		fmt->base = NULL;
+		return false;
+	}
+	*dataoffset = fmt->data - fmt->base;
+	sysmem_freeptr(fmt->base);
+	fmt->base = NULL;
+	fmt->data = NULL;
+	return true;
+}
+// STREAMING FILE: reads the header, the sample data is loaded chunk by chunk into a fixed size cache
+cm_stream *cm_stream_open(t_object *x, const char *filename, short path) {
+	t_filehandle fh;
+	long i;
+	cm_stream *stream;
+	
+	if (path_opensysfile(filename, path, &fh, READ_PERM)) {
+		object_error(x, "file %s could not be opened", filename);
+		return NULL;
+	}
+	stream = (cm_stream *)sysmem_newptrclear(sizeof(cm_stream));
+	if (stream == NULL) {
+		object_error(x, "out of memory");
+		sysfile_close(fh);
+		return NULL;
+	}
+	stream->fh = fh;
+	if (!cm_fileheader(x, filename, fh, &stream->fmt, &stream->dataoffset)) {
+		cm_stream_close(stream);
+		return NULL;
+	}
+	
+	// cache
+	stream->chunkbytes = STREAM_CHUNKFRAMES * stream->fmt.framebytes;
+	stream->chunkcount = (stream->fmt.framecount + STREAM_CHUNKFRAMES - 1) / STREAM_CHUNKFRAMES;
+	stream->slots = STREAM_CACHE / stream->chunkbytes;
+	if (stream->slots < 4) {
+		stream->slots = 4;
+	}
+	if (stream->slots > stream->chunkcount) {
+		stream->slots = stream->chunkcount;
+	}
+	stream->cache = (unsigned char *)sysmem_newptr((t_ptr_size)stream->slots * stream->chunkbytes);
+	stream->slot_chunk = (long *)sysmem_newptr(stream->slots * sizeof(long));
+	stream->slot_ready = (t_bool *)sysmem_newptrclear(stream->slots * sizeof(t_bool));
+	stream->slot_used = (long *)sysmem_newptrclear(stream->slots * sizeof(long));
+	stream->chunk_slot = (long *)sysmem_newptr(stream->chunkcount * sizeof(long));
+	if (!stream->cache || !stream->slot_chunk || !stream->slot_ready || !stream->slot_used || !stream->chunk_slot) {
+		object_error(x, "out of memory");
+		cm_stream_close(stream);
+		return NULL;
+	}
+	for (i = 0; i < stream->slots; i++) {
+		stream->slot_chunk[i] = -1;
+	}
+	for (i = 0; i < stream->chunkcount; i++) {
+		stream->chunk_slot[i] = -1;
+	}
+	stream->window_first = 0;
+	stream->window_last = -1;
+	return stream;
+}
+void cm_stream_close(cm_stream *stream) {
+	if (stream == NULL) {
+		return;
+	}
+	if (stream->fh) {
+		sysfile_close(stream->fh);
+	}
+	sysmem_freeptr(stream->fmt.base);
+	sysmem_freeptr(stream->cache);
+	sysmem_freeptr(stream->slot_chunk);
+	sysmem_freeptr(stream->slot_ready);
+	sysmem_freeptr(stream->slot_used);
+	sysmem_freeptr(stream->chunk_slot);
+	sysmem_freeptr(stream);
+}
+// STREAM REQUEST (AUDIO THREAD): returns the number of chunks of a frame range that are not cached and queues them for the streaming thread
+long cm_streamrequest(cm_stream *stream, long start, long frames) {
+	long chunk, slot;
+	long missing = 0;
+	long last = (start + frames - 1) / STREAM_CHUNKFRAMES;
+	if (last >= stream->chunkcount) {
+		last = stream->chunkcount - 1;
+	}
+	for (chunk = start / STREAM_CHUNKFRAMES; chunk <= last; chunk++) {
+		slot = stream->chunk_slot[chunk];
+		if (slot < 0 || !stream->slot_ready[slot]) {
+			missing++;
+			if (slot < 0 && (stream->queue_tail + 1) % STREAM_QUEUE != stream->queue_head) {
+				stream->queue[stream->queue_tail] = chunk;
+				stream->queue_tail = (stream->queue_tail + 1) % STREAM_QUEUE;
+			}
+		}
+	}
+	return missing;
+}
+// PLANAR READ FROM THE STREAM CACHE (AUDIO THREAD): same as cm_mapread, frames of chunks that are not cached are silent
+void cm_streamread(double *dest, cm_stream *stream, long channel, long start, long frames) {
+	long i, n, frame, slot, offset;
+	const unsigned char *src;
+	i = 0;
+	while (i < frames) {
+		frame = start + i;
+		offset = frame % STREAM_CHUNKFRAMES; // frame within the chunk
+		n = STREAM_CHUNKFRAMES - offset; // frames left in the chunk
+		if (n > frames - i) {
+			n = frames - i;
+		}
+		slot = (frame < stream->fmt.framecount) ? stream->chunk_slot[frame / STREAM_CHUNKFRAMES] : -1;
+		if (slot >= 0 && stream->slot_ready[slot]) {
+			if (frame + n > stream->fmt.framecount) {
+				n = stream->fmt.framecount - frame;
+			}
+			stream->slot_used[slot] = stream->generation;
+			src = stream->cache + ((t_int64)slot * stream->chunkbytes) + (offset * stream->fmt.framebytes) + (channel * stream->fmt.bytes);
+			for (long j = 0; j < n; j++) {
+				dest[i + j] = cm_mapsample(src + (j * stream->fmt.framebytes), stream->fmt.format, stream->fmt.bigendian);
+			}
+		}
+		else {
+			for (long j = 0; j < n; j++) {
+				dest[i + j] = 0.0;
+			}
+		}
+		i += n;
+	}
+}
+// LINEAR INTERPOLATION FROM THE STREAM CACHE
+double cm_streaminterp(cm_stream *stream, double distance, long channel) {
+	double frame[2];
+	long index = (long)distance;
+	if (index >= stream->fmt.framecount) {
+		return 0.0;
+	}
+	cm_streamrequest(stream, index, 2);
+	cm_streamread(frame, stream, channel, index, 2);
+	return frame[0] + (distance - index) * (frame[1] - frame[0]);
+}
+// CORPUS TABLE: frees the buffer references and the table
+void cm_corpus_free(cm_corpusentry *corpus, long count) {
+	if (corpus == NULL) {
+		return;
+	}
+	for (long i = 0; i < count; i++) {
+		object_free(corpus[i].ref);
+	}
+	sysmem_freeptr(corpus);
+}
+// ONSET DETECTION: spectral flux of the channel mix, peaks above threshold times the local mean flux are onsets.
+// returns the number of onsets, the onset frames are written in ascending order into newly allocated memory
+long cm_onsets(long **onsets, float *samples, long channelcount, long framecount, double threshold, t_bool *cancel) {
+	long frames = framecount >= ONSET_FFTSIZE ? ((framecount - ONSET_FFTSIZE) / ONSET_HOP) + 1 : 0;
+	long bins = (ONSET_FFTSIZE / 2) + 1;
+	long count = 0;
+	long last = -ONSET_MINGAP;
+	long f, i, c, first, end;
+	double sum, mag, mean;
+	double *flux = (double *)sysmem_newptrclear((frames + 1) * sizeof(double));
+	double *prev = (double *)sysmem_newptrclear(bins * sizeof(double));
+	double *buf = (double *)sysmem_newptr(ONSET_FFTSIZE * 2 * sizeof(double));
+	double *window = (double *)sysmem_newptr(ONSET_FFTSIZE * sizeof(double));
+	double *twiddle = (double *)sysmem_newptr(ONSET_FFTSIZE * sizeof(double));
+	long *bitrev = (long *)sysmem_newptr(ONSET_FFTSIZE * sizeof(long));
+	
+	*onsets = (long *)sysmem_newptr((frames + 1) * sizeof(long));
+	if (!flux || !prev || !buf || !window || !twiddle || !bitrev || !*onsets) {
+		frames = 0;
+	}
+	else {
+		cm_fft_tables(twiddle, bitrev, ONSET_FFTSIZE);
+		for (i = 0; i < ONSET_FFTSIZE; i++) {
+			window[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / ONSET_FFTSIZE);
+		}
+	}
+	// spectral flux: sum of the increases of the log compressed magnitudes
+	for (f = 0; f < frames && !*cancel; f++) {
+		for (i = 0; i < ONSET_FFTSIZE; i++) {
+			sum = 0.0;
+			for (c = 0; c < channelcount; c++) {
+				sum += samples[((f * ONSET_HOP) + i) * channelcount + c];
+			}
+			buf[i * 2] = window[i] * sum / channelcount;
+			buf[(i * 2) + 1] = 0.0;
+		}
+		cm_fft(buf, ONSET_FFTSIZE, twiddle, bitrev, false);
+		sum = 0.0;
+		for (i = 0; i < bins; i++) {
+			mag = log(1.0 + 100.0 * sqrt(buf[i * 2] * buf[i * 2] + buf[(i * 2) + 1] * buf[(i * 2) + 1]));
+			if (f > 0 && mag > prev[i]) {
+				sum += mag - prev[i];
+			}
+			prev[i] = mag;
+		}
+		flux[f] = sum / bins;
+	}
+	// peak picking with an adaptive threshold (mean flux of the surrounding frames)
+	for (f = 1; f < frames && !*cancel; f++) {
+		first = f - ONSET_WINDOW < 0 ? 0 : f - ONSET_WINDOW;
+		end = f + ONSET_WINDOW >= frames ? frames - 1 : f + ONSET_WINDOW;
+		mean = 0.0;
+		for (i = first; i <= end; i++) {
+			mean += flux[i];
+		}
+		mean /= (end - first + 1);
+		if (flux[f] > threshold * mean && flux[f] > ONSET_FLOOR && flux[f] >= flux[f - 1] && flux[f] > flux[f + 1] && f - last >= ONSET_MINGAP) {
+			// the transient lies between the centers of the previous and the current frame
+			(*onsets)[count++] = (f * ONSET_HOP) + (ONSET_FFTSIZE / 2) - ONSET_HOP;
+			last = f;
+		}
+	}
+	sysmem_freeptr(flux);
+	sysmem_freeptr(prev);
+	sysmem_freeptr(buf);
+	sysmem_freeptr(window);
+	sysmem_freeptr(twiddle);
+	sysmem_freeptr(bitrev);
+	if (count == 0 || *cancel) {
+		sysmem_freeptr(*onsets);
+		*onsets = NULL;
+		count = 0;
+	}
+	return count;
+}
+// ZERO CROSSINGS: frames of one channel where the sign changes (the frame of the pair closer to zero), in ascending order.
+// returns the number of crossings, the frames are written into newly allocated memory
+long cm_zerocrossings(long **zeros, float *samples, long channelcount, long framecount, long channel) {
+	long count = 0;
+	long i;
+	float *src = samples + channel;
+	for (i = 1; i < framecount; i++) {
+		if ((src[(i - 1) * channelcount] < 0.0f) != (src[i * channelcount] < 0.0f)) {
+			count++;
+		}
+	}
+	*zeros = count ? (long *)sysmem_newptr(count * sizeof(long)) : NULL;
+	if (*zeros == NULL) {
+		return 0;
+	}
+	count = 0;
+	for (i = 1; i < framecount; i++) {
+		if ((src[(i - 1) * channelcount] < 0.0f) != (src[i * channelcount] < 0.0f)) {
+			(*zeros)[count++] = fabs(src[(i - 1) * channelcount]) < fabs(src[i * channelcount]) ? i - 1 : i;
+		}
+	}
+	return count;
+}
+void cm_zeros_free(long **zeros, long *zeros_count, long channels) {
+	if (zeros) {
+		for (long c = 0; c < channels; c++) {
+			sysmem_freeptr(zeros[c]);
+		}
+	}
+	sysmem_freeptr(zeros);
+	sysmem_freeptr(zeros_count);
+}
+// PERIOD: period in samples of the frame in buf (real parts, DESC_FRAMESIZE samples zero padded to DESC_FFTSIZE), 0 if
+// unvoiced. the period is the first dip below DESC_VOICED of the normalized difference function computed from the
+// unbiased fft autocorrelation (yin without the energy term), refined by a parabola. acf holds lag_max + 2 values
+double cm_period(double *buf, double *acf, double *twiddle, long *bitrev, long lag_min, long lag_max) {
+	double cmnd, prev, next, shift;
+	double running = 0.0;
+	long i, lag;
+	cm_fft(buf, DESC_FFTSIZE, twiddle, bitrev, false);
+	for (i = 0; i < DESC_FFTSIZE; i++) {
+		buf[i * 2] = buf[i * 2] * buf[i * 2] + buf[(i * 2) + 1] * buf[(i * 2) + 1];
+		buf[(i * 2) + 1] = 0.0;
+	}
+	cm_fft(buf, DESC_FFTSIZE, twiddle, bitrev, true);
+	for (lag = 0; lag <= lag_max + 1; lag++) {
+		acf[lag] = buf[lag * 2] * DESC_FRAMESIZE / (DESC_FRAMESIZE - lag);
+	}
+	for (lag = 1; lag <= lag_max && acf[0] > 0.0; lag++) {
+		running += 2.0 * (acf[0] - acf[lag]);
+		cmnd = running > 0.0 ? 2.0 * (acf[0] - acf[lag]) * lag / running : 1.0;
+		if (lag >= lag_min && cmnd < DESC_VOICED) {
+			// follow the dip to its minimum
+			while (lag < lag_max && acf[lag + 1] > acf[lag]) {
+				lag++;
+			}
+			prev = acf[lag - 1];
+			next = acf[lag + 1];
+			shift = (prev - 2.0 * acf[lag] + next) != 0.0 ? 0.5 * (prev - next) / (prev - 2.0 * acf[lag] + next) : 0.0;
+			if (shift > 1.0 || shift < -1.0) {
+				shift = 0.0;
+			}
+			return lag + shift;
+		}
+	}
+	return 0.0;
+}
+// DESCRIPTORS: rms (dBFS), spectral centroid (octaves), spectral flatness and pitch (octaves, 0 = unvoiced) of the
+// channel mix per hop. returns the number of frames, written into newly allocated memory
+long cm_descriptors(cm_descframe **frames, float *samples, long channelcount, long framecount, double samplerate, t_bool *cancel) {
+	long count = framecount >= DESC_FRAMESIZE ? ((framecount - DESC_FRAMESIZE) / DESC_HOP) + 1 : 0;
+	long bins = DESC_FFTSIZE / 2;
+	long lag_min = (long)(samplerate / DESC_MAXPITCH);
+	long lag_max = (long)(samplerate / DESC_MINPITCH);
+	long f, i, c;
+	double sum, energy, power, mag_sum, weighted, log_sum, period;
+	double *buf = (double *)sysmem_newptr(DESC_FFTSIZE * 2 * sizeof(double));
+	double *window = (double *)sysmem_newptr(DESC_FRAMESIZE * sizeof(double));
+	double *twiddle = (double *)sysmem_newptr(DESC_FFTSIZE * sizeof(double));
+	long *bitrev = (long *)sysmem_newptr(DESC_FFTSIZE * sizeof(long));
+	double *acf = (double *)sysmem_newptr((lag_max + 2) * sizeof(double));
+	cm_descframe *frame;
+	
+	if (lag_max + 1 >= DESC_FRAMESIZE) {
+		lag_max = DESC_FRAMESIZE - 2;
+	}
+	*frames = (cm_descframe *)sysmem_newptr((count + 1) * sizeof(cm_descframe));
+	if (!buf || !window || !twiddle || !bitrev || !acf || !*frames) {
+		count = 0;
+	}
+	else {
+		cm_fft_tables(twiddle, bitrev, DESC_FFTSIZE);
+		for (i = 0; i < DESC_FRAMESIZE; i++) {
+			window[i] = 0.5 - 0.5 * cos(2.0 * M_PI * i / DESC_FRAMESIZE);
+		}
+	}
+	for (f = 0; f < count && !*cancel; f++) {
+		frame = &(*frames)[f];
+		frame->frame = f * DESC_HOP;
+		// channel mix, zero padded to the fft size
+		energy = 0.0;
+		for (i = 0; i < DESC_FRAMESIZE; i++) {
+			sum = 0.0;
+			for (c = 0; c < channelcount; c++) {
+				sum += samples[((f * DESC_HOP) + i) * channelcount + c];
+			}
+			sum /= channelcount;
+			energy += sum * sum;
+			buf[i * 2] = sum;
+			buf[(i * 2) + 1] = 0.0;
+		}
+		for (i = DESC_FRAMESIZE; i < DESC_FFTSIZE; i++) {
+			buf[i * 2] = 0.0;
+			buf[(i * 2) + 1] = 0.0;
+		}
+		frame->v[0] = 10.0 * log10(energy / DESC_FRAMESIZE + 1e-12);
+		if (frame->v[0] < -120.0) {
+			frame->v[0] = -120.0;
+		}
+		period = cm_period(buf, acf, twiddle, bitrev, lag_min, lag_max);
+		frame->v[3] = period > 0.0 ? log2(samplerate / period) : 0.0;
+		// spectrum of the windowed frame: centroid and flatness
+		for (i = 0; i < DESC_FRAMESIZE; i++) {
+			sum = 0.0;
+			for (c = 0; c < channelcount; c++) {
+				sum += samples[((f * DESC_HOP) + i) * channelcount + c];
+			}
+			buf[i * 2] = window[i] * sum / channelcount;
+			buf[(i * 2) + 1] = 0.0;
+		}
+		for (i = DESC_FRAMESIZE; i < DESC_FFTSIZE; i++) {
+			buf[i * 2] = 0.0;
+			buf[(i * 2) + 1] = 0.0;
+		}
+		cm_fft(buf, DESC_FFTSIZE, twiddle, bitrev, false);
+		mag_sum = 0.0;
+		weighted = 0.0;
+		log_sum = 0.0;
+		power = 0.0;
+		for (i = 1; i <= bins; i++) {
+			sum = buf[i * 2] * buf[i * 2] + buf[(i * 2) + 1] * buf[(i * 2) + 1] + 1e-20;
+			mag_sum += sqrt(sum);
+			weighted += sqrt(sum) * i * samplerate / DESC_FFTSIZE;
+			log_sum += log(sum);
+			power += sum;
+		}
+		frame->v[1] = log2(mag_sum > 1e-9 && weighted / mag_sum > 20.0 ? weighted / mag_sum : 20.0);
+		frame->v[2] = exp(log_sum / bins) / (power / bins);
+	}
+	sysmem_freeptr(buf);
+	sysmem_freeptr(window);
+	sysmem_freeptr(twiddle);
+	sysmem_freeptr(bitrev);
+	sysmem_freeptr(acf);
+	if (count == 0 || *cancel) {
+		sysmem_freeptr(*frames);
+		*frames = NULL;
+		count = 0;
+	}
+	return count;
+}
+// PITCH MARKS: one mark per period in voiced parts of the channel mix. the period is estimated per hop (see cm_period),
+// the first mark of a voiced part is the highest sample of its first period, each following mark the highest sample
+// between 0.8 and 1.2 periods after the previous one. returns the number of marks, written with their periods into
+// newly allocated memory
+long cm_pitchmarks(long **marks, long **periods, float *samples, long channelcount, long framecount, double samplerate, t_bool *cancel) {
+	long frames = framecount >= DESC_FRAMESIZE ? ((framecount - DESC_FRAMESIZE) / MARK_HOP) + 1 : 0;
+	long lag_min = (long)(samplerate / DESC_MAXPITCH);
+	long lag_max = (long)(samplerate / DESC_MINPITCH);
+	long count = 0;
+	long last = -1;
+	long pos = 0;
+	long f, i, c, lo, hi, mark, period;
+	double sum, peak;
+	double *frame_period = (double *)sysmem_newptrclear((frames + 1) * sizeof(double));
+	double *buf = (double *)sysmem_newptr(DESC_FFTSIZE * 2 * sizeof(double));
+	double *twiddle = (double *)sysmem_newptr(DESC_FFTSIZE * sizeof(double));
+	long *bitrev = (long *)sysmem_newptr(DESC_FFTSIZE * sizeof(long));
+	double *acf = (double *)sysmem_newptr((lag_max + 2) * sizeof(double));
+	long capacity;
+	
+	if (lag_min < 2) {
+		lag_min = 2;
+	}
+	if (lag_max + 1 >= DESC_FRAMESIZE) {
+		lag_max = DESC_FRAMESIZE - 2;
+	}
+	capacity = (framecount / ((lag_min * 4) / 5)) + 2; // marks are at least 0.8 of the shortest period apart
+	*marks = (long *)sysmem_newptr(capacity * sizeof(long));
+	*periods = (long *)sysmem_newptr(capacity * sizeof(long));
+	if (!frame_period || !buf || !twiddle || !bitrev || !acf || !*marks || !*periods) {
+		frames = 0;
+	}
+	else {
+		cm_fft_tables(twiddle, bitrev, DESC_FFTSIZE);
+	}
+	// period per hop
+	for (f = 0; f < frames && !*cancel; f++) {
+		for (i = 0; i < DESC_FRAMESIZE; i++) {
+			sum = 0.0;
+			for (c = 0; c < channelcount; c++) {
+				sum += samples[((f * MARK_HOP) + i) * channelcount + c];
+			}
+			buf[i * 2] = sum / channelcount;
+			buf[(i * 2) + 1] = 0.0;
+		}
+		for (i = DESC_FRAMESIZE; i < DESC_FFTSIZE; i++) {
+			buf[i * 2] = 0.0;
+			buf[(i * 2) + 1] = 0.0;
+		}
+		frame_period[f] = cm_period(buf, acf, twiddle, bitrev, lag_min, lag_max);
+	}
+	// marks at the peaks of the periods (the period of a position is the one of the frame centered nearest to it)
+	while (frames && pos < framecount && !*cancel) {
+		f = (pos - (DESC_FRAMESIZE / 2)) / MARK_HOP;
+		f = f < 0 ? 0 : (f >= frames ? frames - 1 : f);
+		period = (long)(frame_period[f] + 0.5);
+		if (period == 0) { // unvoiced
+			last = -1;
+			pos += MARK_HOP;
+			continue;
+		}
+		lo = last < 0 ? pos : last + ((period * 4) / 5);
+		hi = last < 0 ? pos + period : last + ((period * 6) / 5) + 1;
+		if (hi > framecount || count == capacity) {
+			break;
+		}
+		mark = lo;
+		peak = -1e300;
+		for (i = lo; i < hi; i++) {
+			sum = 0.0;
+			for (c = 0; c < channelcount; c++) {
+				sum += samples[i * channelcount + c];
+			}
+			if (sum > peak) {
+				peak = sum;
+				mark = i;
+			}
+		}
+		(*marks)[count] = mark;
+		(*periods)[count] = period;
+		count++;
+		last = mark;
+		pos = mark + period;
+	}
+	sysmem_freeptr(frame_period);
+	sysmem_freeptr(buf);
+	sysmem_freeptr(twiddle);
+	sysmem_freeptr(bitrev);
+	sysmem_freeptr(acf);
+	if (count == 0 || *cancel) {
+		sysmem_freeptr(*marks);
+		sysmem_freeptr(*periods);
+		*marks = NULL;
+		*periods = NULL;
+		count = 0;
+	}
+	return count;
+}
+// DESCRIPTOR TREE: normalizes the descriptors to their range in the buffer (unvoiced frames get DESC_UNVOICED as pitch)
+// and builds the k-d tree in place, the tree takes ownership of the frames
+cm_desctree *cm_desctree_new(cm_descframe *frames, long count) {
+	double max[DESC_DIMS];
+	long i, d;
+	cm_desctree *tree = (cm_desctree *)sysmem_newptrclear(sizeof(cm_desctree));
+	if (tree == NULL) {
+		sysmem_freeptr(frames);
+		return NULL;
+	}
+	tree->nodes = frames;
+	tree->count = count;
+	for (d = 0; d < DESC_DIMS; d++) {
+		tree->min[d] = 1e300;
+		max[d] = -1e300;
+	}
+	for (i = 0; i < count; i++) {
+		for (d = 0; d < DESC_DIMS; d++) {
+			if (d == 3 && frames[i].v[d] == 0.0) { // unvoiced
+				continue;
+			}
+			if (frames[i].v[d] < tree->min[d]) {
+				tree->min[d] = frames[i].v[d];
+			}
+			if (frames[i].v[d] > max[d]) {
+				max[d] = frames[i].v[d];
+			}
+		}
+	}
+	for (d = 0; d < DESC_DIMS; d++) {
+		if (max[d] < tree->min[d]) { // no voiced frame
+			tree->min[d] = 0.0;
+			max[d] = 1.0;
+		}
+		tree->range[d] = max[d] - tree->min[d] > 1e-9 ? max[d] - tree->min[d] : 1.0;
+	}
+	for (i = 0; i < count; i++) {
+		for (d = 0; d < DESC_DIMS; d++) {
+			if (d == 3 && frames[i].v[d] == 0.0) {
+				frames[i].v[d] = DESC_UNVOICED;
+			}
+			else {
+				frames[i].v[d] = (frames[i].v[d] - tree->min[d]) / tree->range[d];
+			}
+		}
+	}
+	cm_kdbuild(frames, 0, count, 0);
+	return tree;
+}
+void cm_desctree_free(cm_desctree *tree) {
+	if (tree == NULL) {
+		return;
+	}
+	sysmem_freeptr(tree->nodes);
+	sysmem_freeptr(tree);
+}
+// K-D TREE BUILD: moves the median of the range (on the axis of the depth) to the middle, smaller values before it
+void cm_kdbuild(cm_descframe *nodes, long low, long high, long depth) {
+	long axis = depth % DESC_DIMS;
+	long mid = (low + high) / 2;
+	long left = low;
+	long right = high - 1;
+	long i, store;
+	double pivot;
+	cm_descframe tmp;
+	if (high - low < 2) {
+		return;
+	}
+	// quickselect
+	while (left < right) {
+		pivot = nodes[(left + right) / 2].v[axis];
+		tmp = nodes[(left + right) / 2];
+		nodes[(left + right) / 2] = nodes[right];
+		nodes[right] = tmp;
+		store = left;
+		for (i = left; i < right; i++) {
+			if (nodes[i].v[axis] < pivot) {
+				tmp = nodes[i];
+				nodes[i] = nodes[store];
+				nodes[store] = tmp;
+				store++;
+			}
+		}
+		tmp = nodes[store];
+		nodes[store] = nodes[right];
+		nodes[right] = tmp;
+		if (store == mid) {
+			break;
+		}
+		else if (store < mid) {
+			left = store + 1;
+		}
+		else {
+			right = store - 1;
+		}
+	}
+	cm_kdbuild(nodes, low, mid, depth + 1);
+	cm_kdbuild(nodes, mid + 1, high, depth + 1);
+}
+// K-D TREE SEARCH: k nearest nodes within radius (squared weighted distance), sorted by distance
+void cm_kdsearch(cm_descframe *nodes, long low, long high, long depth, double *query, double *weight, double radius, long k, double *best_dist, long *best_frame, long *found) {
+	long axis = depth % DESC_DIMS;
+	long mid = (low + high) / 2;
+	long i;
+	double dist = 0.0;
+	double delta;
+	if (low >= high) {
+		return;
+	}
+	for (i = 0; i < DESC_DIMS; i++) {
+		delta = nodes[mid].v[i] - query[i];
+		dist += weight[i] * delta * delta;
+	}
+	if (dist <= radius && (*found < k || dist < best_dist[*found - 1])) {
+		// insertion into the sorted result list
+		i = *found < k ? (*found)++ : k - 1;
+		while (i > 0 && best_dist[i - 1] > dist) {
+			best_dist[i] = best_dist[i - 1];
+			best_frame[i] = best_frame[i - 1];
+			i--;
+		}
+		best_dist[i] = dist;
+		best_frame[i] = nodes[mid].frame;
+	}
+	delta = query[axis] - nodes[mid].v[axis];
+	if (delta < 0.0) {
+		cm_kdsearch(nodes, low, mid, depth + 1, query, weight, radius, k, best_dist, best_frame, found);
+	}
+	else {
+		cm_kdsearch(nodes, mid + 1, high, depth + 1, query, weight, radius, k, best_dist, best_frame, found);
+	}
+	// the other side can only hold nearer nodes if the splitting plane is nearer than the current limit
+	delta = weight[axis] * delta * delta;
+	if (delta <= radius && (*found < k || delta < best_dist[*found - 1])) {
+		if (query[axis] - nodes[mid].v[axis] < 0.0) {
+			cm_kdsearch(nodes, mid + 1, high, depth + 1, query, weight, radius, k, best_dist, best_frame, found);
+		}
+		else {
+			cm_kdsearch(nodes, low, mid, depth + 1, query, weight, radius, k, best_dist, best_frame, found);
+		}
+	}
+}
+// RESAMPLER: windowed sinc (kaiser) read from a table with RESAMPLE_PHASES entries per zero crossing and linear
+// interpolation between the entries. the cutoff is lowered to the new nyquist frequency when downsampling. returns
+// the number of frames (ratio = new sample rate / old sample rate), written into newly allocated memory
+long cm_resample(float **dest, float *samples, long channelcount, long framecount, double ratio, t_bool *cancel) {
+	long count = (long)(framecount * ratio);
+	long table_size = RESAMPLE_ZEROS * RESAMPLE_PHASES + 2;
+	double cutoff = ratio < 1.0 ? ratio : 1.0;
+	long width = (long)ceil(RESAMPLE_ZEROS / cutoff);
+	double *table = (double *)sysmem_newptr(table_size * sizeof(double));
+	double *sum = (double *)sysmem_newptr(channelcount * sizeof(double));
+	double t, w, pos, phase, i0_beta, term, arg;
+	long n, j, c, k, center;
+	
+	*dest = (float *)sysmem_newptr(((t_int64)count * channelcount + 1) * sizeof(float));
+	if (!table || !sum || !*dest || count == 0) {
+		sysmem_freeptr(table);
+		sysmem_freeptr(sum);
+		sysmem_freeptr(*dest);
+		*dest = NULL;
+		return 0;
+	}
+	// kernel table: sinc(t) * kaiser window, the zeroth order bessel function is computed from its series
+	i0_beta = 0.0;
+	term = 1.0;
+	for (k = 1; term > 1e-12 * i0_beta || k < 3; k++) {
+		i0_beta += term;
+		term *= (RESAMPLE_BETA * RESAMPLE_BETA * 0.25) / (double)(k * k);
+	}
+	for (j = 0; j < table_size; j++) {
+		t = (double)j / RESAMPLE_PHASES;
+		if (t >= RESAMPLE_ZEROS) {
+			table[j] = 0.0;
+			continue;
+		}
+		arg = RESAMPLE_BETA * sqrt(1.0 - (t / RESAMPLE_ZEROS) * (t / RESAMPLE_ZEROS));
+		w = 0.0;
+		term = 1.0;
+		for (k = 1; term > 1e-12 * w || k < 3; k++) {
+			w += term;
+			term *= (arg * arg * 0.25) / (double)(k * k);
+		}
+		table[j] = (t == 0.0 ? 1.0 : sin(M_PI * t) / (M_PI * t)) * (w / i0_beta);
+	}
+	for (n = 0; n < count; n++) {
+		if ((n & 0xFFF) == 0 && *cancel) {
+			break;
+		}
+		pos = n / ratio;
+		center = (long)pos;
+		for (c = 0; c < channelcount; c++) {
+			sum[c] = 0.0;
+		}
+		for (j = center - width + 1; j <= center + width; j++) {
+			if (j < 0 || j >= framecount) {
+				continue;
+			}
+			phase = fabs(j - pos) * cutoff * RESAMPLE_PHASES;
+			k = (long)phase;
+			if (k >= table_size - 1) {
+				continue;
+			}
+			w = table[k] + (phase - k) * (table[k + 1] - table[k]);
+			for (c = 0; c < channelcount; c++) {
+				sum[c] += samples[j * channelcount + c] * w;
+			}
+		}
+		for (c = 0; c < channelcount; c++) {
+			(*dest)[n * channelcount + c] = (float)(sum[c] * cutoff);
+		}
+	}
+	sysmem_freeptr(table);
+	sysmem_freeptr(sum);
+	if (*cancel) {
+		sysmem_freeptr(*dest);
+		*dest = NULL;
+		return 0;
+	}
+	return count;
+}
+void cm_resampled_free(cm_resampled *resampled) {
+	if (resampled == NULL) {
+		return;
+	}
+	sysmem_freeptr(resampled->samples);
+	sysmem_freeptr(resampled);
+}
+// WINDOW TABLE: the first channel of the window buffer~ resampled to the next power of 2 size (linear interpolation, or
+// the frame at each table position without interpolation)
+cm_wintable *cm_wintable_new(float *samples, long channelcount, long framecount, t_bool interp) {
+	cm_wintable *wintable;
+	long i, index;
+	double pos, frac;
+	int bits = 0;
+	if (samples == NULL || channelcount < 1 || framecount < 1) {
+		return NULL;
+	}
+	wintable = (cm_wintable *)sysmem_newptrclear(sizeof(cm_wintable));
+	if (wintable == NULL) {
+		return NULL;
+	}
+	wintable->size = WINTABLE_MIN;
+	while (wintable->size < framecount && wintable->size < WINTABLE_MAX) {
+		wintable->size <<= 1;
+	}
+	while ((1L << bits) < wintable->size) {
+		bits++;
+	}
+	wintable->mask = wintable->size - 1;
+	wintable->shift = 64 - bits;
+	wintable->fracmask = ((t_uint64)1 << wintable->shift) - 1;
+	wintable->fracscale = 1.0 / (double)((t_uint64)1 << wintable->shift);
+	wintable->window = (double *)sysmem_newptr((wintable->size + 1) * sizeof(double));
+	if (wintable->window == NULL) {
+		sysmem_freeptr(wintable);
+		return NULL;
+	}
+	// table entry i is the window at the grain position i / size (same mapping as the window buffer~ read)
+	for (i = 0; i <= wintable->size; i++) {
+		pos = ((double)i / (double)wintable->size) * (double)framecount;
+		index = (long)pos;
+		if (index >= framecount - 1) {
+			wintable->window[i] = samples[(framecount - 1) * channelcount];
+		}
+		else if (!interp) {
+			wintable->window[i] = samples[index * channelcount];
+		}
+		else {
+			frac = pos - index;
+			wintable->window[i] = samples[index * channelcount] + frac * (samples[(index + 1) * channelcount] - samples[index * channelcount]);
+		}
+	}
+	return wintable;
+}
+void cm_wintable_free(cm_wintable *wintable) {
+	if (wintable == NULL) {
+		return;
+	}
+	sysmem_freeptr(wintable->window);
+	sysmem_freeptr(wintable);
+}
+// CONTENT HASH: 64 bit fnv-1a over the sample words and the buffer format
+t_uint64 cm_hash(float *samples, long channelcount, long framecount, double samplerate, t_bool *cancel) {
+	t_uint64 hash = 14695981039346656037ULL;
+	t_uint32 *words = (t_uint32 *)samples;
+	t_int64 count = (t_int64)channelcount * framecount;
+	t_int64 i;
+	hash = (hash ^ (t_uint64)channelcount) * 1099511628211ULL;
+	hash = (hash ^ (t_uint64)framecount) * 1099511628211ULL;
+	hash = (hash ^ (t_uint64)samplerate) * 1099511628211ULL;
+	for (i = 0; i < count; i++) {
+		hash = (hash ^ words[i]) * 1099511628211ULL;
+		if ((i & 0xFFFFF) == 0 && *cancel) {
+			break;
+		}
+	}
+	return hash;
+}
+// ANALYSIS CACHE: reads the blocks of the cache file of the hash and kind into newly allocated memory. returns the
+// number of blocks, 0 if there is no valid file (missing, other version, parameter or block count)
+long cm_cacheread(const char *dir, t_uint64 hash, long kind, double param, long maxcount, void **blocks, t_int64 *bytes) {
+	char filename[MAX_PATH_CHARS];
+	cm_cacheheader header;
+	FILE *file;
+	long i;
+	long count = 0;
+	snprintf_zero(filename, MAX_PATH_CHARS, "%s/%016llx.%ld.cmcache", dir, (unsigned long long)hash, kind);
+	file = fopen(filename, "rb");
+	if (file == NULL) {
+		return 0;
+	}
+	if (fread(&header, sizeof(header), 1, file) == 1 && !strncmp(header.magic, "cmcache", 8) && header.version == CACHE_VERSION && header.kind == (t_uint32)kind && header.hash == hash && header.param == param && header.longsize == sizeof(long) && header.count == (t_uint32)maxcount && fread(bytes, sizeof(t_int64), maxcount, file) == (size_t)maxcount) {
+		for (count = 0; count < maxcount; count++) {
+			blocks[count] = sysmem_newptr(bytes[count] + 1); // empty blocks are valid
+			if (blocks[count] == NULL || (bytes[count] && fread(blocks[count], (size_t)bytes[count], 1, file) != 1)) {
+				sysmem_freeptr(blocks[count]);
+				break;
+			}
+		}
+		if (count < maxcount) { // truncated file
+			for (i = 0; i < count; i++) {
+				sysmem_freeptr(blocks[i]);
+			}
+			count = 0;
+		}
+	}
+	fclose(file);
+	return count;
+}
+// ANALYSIS CACHE: writes the blocks to a temporary file which replaces the cache file of the hash and kind when it is
+// complete, so other instances never read a partial file
+void cm_cachewrite(const char *dir, t_uint64 hash, long kind, double param, long count, void **blocks, t_int64 *bytes) {
+	char filename[MAX_PATH_CHARS];
+	char tempname[MAX_PATH_CHARS];
+	cm_cacheheader header;
+	FILE *file;
+	t_bool ok;
+	long i;
+	snprintf_zero(filename, MAX_PATH_CHARS, "%s/%016llx.%ld.cmcache", dir, (unsigned long long)hash, kind);
+	snprintf_zero(tempname, MAX_PATH_CHARS, "%s.%p.tmp", filename, (void *)blocks); // the stack address is unique per thread
+	file = fopen(tempname, "wb");
+	if (file == NULL) {
+		return;
+	}
+	memset(&header, 0, sizeof(header));
+	strncpy(header.magic, "cmcache", 8);
+	header.version = CACHE_VERSION;
+	header.kind = (t_uint32)kind;
+	header.hash = hash;
+	header.param = param;
+	header.longsize = sizeof(long);
+	header.count = (t_uint32)count;
+	ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(bytes, sizeof(t_int64), count, file) == (size_t)count;
+	for (i = 0; i < count && ok; i++) {
+		ok = !bytes[i] || fwrite(blocks[i], (size_t)bytes[i], 1, file) == 1;
+	}
+	ok = (fclose(file) == 0) && ok;
+	remove(filename); // rename does not replace an existing file on windows
+	if (!ok || rename(tempname, filename) != 0) {
+		remove(tempname);
+	}
+}
+// BINARY SEARCH: position of the first index value that is not smaller than value (count if there is none)
+long cm_lowerbound(long *index, long count, double value) {
+	long low = 0;
+	long high = count;
+	long mid;
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (index[mid] < value) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	return low;
+}
+// BINARY SEARCH: index value nearest to value (count must be larger than 0)
+long cm_nearest(long *index, long count, double value) {
+	long pos = cm_lowerbound(index, count, value);
+	if (pos == count) {
+		return index[count - 1];
+	}
+	if (pos > 0 && value - index[pos - 1] < index[pos] - value) {
+		return index[pos - 1];
+	}
+	return index[pos];
+}
+// SCAN ALIGNMENT JOB: the fft buffers are only used by the alignment thread
+cm_wsola *cm_wsola_new(void) {
+	cm_wsola *wsola = (cm_wsola *)sysmem_newptrclear(sizeof(cm_wsola));
+	if (wsola == NULL) {
+		return NULL;
+	}
+	wsola->ref = (double *)sysmem_newptrclear(WSOLA_MAXLEN * sizeof(double));
+	wsola->search = (double *)sysmem_newptrclear((WSOLA_MAXLEN + 2 * WSOLA_MAXSEEK) * sizeof(double));
+	wsola->spec_ref = (double *)sysmem_newptrclear(WSOLA_FFTSIZE * 2 * sizeof(double));
+	wsola->spec_search = (double *)sysmem_newptrclear(WSOLA_FFTSIZE * 2 * sizeof(double));
+	wsola->twiddle = (double *)sysmem_newptrclear(WSOLA_FFTSIZE * sizeof(double));
+	wsola->bitrev = (long *)sysmem_newptrclear(WSOLA_FFTSIZE * sizeof(long));
+	if (!wsola->ref || !wsola->search || !wsola->spec_ref || !wsola->spec_search || !wsola->twiddle || !wsola->bitrev) {
+		cm_wsola_free(wsola);
+		return NULL;
+	}
+	wsola->state = WSOLA_IDLE;
+	return wsola;
+}
+void cm_wsola_free(cm_wsola *wsola) {
+	if (wsola) {
+		sysmem_freeptr(wsola->ref);
+		sysmem_freeptr(wsola->search);
+		sysmem_freeptr(wsola->spec_ref);
+		sysmem_freeptr(wsola->spec_search);
+		sysmem_freeptr(wsola->twiddle);
+		sysmem_freeptr(wsola->bitrev);
+		sysmem_freeptr(wsola);
+	}
+}
+// SCAN ALIGNMENT: lag (0 to 2 * range) of the search frames most similar to the reference frames. the cross correlation
+// of all lags is computed with one fft size of at least length + 2 * range (no circular wrap for these lags) and is
+// normalized by the energy of the search frames under the reference. the center lag is kept without a positive match
+long cm_wsola_align(cm_wsola *wsola) {
+	long i, lag;
+	long n = 2;
+	long length = wsola->length;
+	long lags = 2 * wsola->range;
+	long span = length + lags;
+	double *r = wsola->spec_ref;
+	double *s = wsola->spec_search;
+	double re, im, score;
+	double energy = 0.0;
+	double best_score = 0.0;
+	long best_lag = wsola->range;
+	while (n < span) {
+		n *= 2;
+	}
+	if (n != wsola->fftsize) {
+		cm_fft_tables(wsola->twiddle, wsola->bitrev, n);
+		wsola->fftsize = n;
+	}
+	for (i = 0; i < n; i++) {
+		r[i * 2] = i < length ? wsola->ref[i] : 0.0;
+		r[(i * 2) + 1] = 0.0;
+		s[i * 2] = i < span ? wsola->search[i] : 0.0;
+		s[(i * 2) + 1] = 0.0;
+	}
+	cm_fft(r, n, wsola->twiddle, wsola->bitrev, false);
+	cm_fft(s, n, wsola->twiddle, wsola->bitrev, false);
+	for (i = 0; i < n; i++) { // search spectrum times the conjugate reference spectrum
+		re = s[i * 2] * r[i * 2] + s[(i * 2) + 1] * r[(i * 2) + 1];
+		im = s[(i * 2) + 1] * r[i * 2] - s[i * 2] * r[(i * 2) + 1];
+		s[i * 2] = re;
+		s[(i * 2) + 1] = im;
+	}
+	cm_fft(s, n, wsola->twiddle, wsola->bitrev, true);
+	for (i = 0; i < length; i++) {
+		energy += wsola->search[i] * wsola->search[i];
+	}
+	for (lag = 0; lag <= lags; lag++) {
+		if (energy > 1e-12) {
+			score = s[lag * 2] / sqrt(energy);
+			if (score > best_score) {
+				best_score = score;
+				best_lag = lag;
+			}
+		}
+		if (lag < lags) { // slide the energy window by one frame
+			energy += wsola->search[lag + length] * wsola->search[lag + length] - wsola->search[lag] * wsola->search[lag];
+		}
+	}
+	return best_lag;
+}
+// COMPRESSED STORE: planar channels, the quantization error is bounded by
+// int16: 2^-16 of full scale (half a step, about -96 dBFS), samples beyond +-1.0 are clipped
+// bfp16: 2^-15 of the block exponent range (the block peak fits the mantissa, about -90 dB below the block peak)
+// bfp8:  2^-7 of the block exponent range (about -42 dB below the loudest sample of the STORE_BLOCK frames)
+cm_store *cm_store_new(long framecount, long channelcount, double samplerate, short format) {
+	long blocks = (framecount + STORE_BLOCK - 1) / STORE_BLOCK;
+	t_bool failed = false;
+	cm_store *store = (cm_store *)sysmem_newptrclear(sizeof(cm_store));
+	if (store == NULL) {
+		return NULL;
+	}
+	store->framecount = framecount;
+	store->channelcount = channelcount;
+	store->samplerate = samplerate;
+	store->format = format;
+	store->m16 = (short **)sysmem_newptrclear(channelcount * sizeof(short *));
+	store->m8 = (signed char **)sysmem_newptrclear(channelcount * sizeof(signed char *));
+	store->exponent = (signed char **)sysmem_newptrclear(channelcount * sizeof(signed char *));
+	if (!store->m16 || !store->m8 || !store->exponent) {
+		cm_store_free(store);
+		return NULL;
+	}
+	for (long c = 0; c < channelcount && !failed; c++) {
+		if (format == STORE_BFP8) {
+			store->m8[c] = (signed char *)sysmem_newptrclear(blocks * STORE_BLOCK * sizeof(signed char));
+			failed = (store->m8[c] == NULL);
+		}
+		else {
+			store->m16[c] = (short *)sysmem_newptrclear(blocks * STORE_BLOCK * sizeof(short));
+			failed = (store->m16[c] == NULL);
+		}
+		if (format != STORE_INT16 && !failed) {
+			store->exponent[c] = (signed char *)sysmem_newptrclear(blocks * sizeof(signed char));
+			failed = (store->exponent[c] == NULL);
+		}
+	}
+	if (failed) {
+		cm_store_free(store);
+		return NULL;
+	}
+	return store;
+}
+void cm_store_free(cm_store *store) {
+	if (store == NULL) {
+		return;
+	}
+	for (long c = 0; c < store->channelcount; c++) {
+		if (store->m16) {
+			sysmem_freeptr(store->m16[c]);
+		}
+		if (store->m8) {
+			sysmem_freeptr(store->m8[c]);
+		}
+		if (store->exponent) {
+			sysmem_freeptr(store->exponent[c]);
+		}
+	}
+	sysmem_freeptr(store->m16);
+	sysmem_freeptr(store->m8);
+	sysmem_freeptr(store->exponent);
+	sysmem_freeptr(store);
+}
+// STORE ENCODER: writes interleaved float frames into the store, start must be a multiple of STORE_BLOCK
+void cm_store_encode(cm_store *store, float *samples, long channelcount, long start, long frames) {
+	long block, i, n, frame;
+	long bits = (store->format == STORE_BFP8) ? 8 : 16;
+	double peak, value, scale, limit;
+	int exponent;
+	limit = (double)((1 << (bits - 1)) - 1);
+	for (long c = 0; c < store->channelcount; c++) {
+		for (block = start / STORE_BLOCK; block * STORE_BLOCK < start + frames; block++) {
+			n = STORE_BLOCK;
+			if ((block * STORE_BLOCK) + n > start + frames) {
+				n = start + frames - (block * STORE_BLOCK);
+			}
+			exponent = 0; // int16: fixed exponent (full scale)
+			if (store->format != STORE_INT16) {
+				peak = 0.0;
+				for (i = 0; i < n; i++) {
+					value = fabs(samples[((block * STORE_BLOCK - start) + i) * channelcount + c]);
+					if (value > peak) {
+						peak = value;
+					}
+				}
+				frexp(peak, &exponent); // peak < 2^exponent
+				if (exponent < -100) {
+					exponent = -100;
+				}
+				else if (exponent > 100) {
+					exponent = 100;
+				}
+				store->exponent[c][block] = (signed char)exponent;
+			}
+			scale = ldexp(1.0, (int)(bits - 1) - exponent);
+			for (i = 0; i < n; i++) {
+				frame = (block * STORE_BLOCK) + i;
+				value = floor(samples[(frame - start) * channelcount + c] * scale + 0.5);
+				if (value > limit) {
+					value = limit;
+				}
+				else if (value < -limit - 1.0) {
+					value = -limit - 1.0;
+				}
+				if (bits == 8) {
+					store->m8[c][frame] = (signed char)value;
+				}
+				else {
+					store->m16[c][frame] = (short)value;
+				}
+			}
+		}
+	}
+}
+// PLANAR READ FROM THE STORE: decodes block by block, the inner loops are plain multiply loops over contiguous
+// memory that the compiler vectorizes
+void cm_storeread(double *dest, cm_store *store, long channel, long start, long frames) {
+	long i = 0;
+	long n, block, offset;
+	long avail = store->framecount - start;
+	double scale;
+	short *m16 = store->m16[channel];
+	signed char *m8 = store->m8[channel];
+	if (avail > frames) {
+		avail = frames;
+	}
+	while (i < avail) {
+		block = (start + i) / STORE_BLOCK;
+		offset = start + i;
+		n = ((block + 1) * STORE_BLOCK) - offset;
+		if (n > avail - i) {
+			n = avail - i;
+		}
+		if (store->format == STORE_INT16) {
+			scale = 1.0 / 32768.0;
+		}
+		else {
+			scale = ldexp(1.0, store->exponent[channel][block] - (store->format == STORE_BFP8 ? 7 : 15));
+		}
+		if (store->format == STORE_BFP8) {
+			for (long j = 0; j < n; j++) {
+				dest[i + j] = m8[offset + j] * scale;
+			}
+		}
+		else {
+			for (long j = 0; j < n; j++) {
+				dest[i + j] = m16[offset + j] * scale;
+			}
+		}
+		i += n;
+	}
+	for (; i < frames; i++) {
+		dest[i] = 0.0;
+	}
+}
+// LINEAR INTERPOLATION FROM THE STORE
+double cm_storeinterp(cm_store *store, double distance, long channel) {
+	double frame[2];
+	long index = (long)distance;
+	if (index >= store->framecount) {
+		return 0.0;
+	}
+	cm_storeread(frame, store, channel, index, 2);
+	return frame[0] + (distance - index) * (frame[1] - frame[0]);
+}
+// STATE VARIABLE FILTER: trapezoidal integrated svf, filters the samples in place (type 1 = lowpass, 2 = highpass, 3 = bandpass, 4 = notch)
+void cm_svf(double *samples, long length, double cutoff, double q, double samplerate, long type) {
+	double g = tan(M_PI * cutoff / samplerate);
+	double k = 1.0 / q;
+	double a1 = 1.0 / (1.0 + g * (g + k));
+	double a2 = g * a1;
+	double a3 = g * a2;
+	double ic1eq = 0.0;
+	double ic2eq = 0.0;
+	double v0, v1, v2, v3;
+	// the coefficients of the four outputs (input, band, low) are selected once, the sample loop is branch free
+	double m0 = (type == 2 || type == 4) ? 1.0 : 0.0;
+	double m1 = (type == 2 || type == 4) ? -k : (type == 3 ? k : 0.0);
+	double m2 = (type == 1) ? 1.0 : (type == 2 ? -1.0 : 0.0);
+	for (long i = 0; i < length; i++) {
+		v0 = samples[i];
+		v3 = v0 - ic2eq;
+		v1 = a1 * ic1eq + a2 * v3;
+		v2 = ic2eq + a2 * ic1eq + a3 * v3;
+		ic1eq = 2.0 * v1 - ic1eq;
+		ic2eq = 2.0 * v2 - ic2eq;
+		samples[i] = m0 * v0 + m1 * v1 + m2 * v2;
+	}
+}
+// FFT: iterative radix-2 complex fft, interleaved real/imaginary data, unnormalized
+void cm_fft_tables(double *twiddle, long *bitrev, long n) {
+	long i, b;
+	long bits = 0;
+	while ((1 << bits) < n) {
+		bits++;
+	}
+	for (i = 0; i < n; i++) {
+		bitrev[i] = 0;
+		for (b = 0; b < bits; b++) {
+			if (i & (1 << b)) {
+				bitrev[i] |= 1 << (bits - 1 - b);
+			}
+		}
+	}
+	for (i = 0; i < n / 2; i++) {
+		twiddle[i * 2] = cos(2.0 * M_PI * i / n);
+		twiddle[(i * 2) + 1] = -sin(2.0 * M_PI * i / n);
+	}
+}
+void cm_fft(double *data, long n, double *twiddle, long *bitrev, t_bool inverse) {
+	long i, j, k, size, half, step, a, b;
+	double tmp, wr, wi, tr, ti;
+	for (i = 0; i < n; i++) {
+		j = bitrev[i];
+		if (j > i) {
+			tmp = data[i * 2];
+			data[i * 2] = data[j * 2];
+			data[j * 2] = tmp;
+			tmp = data[(i * 2) + 1];
+			data[(i * 2) + 1] = data[(j * 2) + 1];
+			data[(j * 2) + 1] = tmp;
+		}
+	}
+	for (size = 2; size <= n; size *= 2) {
+		half = size / 2;
+		step = n / size;
+		for (i = 0; i < n; i += size) {
+			for (k = 0; k < half; k++) {
+				wr = twiddle[k * step * 2];
+				wi = inverse ? -twiddle[(k * step * 2) + 1] : twiddle[(k * step * 2) + 1];
+				a = i + k;
+				b = a + half;
+				tr = wr * data[b * 2] - wi * data[(b * 2) + 1];
+				ti = wr * data[(b * 2) + 1] + wi * data[b * 2];
+				data[b * 2] = data[a * 2] - tr;
+				data[(b * 2) + 1] = data[(a * 2) + 1] - ti;
+				data[a * 2] += tr;
+				data[(a * 2) + 1] += ti;
+			}
+		}
+	}
+}
+// PLANAR READ FUNCTION: copies one channel of a frame range into contiguous memory, frames past the end repeat the last frame
+void cm_deinterleave(double *dest, float *b_sample, t_atom_long b_channelcount, t_atom_long b_framecount, long channel, long start, long frames) {
+	long i;
+	long avail = b_framecount - start;
+	float *src = b_sample + (start * b_channelcount) + channel;
+	if (avail > frames) {
+		avail = frames;
+	}
+	for (i = 0; i < avail; i++) {
+		dest[i] = src[i * b_channelcount];
+	}
+	for (; i < frames; i++) {
+		dest[i] = (avail > 0) ? dest[avail - 1] : 0.0;
+	}
+}
+// PITCHED READ FUNCTION: writes length samples read from the planar source at pitch_length / length frames per sample.
+// unity and integer ratios are straight or strided copies, 1/2 alternates copied and averaged samples (interpolation
+// at half way), all other ratios use the general (interpolating or truncating) path
+void cm_pitchread(double *dest, double *src, long length, long pitch_length, t_bool interp) {
+	long readpos, index, stride;
+	double distance;
+	if (pitch_length == length) {
+		memcpy(dest, src, length * sizeof(double));
+	}
+	else if (pitch_length % length == 0) {
+		stride = pitch_length / length;
+		for (readpos = 0; readpos < length; readpos++) {
+			dest[readpos] = src[readpos * stride];
+		}
+	}
+	else if (length == pitch_length * 2) {
+		for (readpos = 0; readpos < length; readpos += 2) {
+			index = readpos >> 1;
+			dest[readpos] = src[index];
+			dest[readpos + 1] = interp ? 0.5 * (src[index] + src[index + 1]) : src[index];
+		}
+	}
+	else {
+		for (readpos = 0; readpos < length; readpos++) {
+			distance = ((double)readpos / (double)length) * (double)pitch_length;
+			index = (long)distance;
+			if (interp) {
+				distance -= index;
+				dest[readpos] = src[index] + distance * (src[index + 1] - src[index]);
+			}
+			else {
+				dest[readpos] = src[index];
+			}
+		}
+	}
+}
@@ -43,6 +43,7 @@
 #define FLOAT_INLETS 12 // number of object float inlets
 #define PITCHLIST 10 // max values to be provided for pitch list
 #define RANDMAX 10000
+#define GAUSS_ANCHOR 4096 // window samples between exact evaluations of the gauss window recurrence (power of 2)
 
 
 /************************************************************************************************************************/
@@ -115,6 +116,18 @@ typedef struct cmpanner {
 	double right;
 } cm_panstruct;
 
+/************************************************************************************************************************/
+/* GAUSS WINDOW RECURRENCE STRUCTURE                                                                                    */
+/************************************************************************************************************************/
+typedef struct cmgauss {
+	double g; // current window value
+	double r; // ratio of the next to the current window value
+	double c; // constant ratio of two consecutive ratios
+	double a; // exponent coefficient 1 / (2 * stdev^2)
+	double center; // window center
+	long pos; // window position of the current value
+} cm_gaussstruct;
+
 
 /************************************************************************************************************************/
 /* STATIC DECLARATIONS                                                                                                  */
@@ -156,8 +169,9 @@ double cm_random(double *min, double *max);
 t_bool cm_randomreverse();
 // LINEAR INTERPOLATION FUNCTION
 double cm_lininterp(double distance, float *b_sample, t_atom_long b_channelcount, t_atom_long b_framecount, short channel);
-// GAUSS WINDOW FUNCTION
-double cm_gauss(long *pos, long *length, double *alpha);
+// GAUSS WINDOW FUNCTIONS
+void cm_gaussinit(cm_gaussstruct *gauss, long *length, double *alpha);
+double cm_gaussnext(cm_gaussstruct *gauss);
 
 
 /************************************************************************************************************************/
@@ -437,6 +451,7 @@ void cmgausscloud_perform64(t_cmgausscloud *x, t_object *dsp64, double **ins, lo
 	double outsample_right = 0.0; // temporary right output sample used for adding up all grain samples
 	int slot = 0; // variable for the current slot in the arrays to write grain info to
 	cm_panstruct panstruct; // struct for holding the calculated constant power left and right stereo values
+	cm_gaussstruct gauss; // struct for holding the gauss window recurrence of the current grain
 	// grain generation variables
 	long readpos;
 	long start;
@@ -746,9 +761,10 @@ void cmgausscloud_perform64(t_cmgausscloud *x, t_object *dsp64, double **ins, lo
 				}
 			}
 			
+			cm_gaussinit(&gauss, &smp_length, &alpha);
 			for (readpos = 0; readpos < smp_length; readpos++) { // if the current slot contains grain playback information
-				// GET WINDOW SAMPLE FROM WINDOW BUFFER
-				w_read = cm_gauss(&readpos, &smp_length, &alpha);
+				// GET WINDOW SAMPLE FROM THE GAUSS WINDOW RECURRENCE
+				w_read = cm_gaussnext(&gauss);
 				
 				// GET GRAIN SAMPLE FROM SAMPLE BUFFER
 				distance = start + (((double)readpos / (double)smp_length) * (double)pitch_length);
@@ -1369,11 +1385,29 @@ double cm_lininterp(double distance, float *buffer, t_atom_long b_channelcount,
 	distance -= (long)distance; // calculate fraction value for interpolation
 	return buffer[index * b_channelcount + channel] + distance * (buffer[next * b_channelcount + channel] - buffer[index * b_channelcount + channel]);
 }
-// GAUSS WINDOW FUNCTION
-double cm_gauss(long *pos, long *length, double *alpha) {
-	double n;
+// GAUSS WINDOW FUNCTIONS
+// exp(-a * n^2) is written by the exact recurrence g[n+1] = g[n] * r[n], r[n+1] = r[n] * c with c = exp(-2a), so the
+// window costs two multiplications per sample. g and r are evaluated exactly every GAUSS_ANCHOR samples to bound the drift
+void cm_gaussinit(cm_gaussstruct *gauss, long *length, double *alpha) {
 	double N = *length - 1;
 	double stdev = N / (2 * (*alpha));
-	n = *pos - N / 2;
-	return exp(-0.5 * pow((n / stdev), 2));
+	gauss->a = (N > 0) ? 0.5 / (stdev * stdev) : 0.0;
+	gauss->c = exp(-2.0 * gauss->a);
+	gauss->center = N / 2;
+	gauss->pos = 0;
+}
+
+double cm_gaussnext(cm_gaussstruct *gauss) {
+	double n;
+	double value;
+	if ((gauss->pos & (GAUSS_ANCHOR - 1)) == 0) {
+		n = gauss->pos - gauss->center;
+		gauss->g = exp(-gauss->a * n * n);
+		gauss->r = exp(-gauss->a * (2.0 * n + 1.0));
+	}
+	value = gauss->g;
+	gauss->g *= gauss->r;
+	gauss->r *= gauss->c;
+	gauss->pos++;
+	return value;
 }
@@ -27,6 +27,7 @@
 #include "buffer.h"
 #include "ext_atomic.h"
 #include "ext_obex.h"
+#include "ext_systhread.h"
 #include <stdlib.h> // for arc4random_uniform
 #include <math.h> // for stereo functions
 #define MIN_CLOUDSIZE 1 // min cloud size in ms
@@ -41,7 +42,19 @@
 #define DEFAULT_WINTYPE 0 // defualt window type
 #define DEFAULT_WINLENGTH 512 // default window length
 #define MIN_WINDOWLENGTH 16 // min window length in samples
-#define MAX_WININDEX 7 // max object attribute value for window type
+#define MAX_WININDEX 18 // max object attribute value for window type
+#define WIN_KAISER 14 // parametric window types
+#define WIN_TUKEY 15
+#define WIN_CHEBYSHEV 16
+#define WIN_TAYLOR 17
+#define WIN_GAUSS 18
+#define TAYLOR_NBAR 4 // number of nearly constant level sidelobes of the taylor window
+#define CHEBY_MAXLENGTH 4096 // max length the chebyshev window is computed at (longer windows are resampled from it)
+#define WINLIST 16 // max window types to be provided for window list
+#define SKEW_STEPS 17 // number of tables of a window skew family (shape x skew)
+#define SKEW_CENTER 8 // skew step of the symmetric window
+#define MIN_SKEW 0.02 // min window skew (attack ratio)
+#define MAX_SKEW 0.98 // max window skew (attack ratio)
 #define FLOAT_INLETS 10 // number of object float inlets
 #define PITCHLIST 10 // max values to be provided for pitch list
 #define RANDMAX 10000
@@ -64,6 +77,20 @@ typedef struct cmcloud {
 } cm_cloud;
 
 
+/************************************************************************************************************************/
+/* SHARED WINDOW TABLE (process-wide, reference counted, read-only once written)                                        */
+/************************************************************************************************************************/
+typedef struct cmwindowtable {
+	double *window; // window array
+	long type; // window type
+	double param; // window parameter (0 for windows without parameter)
+	long skew; // window skew step
+	long length; // window length
+	long refcount; // number of instances using the table
+	struct cmwindowtable *next;
+} cm_windowtable;
+
+
 /************************************************************************************************************************/
 /* OBJECT STRUCTURE                                                                                                     */
 /************************************************************************************************************************/
@@ -75,15 +102,28 @@ typedef struct _cmindexcloud {
 	t_atom_long b_channelcount; // number of channels in the sample buffer
 	double b_m_sr; // buffer sample rate
 	double sr_ratio; // ratio between buffer sample rate and system sample rate
-	double *window; // window array
-	long window_type; // window typedef
-	long window_type_new;
+	double *bank[MAX_WININDEX + 1][SKEW_STEPS]; // window bank: one shared table per window type and skew step of the skew range (read-only)
+	double winparam[MAX_WININDEX + 1]; // window parameter per window type (0 for windows without parameter)
+	double attr_kaiserbeta; // attribute: kaiser window beta
+	double attr_tukeyratio; // attribute: tukey window taper ratio
+	double attr_chebyatten; // attribute: chebyshev window sidelobe attenuation in dB
+	double attr_taylorsll; // attribute: taylor window sidelobe level in dB
+	double attr_gaussalpha; // attribute: gauss window alpha
+	long window_type; // window type (fixed window mode)
 	long window_length; // window length
-	long window_length_new;
-	t_bool wintype_request;
-	t_bool wintype_verify;
-	t_bool winlength_request;
-	t_bool winlength_verify;
+	t_systhread_mutex bank_mutex; // guards the window bank while it is replaced
+	double skew_min; // min window skew (attack ratio)
+	double skew_max; // max window skew (attack ratio)
+	long skew_lo; // lowest skew step in the window bank
+	long skew_hi; // highest skew step in the window bank
+	t_symbol *attr_winmode; // attribute: per-grain window selection mode
+	long winlist[WINLIST]; // array to store window types provided by method
+	double winlist_zero; // zero value pointer for randomize function
+	double winlist_size; // current number of values stored in the window list array
+	double winweights[MAX_WININDEX + 1]; // cumulative window type weights provided by method
+	long winweights_count; // current number of window type weights
+	double winindex; // window type from the window index inlet (float)
+	short winindex_connected; // signal connected to the window index inlet
 	double m_sr; // system millisampling rate (samples per milliseconds = sr * 0.001)
 	short connect_status[FLOAT_INLETS]; // array for signal inlet connection statuses
 	double *object_inlets; // array to store the incoming values coming from the object inlets
@@ -137,6 +177,8 @@ typedef struct cmpanner {
 /************************************************************************************************************************/
 static t_class *cmindexcloud_class; // class pointer
 static t_symbol *ps_buffer_modified, *ps_stereo;
+static cm_windowtable *cm_windowtables = NULL; // window tables shared by all instances
+static t_systhread_mutex cm_windowtables_mutex = NULL;
 
 
 /************************************************************************************************************************/
@@ -160,17 +202,30 @@ void cmindexcloud_bang(t_cmindexcloud *x);
 t_bool cmindexcloud_resize(t_cmindexcloud *x);
 
 void cmindexcloud_wintype(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av);
+void cmindexcloud_dowinlength(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av);
 void cmindexcloud_winlength(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av);
+void cmindexcloud_winlist(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av);
+void cmindexcloud_winweights(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av);
+long cmindexcloud_grainwindow(t_cmindexcloud *x, double index);
+long cmindexcloud_grainskew(t_cmindexcloud *x);
+void cmindexcloud_doskew(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av);
+void cmindexcloud_skew(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av);
+void cmindexcloud_dowinparam(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av);
+void cmindexcloud_winparam(t_cmindexcloud *x, long type, double param);
 
 t_max_err cmindexcloud_stereo_set(t_cmindexcloud *x, t_object *attr, long argc, t_atom *argv);
 t_max_err cmindexcloud_winterp_set(t_cmindexcloud *x, t_object *attr, long argc, t_atom *argv);
 t_max_err cmindexcloud_sinterp_set(t_cmindexcloud *x, t_object *attr, long argc, t_atom *argv);
 t_max_err cmindexcloud_zero_set(t_cmindexcloud *x, t_object *attr, long argc, t_atom *argv);
 t_max_err cmindexcloud_reverse_set(t_cmindexcloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmindexcloud_winmode_set(t_cmindexcloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmindexcloud_kaiserbeta_set(t_cmindexcloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmindexcloud_tukeyratio_set(t_cmindexcloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmindexcloud_chebyatten_set(t_cmindexcloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmindexcloud_taylorsll_set(t_cmindexcloud *x, t_object *attr, long argc, t_atom *argv);
+t_max_err cmindexcloud_gaussalpha_set(t_cmindexcloud *x, t_object *attr, long argc, t_atom *argv);
 
-void cmindexcloud_windowwrite(t_cmindexcloud *x);
-t_bool cmindexcloud_do_wintype(t_cmindexcloud *x);
-t_bool cmindexcloud_do_winlength(t_cmindexcloud *x);
+void cmindexcloud_windowwrite(double *window, long type, double param, long length);
 
 // PANNING FUNCTION
 void cm_panning(cm_panstruct *panstruct, double *pos, t_cmindexcloud *x);
@@ -181,6 +236,16 @@ t_bool cm_randomreverse();
 // LINEAR INTERPOLATION FUNCTIONS
 double cm_lininterp(double distance, float *b_sample, t_atom_long b_channelcount, t_atom_long b_framecount, short channel);
 double cm_lininterpwin(double distance, double *buffer, t_atom_long b_channelcount, t_atom_long b_framecount, short channel);
+// SHARED WINDOW TABLES
+double *cm_window_acquire(long type, double param, long skew, long length, double *symmetric);
+cm_windowtable *cm_window_find(long type, double param, long skew, long length);
+void cm_window_release(double *window);
+t_bool cm_windowfamily_acquire(double **family, long type, double param, long skew_lo, long skew_hi, long length);
+void cm_windowfamily_release(double **family);
+t_bool cm_windowbank_acquire(double *(*bank)[SKEW_STEPS], double *params, long skew_lo, long skew_hi, long length);
+void cm_windowbank_release(double *(*bank)[SKEW_STEPS]);
+double cm_skewratio(long skew);
+void cm_skew(double *window, double *symmetric, long length, double attack);
 // WINDOW FUNCTIONS
 void cm_hann(double *window, long *length);
 void cm_hamming(double *window, long *length);
@@ -190,6 +255,19 @@ void cm_flattop(double *window, long *length);
 void cm_gauss2(double *window, long *length);
 void cm_gauss4(double *window, long *length);
 void cm_gauss8(double *window, long *length);
+void cm_blackman(double *window, long *length);
+void cm_blackmanharris(double *window, long *length);
+void cm_nuttall(double *window, long *length);
+void cm_bartletthann(double *window, long *length);
+void cm_parzen(double *window, long *length);
+void cm_bohman(double *window, long *length);
+void cm_kaiser(double *window, long *length, double beta);
+void cm_tukey(double *window, long *length, double ratio);
+void cm_chebyshev(double *window, long *length, double atten);
+void cm_taylor(double *window, long *length, double sll);
+void cm_gauss(double *window, long *length, double alpha);
+double cm_besseli0(double x);
+double cm_chebpoly(double n, double x);
 
 
 /************************************************************************************************************************/
@@ -209,6 +287,9 @@ void ext_main(void *r) {
 	class_addmethod(cmindexcloud_class, (method)cmindexcloud_grainlength,	"grainlength",	A_GIMME, 0); // Bind the cloudsize message
 	class_addmethod(cmindexcloud_class, (method)cmindexcloud_wintype,		"wintype", 		A_GIMME, 0); // Bind the window type message
 	class_addmethod(cmindexcloud_class, (method)cmindexcloud_winlength,		"winlength", 	A_GIMME, 0); // Bind the window length message
+	class_addmethod(cmindexcloud_class, (method)cmindexcloud_winlist,		"winlist", 		A_GIMME, 0); // Bind the window list message
+	class_addmethod(cmindexcloud_class, (method)cmindexcloud_winweights,	"winweights", 	A_GIMME, 0); // Bind the window weights message
+	class_addmethod(cmindexcloud_class, (method)cmindexcloud_skew,			"skew", 		A_GIMME, 0); // Bind the window skew message
 	class_addmethod(cmindexcloud_class, (method)cmindexcloud_pitchlist,		"pitchlist",	A_GIMME, 0); // Bind the pitchlist message
 	class_addmethod(cmindexcloud_class, (method)cmindexcloud_preview,		"preview",		A_GIMME, 0); // Bind the preview message
 	class_addmethod(cmindexcloud_class, (method)cmindexcloud_bang,			"bang",			0);
@@ -245,16 +326,55 @@ void ext_main(void *r) {
 	CLASS_ATTR_SAVE(cmindexcloud_class, "reverse", 0);
 	CLASS_ATTR_STYLE_LABEL(cmindexcloud_class, "reverse", 0, "enum", "Reverse mode");
 	
+	CLASS_ATTR_SYM(cmindexcloud_class, "winmode", 0, t_cmindexcloud, attr_winmode);
+	CLASS_ATTR_ENUM(cmindexcloud_class, "winmode", 0, "fixed random list weighted index");
+	CLASS_ATTR_ACCESSORS(cmindexcloud_class, "winmode", (method)NULL, (method)cmindexcloud_winmode_set);
+	CLASS_ATTR_BASIC(cmindexcloud_class, "winmode", 0);
+	CLASS_ATTR_SAVE(cmindexcloud_class, "winmode", 0);
+	CLASS_ATTR_STYLE_LABEL(cmindexcloud_class, "winmode", 0, "enum", "Window selection mode");
+	
+	CLASS_ATTR_DOUBLE(cmindexcloud_class, "kaiser_beta", 0, t_cmindexcloud, attr_kaiserbeta);
+	CLASS_ATTR_ACCESSORS(cmindexcloud_class, "kaiser_beta", (method)NULL, (method)cmindexcloud_kaiserbeta_set);
+	CLASS_ATTR_SAVE(cmindexcloud_class, "kaiser_beta", 0);
+	CLASS_ATTR_STYLE_LABEL(cmindexcloud_class, "kaiser_beta", 0, "text", "Kaiser window beta");
+	
+	CLASS_ATTR_DOUBLE(cmindexcloud_class, "tukey_ratio", 0, t_cmindexcloud, attr_tukeyratio);
+	CLASS_ATTR_ACCESSORS(cmindexcloud_class, "tukey_ratio", (method)NULL, (method)cmindexcloud_tukeyratio_set);
+	CLASS_ATTR_SAVE(cmindexcloud_class, "tukey_ratio", 0);
+	CLASS_ATTR_STYLE_LABEL(cmindexcloud_class, "tukey_ratio", 0, "text", "Tukey window taper ratio");
+	
+	CLASS_ATTR_DOUBLE(cmindexcloud_class, "cheby_atten", 0, t_cmindexcloud, attr_chebyatten);
+	CLASS_ATTR_ACCESSORS(cmindexcloud_class, "cheby_atten", (method)NULL, (method)cmindexcloud_chebyatten_set);
+	CLASS_ATTR_SAVE(cmindexcloud_class, "cheby_atten", 0);
+	CLASS_ATTR_STYLE_LABEL(cmindexcloud_class, "cheby_atten", 0, "text", "Chebyshev window sidelobe attenuation in dB");
+	
+	CLASS_ATTR_DOUBLE(cmindexcloud_class, "taylor_sll", 0, t_cmindexcloud, attr_taylorsll);
+	CLASS_ATTR_ACCESSORS(cmindexcloud_class, "taylor_sll", (method)NULL, (method)cmindexcloud_taylorsll_set);
+	CLASS_ATTR_SAVE(cmindexcloud_class, "taylor_sll", 0);
+	CLASS_ATTR_STYLE_LABEL(cmindexcloud_class, "taylor_sll", 0, "text", "Taylor window sidelobe level in dB");
+	
+	CLASS_ATTR_DOUBLE(cmindexcloud_class, "gauss_alpha", 0, t_cmindexcloud, attr_gaussalpha);
+	CLASS_ATTR_ACCESSORS(cmindexcloud_class, "gauss_alpha", (method)NULL, (method)cmindexcloud_gaussalpha_set);
+	CLASS_ATTR_SAVE(cmindexcloud_class, "gauss_alpha", 0);
+	CLASS_ATTR_STYLE_LABEL(cmindexcloud_class, "gauss_alpha", 0, "text", "Gauss window alpha");
+	
 	CLASS_ATTR_ORDER(cmindexcloud_class, "stereo", 0, "1");
 	CLASS_ATTR_ORDER(cmindexcloud_class, "w_interp", 0, "2");
 	CLASS_ATTR_ORDER(cmindexcloud_class, "s_interp", 0, "3");
 	CLASS_ATTR_ORDER(cmindexcloud_class, "zero", 0, "4");
 	CLASS_ATTR_ORDER(cmindexcloud_class, "reverse", 0, "5");
+	CLASS_ATTR_ORDER(cmindexcloud_class, "winmode", 0, "6");
+	CLASS_ATTR_ORDER(cmindexcloud_class, "kaiser_beta", 0, "7");
+	CLASS_ATTR_ORDER(cmindexcloud_class, "tukey_ratio", 0, "8");
+	CLASS_ATTR_ORDER(cmindexcloud_class, "cheby_atten", 0, "9");
+	CLASS_ATTR_ORDER(cmindexcloud_class, "taylor_sll", 0, "10");
+	CLASS_ATTR_ORDER(cmindexcloud_class, "gauss_alpha", 0, "11");
 	
 	class_dspinit(cmindexcloud_class); // Add standard Max/MSP methods to your class
 	class_register(CLASS_BOX, cmindexcloud_class); // Register the class with Max
 	ps_buffer_modified = gensym("buffer_modified"); // assign the buffer modified message to the static pointer created above
 	ps_stereo = gensym("stereo");
+	systhread_mutex_new(&cm_windowtables_mutex, 0);
 }
 
 
@@ -262,9 +382,9 @@ void ext_main(void *r) {
 /* NEW INSTANCE ROUTINE                                                                                                 */
 /************************************************************************************************************************/
 void *cmindexcloud_new(t_symbol *s, long argc, t_atom *argv) {
-	long i;
+	long i, r;
 	t_cmindexcloud *x = (t_cmindexcloud *)object_alloc(cmindexcloud_class); // create the object and allocate required memory
-	dsp_setup((t_pxobject *)x, 11); // create 11 inlets
+	dsp_setup((t_pxobject *)x, 12); // create 12 inlets
 	
 	if (argc < ARGUMENTS) {
 		object_error((t_object *)x, "%d arguments required: sample buffer | cloud size | max. grain length", ARGUMENTS);
@@ -282,6 +402,22 @@ void *cmindexcloud_new(t_symbol *s, long argc, t_atom *argv) {
 	object_attr_setlong(x, gensym("s_interp"), 1); // initialize window interpolation attribute
 	object_attr_setlong(x, gensym("zero"), 0); // initialize zero crossing attribute
 	object_attr_setsym(x, gensym("reverse"), gensym("off")); // initialize reverse attribute
+	object_attr_setsym(x, gensym("winmode"), gensym("fixed")); // initialize window selection mode attribute
+	for (i = 0; i <= MAX_WININDEX; i++) { // the window bank is written after the window parameters have been set
+		for (r = 0; r < SKEW_STEPS; r++) {
+			x->bank[i][r] = NULL;
+		}
+		x->winparam[i] = 0.0;
+	}
+	x->skew_min = 0.5; // symmetric windows
+	x->skew_max = 0.5;
+	x->skew_lo = SKEW_CENTER;
+	x->skew_hi = SKEW_CENTER;
+	object_attr_setfloat(x, gensym("kaiser_beta"), 8.6); // initialize kaiser window beta attribute
+	object_attr_setfloat(x, gensym("tukey_ratio"), 0.5); // initialize tukey window taper ratio attribute
+	object_attr_setfloat(x, gensym("cheby_atten"), 100.0); // initialize chebyshev window attenuation attribute
+	object_attr_setfloat(x, gensym("taylor_sll"), 30.0); // initialize taylor window sidelobe level attribute
+	object_attr_setfloat(x, gensym("gauss_alpha"), 3.0); // initialize gauss window alpha attribute
 	attr_args_process(x, argc, argv); // get attribute values if supplied as argument
 	
 	// CHECK IF USER SUPPLIED MAXIMUM GRAINS IS IN THE LEGAL RANGE
@@ -310,12 +446,12 @@ void *cmindexcloud_new(t_symbol *s, long argc, t_atom *argv) {
 
 	
 	/************************************************************************************************************************/
-	// ALLOCATE MEMORY FOR THE WINDOW ARRAY; this is new
-	x->window = (double *)sysmem_newptrclear((x->window_length) * sizeof(double));
-	if (x->window == NULL) {
+	// GET THE SHARED WINDOW ARRAYS OF ALL WINDOW TYPES (written by the first instance that uses them)
+	if (!cm_windowbank_acquire(x->bank, x->winparam, x->skew_lo, x->skew_hi, x->window_length)) {
 		object_error((t_object *)x, "out of memory");
 		return NULL;
 	}
+	systhread_mutex_new(&x->bank_mutex, SYSTHREAD_MUTEX_NORMAL);
 	
 	// ALLOCATE MEMORY FOR THE OBJET FLOAT_INLETS ARRAY
 	x->object_inlets = (double *)sysmem_newptrclear((FLOAT_INLETS) * sizeof(double));
@@ -377,7 +513,7 @@ void *cmindexcloud_new(t_symbol *s, long argc, t_atom *argv) {
 	x->tr_prev = 0.0; // initialize value for previous trigger sample
 	x->grains_count = 0; // initialize the grains count value
 	x->buffer_modified = false; // initialize buffer modified flag
-	x->wintype_request = false; // initialize window write flag
+	x->winindex = 0.0; // initialize window index inlet value
 	
 	// calculate constants for panning function
 	x->piovr2 = 4.0 * atan(1.0) * 0.5;
@@ -391,6 +527,11 @@ void *cmindexcloud_new(t_symbol *s, long argc, t_atom *argv) {
 	x->pitchlist_zero = 0.0;
 	x->pitchlist_size = 0.0;
 	
+	// window list and weights
+	x->winlist_zero = 0.0;
+	x->winlist_size = 0.0;
+	x->winweights_count = 0;
+	
 	// cloud structure members
 	for (i = 0; i < x->cloudsize; i++) {
 		x->cloud[i].length = 0;
@@ -401,12 +542,6 @@ void *cmindexcloud_new(t_symbol *s, long argc, t_atom *argv) {
 	x->cloudsize_new = x->cloudsize;
 	x->grainlength_new = x->grainlength;
 	
-	x->wintype_request = false;
-	x->wintype_verify = false;
-	
-	x->winlength_request = false;
-	x->winlength_verify = false;
-	
 	x->resize_request = false;
 	x->resize_verify = false;
 	
@@ -427,10 +562,6 @@ void *cmindexcloud_new(t_symbol *s, long argc, t_atom *argv) {
 	x->b_m_sr = 0;
 	x->sr_ratio = 0;
 	
-	
-	// WRITE WINDOW INTO WINDOW ARRAY
-	cmindexcloud_windowwrite(x);
-	
 #ifdef WIN_VERSION
 	srand((unsigned int)clock());
 #endif
@@ -454,6 +585,7 @@ void cmindexcloud_dsp64(t_cmindexcloud *x, t_object *dsp64, short *count, double
 	x->connect_status[7] = count[8]; // 9th inlet: write connection flag into object structure (1 if signal connected)
 	x->connect_status[8] = count[9]; // 10th inlet: write connection flag into object structure (1 if signal connected)
 	x->connect_status[9] = count[10]; // 11th inlet: write connection flag into object structure (1 if signal connected)
+	x->winindex_connected = count[11]; // 12th inlet: window index
 	
 	if (x->m_sr != samplerate * 0.001) { // check if sample rate stored in object structure is the same as the current project sample rate
 		x->m_sr = samplerate * 0.001;
@@ -493,6 +625,9 @@ void cmindexcloud_perform64(t_cmindexcloud *x, t_object *dsp64, double **ins, lo
 	double distance; // floating point index for reading from buffers
 	long index; // truncated index for reading from buffers
 	double b_read, w_read; // current sample read from the sample buffer and window array
+	double *window; // window table of the current grain
+	double wi_curr; // current window index value
+	t_bool bank_locked; // window bank locked for this signal vector
 	double outsample_left = 0.0; // temporary left output sample used for adding up all grain samples
 	double outsample_right = 0.0; // temporary right output sample used for adding up all grain samples
 	int slot = 0; // variable for the current slot in the arrays to write grain info to
@@ -519,6 +654,9 @@ void cmindexcloud_perform64(t_cmindexcloud *x, t_object *dsp64, double **ins, lo
 	t_buffer_obj *buffer_obj = buffer_ref_getobject(x->buffer_ref);
 	float *b_sample = buffer_locksamples(buffer_obj);
 	
+	// WINDOW BANK (never wait for the main thread, no grains are triggered while the bank is replaced)
+	bank_locked = (systhread_mutex_trylock(x->bank_mutex) == 0);
+	
 	// CLOUDSIZE - MEMORY RESIZE
 	if (!x->grains_count && x->resize_request) {
 		// allocate new memory and check if all went well
@@ -534,30 +672,6 @@ void cmindexcloud_perform64(t_cmindexcloud *x, t_object *dsp64, double **ins, lo
 		}
 	}
 	
-	// WINDOW TYPE
-	if (!x->grains_count && x->wintype_request) {
-		x->wintype_verify = cmindexcloud_do_wintype(x);
-		if (x->wintype_verify) {
-			x->wintype_verify = false;
-			x->wintype_request = false;
-		}
-		else {
-			goto zero;
-		}
-	}
-	
-	// WINDOW LENGTH
-	if (!x->grains_count && x->winlength_request) {
-		x->winlength_verify = cmindexcloud_do_winlength(x);
-		if (x->winlength_verify) {
-			x->winlength_verify = false;
-			x->winlength_request = false;
-		}
-		else {
-			goto zero;
-		}
-	}
-	
 	// CLOUDSIZE - GRAIN LENGTH
 	if (x->grains_count == 0 && x->length_request) {
 		// allocate new memory and check if all went well
@@ -584,6 +698,7 @@ void cmindexcloud_perform64(t_cmindexcloud *x, t_object *dsp64, double **ins, lo
 	
 	// GET INLET VALUES
 	t_double *tr_sigin 	= (t_double *)ins[0]; // get trigger input signal from 1st inlet
+	t_double *wi_sigin 	= (t_double *)ins[11]; // get window index input signal from 12th inlet
 	
 	x->grain_params[0] = x->connect_status[0] ? *ins[1] * x->b_m_sr : x->object_inlets[0] * x->b_m_sr;	// start min
 	x->grain_params[1] = x->connect_status[1] ? *ins[2] * x->b_m_sr : x->object_inlets[1] * x->b_m_sr;	// start max
@@ -673,6 +788,7 @@ void cmindexcloud_perform64(t_cmindexcloud *x, t_object *dsp64, double **ins, lo
 		}
 		
 		tr_curr = *tr_sigin++; // get current trigger value
+		wi_curr = *wi_sigin++; // get current window index value
 		
 		if (x->attr_zero) {
 			if (signbit(tr_curr) != signbit(x->tr_prev)) { // zero crossing from negative to positive
@@ -695,7 +811,7 @@ void cmindexcloud_perform64(t_cmindexcloud *x, t_object *dsp64, double **ins, lo
 		
 		/************************************************************************************************************************/
 		// IN CASE OF TRIGGER, LIMIT NOT MODIFIED AND GRAINS COUNT IN THE LEGAL RANGE (AVAILABLE SLOTS)
-		if (trigger && x->grains_count < x->cloudsize && !x->resize_request && !x->length_request && !x->wintype_request && !x->winlength_request && !x->preview_request && b_sample) {
+		if (trigger && x->grains_count < x->cloudsize && !x->resize_request && !x->length_request && !x->preview_request && b_sample && bank_locked) {
 			trigger = false; // reset trigger
 			x->grains_count++; // increment grains_count
 			// FIND A FREE SLOT FOR THE NEW GRAIN
@@ -809,15 +925,18 @@ void cmindexcloud_perform64(t_cmindexcloud *x, t_object *dsp64, double **ins, lo
 				}
 			}
 			
+			// select the window of the grain from the window bank
+			window = x->bank[cmindexcloud_grainwindow(x, x->winindex_connected ? wi_curr : x->winindex)][cmindexcloud_grainskew(x)];
+			
 			// grain is written into memory here
 			for (readpos = 0; readpos < smp_length; readpos++) {
 				if (x->attr_winterp) {
 					distance = ((double)readpos / (double)smp_length) * (double)x->window_length;
-					w_read = cm_lininterpwin(distance, x->window, 1, x->window_length, 0);
+					w_read = cm_lininterpwin(distance, window, 1, x->window_length, 0);
 				}
 				else {
 					index = (long)(((double)readpos / (double)smp_length) * (double)x->window_length);
-					w_read = x->window[index];
+					w_read = window[index];
 				}
 				// GET GRAIN SAMPLE FROM SAMPLE BUFFER
 				distance = start + (((double)readpos / (double)smp_length) * (double)pitch_length);
@@ -896,6 +1015,9 @@ void cmindexcloud_perform64(t_cmindexcloud *x, t_object *dsp64, double **ins, lo
 	/************************************************************************************************************************/
 	// STORE UPDATED RUNNING VALUES INTO THE OBJECT STRUCTURE
 	buffer_unlocksamples(buffer_obj);
+	if (bank_locked) {
+		systhread_mutex_unlock(x->bank_mutex);
+	}
 	outlet_int(x->grains_count_out, x->grains_count); // send number of currently playing grains to the outlet
 	return;
 	
@@ -905,6 +1027,9 @@ zero:
 		*out_right++ = 0.0;
 	}
 	buffer_unlocksamples(buffer_obj);
+	if (bank_locked) {
+		systhread_mutex_unlock(x->bank_mutex);
+	}
 	return; // THIS RETURN WAS MISSING FOR A LONG, LONG TIME. MAYBE THIS HELPS WITH STABILITY!?
 }
 
@@ -948,6 +1073,9 @@ void cmindexcloud_assist(t_cmindexcloud *x, void *b, long msg, long arg, char *d
 			case 10:
 				snprintf_zero(dst, 256, "(signal/float) gain max");
 				break;
+			case 11:
+				snprintf_zero(dst, 256, "(signal/float) window index");
+				break;
 		}
 	}
 	else if (msg == ASSIST_OUTLET) {
@@ -977,7 +1105,10 @@ void cmindexcloud_free(t_cmindexcloud *x) {
 	dsp_free((t_pxobject *)x); // free memory allocated for the object
 	object_free(x->buffer_ref); // free the buffer reference
 	
-	sysmem_freeptr(x->window); // free memory allocated to the window array
+	cm_windowbank_release(x->bank); // release the shared window arrays
+	if (x->bank_mutex) {
+		systhread_mutex_free(x->bank_mutex);
+	}
 	
 	for (i = 0; i < x->cloudsize; i++) {
 		sysmem_freeptr(x->cloud[i].left);
@@ -1090,6 +1221,9 @@ void cmindexcloud_float(t_cmindexcloud *x, double f) {
 				x->object_inlets[9] = f;
 			}
 			break;
+		case 11:
+			x->winindex = f;
+			break;
 	}
 }
 
@@ -1168,84 +1302,251 @@ void cmindexcloud_set(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av) {
 
 
 /************************************************************************************************************************/
-/* THE ACTUAL WINDOW TYPE SET METHOD                                                                                    */
+/* THE WINDOW TYPE METHOD (THE BANK HOLDS ALL WINDOW TYPES, THE TYPE IS USED BY THE NEXT GRAIN)                         */
 /************************************************************************************************************************/
-t_bool cmindexcloud_do_wintype(t_cmindexcloud *x) {
-	x->window_type = x->window_type_new;
-	
-	// write window into window array
-	cmindexcloud_windowwrite(x);
-	
-	return true;
+void cmindexcloud_wintype(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av) {
+	long arg;
+	if (ac && av) {
+		arg = atom_getlong(av);
+		if (arg < 0 || arg > MAX_WININDEX) {
+			object_error((t_object *)x, "invalid window type");
+		}
+		else {
+			x->window_type = arg;
+		}
+	}
+	else {
+		object_error((t_object *)x, "argument required (window type)");
+	}
 }
 
 
 /************************************************************************************************************************/
-/* THE WINDOW TYPE REQUEST METHOD                                                                                       */
+/* THE ACTUAL WINDOW LENGTH METHOD (THE NEW BANK IS WRITTEN ON THE MAIN THREAD AND REPLACES THE CURRENT BANK)           */
 /************************************************************************************************************************/
-void cmindexcloud_wintype(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av) {
-	long arg = atom_getlong(av);
+void cmindexcloud_dowinlength(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av) {
+	double *bank[MAX_WININDEX + 1][SKEW_STEPS];
+	double *old[MAX_WININDEX + 1][SKEW_STEPS];
+	long arg;
 	if (ac && av) {
 		arg = atom_getlong(av);
-		if (arg < 0 || arg > MAX_WININDEX) {
-			object_error((t_object *)x, "invalid window type");
+		if (arg < MIN_WINDOWLENGTH) {
+			object_error((t_object *)x, "window length must be greater than %d", MIN_WINDOWLENGTH);
+		}
+		else if (!cm_windowbank_acquire(bank, x->winparam, x->skew_lo, x->skew_hi, arg)) {
+			object_error((t_object *)x, "out of memory");
 		}
 		else {
-			x->window_type_new = arg;
-			x->wintype_request = true;
+			// the perform routine does not read the bank while it is replaced
+			systhread_mutex_lock(x->bank_mutex);
+			sysmem_copyptr(x->bank, old, sizeof(old));
+			sysmem_copyptr(bank, x->bank, sizeof(bank));
+			x->window_length = arg;
+			systhread_mutex_unlock(x->bank_mutex);
+			cm_windowbank_release(old);
 		}
 	}
 	else {
-		object_error((t_object *)x, "argument required (window type)");
+		object_error((t_object *)x, "argument required (window length)");
 	}
 }
 
 
+/************************************************************************************************************************/
+/* THE WINDOW LENGTH METHOD                                                                                             */
+/************************************************************************************************************************/
+void cmindexcloud_winlength(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av) {
+	defer(x, (method)cmindexcloud_dowinlength, s, ac, av);
+}
+
 
 /************************************************************************************************************************/
-/* THE ACTUAL WINDOW LENGTH SET METHOD                                                                                  */
+/* THE ACTUAL WINDOW PARAMETER METHOD (THE TABLES OF THE NEW PARAMETER ARE WRITTEN ON THE MAIN THREAD)                  */
 /************************************************************************************************************************/
-t_bool cmindexcloud_do_winlength(t_cmindexcloud *x) {
-	x->window_length = x->window_length_new;
-	
-	sysmem_freeptr(x->window);
-	
-	// resize and clear window array
-	x->window = (double *)sysmem_newptrclear(x->window_length * sizeof(double));
-	
-	// check if all went well
-	if (x->window == NULL) {
+void cmindexcloud_dowinparam(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av) {
+	double *family[SKEW_STEPS];
+	double *old[SKEW_STEPS];
+	long type = atom_getlong(av);
+	double param = x->winparam[type]; // a later change of the parameter is applied by its own deferred call
+	if (x->bank[type][SKEW_CENTER] == NULL) { // the bank has not been written yet (attributes of the new instance)
+		return;
+	}
+	if (!cm_windowfamily_acquire(family, type, param, x->skew_lo, x->skew_hi, x->window_length)) {
 		object_error((t_object *)x, "out of memory");
-		return false; // x->wintype_request will not be reset if memory allocation fails
+		return;
+	}
+	// the perform routine does not read the bank while the tables are replaced
+	systhread_mutex_lock(x->bank_mutex);
+	sysmem_copyptr(x->bank[type], old, sizeof(old));
+	sysmem_copyptr(family, x->bank[type], sizeof(family));
+	systhread_mutex_unlock(x->bank_mutex);
+	cm_windowfamily_release(old);
+}
+
+
+/************************************************************************************************************************/
+/* THE WINDOW PARAMETER METHOD                                                                                          */
+/************************************************************************************************************************/
+void cmindexcloud_winparam(t_cmindexcloud *x, long type, double param) {
+	t_atom arg;
+	x->winparam[type] = param;
+	atom_setlong(&arg, type);
+	defer(x, (method)cmindexcloud_dowinparam, NULL, 1, &arg);
+}
+
+
+/************************************************************************************************************************/
+/* THE ACTUAL WINDOW SKEW METHOD (THE TABLES OF THE NEW SKEW RANGE ARE WRITTEN ON THE MAIN THREAD)                      */
+/************************************************************************************************************************/
+void cmindexcloud_doskew(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av) {
+	double *bank[MAX_WININDEX + 1][SKEW_STEPS];
+	double *old[MAX_WININDEX + 1][SKEW_STEPS];
+	double skew_min, skew_max;
+	long skew_lo, skew_hi;
+	if (ac != 2) {
+		object_error((t_object *)x, "skew requires 2 arguments (min/max)");
+		return;
 	}
-	
-	// write window into window array
-	cmindexcloud_windowwrite(x);
-	
-	return true;
+	skew_min = atom_getfloat(av);
+	skew_max = atom_getfloat(av + 1);
+	if (skew_min < MIN_SKEW || skew_max > MAX_SKEW || skew_min > skew_max) {
+		object_error((t_object *)x, "skew values must be between %.2f and %.2f (min/max)", MIN_SKEW, MAX_SKEW);
+		return;
+	}
+	// skew steps of the range (0.5 is the symmetric window)
+	skew_lo = lround((skew_min - MIN_SKEW) / (MAX_SKEW - MIN_SKEW) * (SKEW_STEPS - 1));
+	skew_hi = lround((skew_max - MIN_SKEW) / (MAX_SKEW - MIN_SKEW) * (SKEW_STEPS - 1));
+	if (!cm_windowbank_acquire(bank, x->winparam, skew_lo, skew_hi, x->window_length)) {
+		object_error((t_object *)x, "out of memory");
+		return;
+	}
+	// the perform routine does not read the bank while it is replaced
+	systhread_mutex_lock(x->bank_mutex);
+	sysmem_copyptr(x->bank, old, sizeof(old));
+	sysmem_copyptr(bank, x->bank, sizeof(bank));
+	x->skew_min = skew_min;
+	x->skew_max = skew_max;
+	x->skew_lo = skew_lo;
+	x->skew_hi = skew_hi;
+	systhread_mutex_unlock(x->bank_mutex);
+	cm_windowbank_release(old);
 }
 
 
 /************************************************************************************************************************/
-/* THE WINDOW LENGTH REQUEST METHOD                                                                                     */
+/* THE WINDOW SKEW METHOD                                                                                               */
 /************************************************************************************************************************/
-void cmindexcloud_winlength(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av) {
-	long arg = atom_getlong(av);
-	if (ac && av) {
-		if (arg < MIN_WINDOWLENGTH) {
-			object_error((t_object *)x, "window length must be greater than %d", MIN_WINDOWLENGTH);
-		}
-		else {
-			x->window_length_new = arg;
-			x->winlength_request = true;
+void cmindexcloud_skew(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av) {
+	defer(x, (method)cmindexcloud_doskew, s, ac, av);
+}
+
+
+/************************************************************************************************************************/
+/* THE WINDOW LIST METHOD                                                                                               */
+/************************************************************************************************************************/
+void cmindexcloud_winlist(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av) {
+	long value;
+	if (ac < 1) {
+		object_error((t_object *)x, "minimum number of window types is 1");
+	}
+	else if (ac <= WINLIST) {
+		x->winlist_size = 0.0; // the list is not read while being written
+		for (int i = 0; i < ac; i++) {
+			value = atom_getlong(av+i);
+			if (value < 0 || value > MAX_WININDEX) {
+				object_error((t_object *)x, "value of element %d (%ld) is not a valid window type - setting value to %d", (i+1), value, DEFAULT_WINTYPE);
+				value = DEFAULT_WINTYPE;
+			}
+			x->winlist[i] = value;
 		}
+		x->winlist_size = (double)ac;
 	}
 	else {
-		object_error((t_object *)x, "argument required (window length)");
+		object_error((t_object *)x, "maximum number of window types is %d", WINLIST);
 	}
 }
 
 
+/************************************************************************************************************************/
+/* THE WINDOW WEIGHTS METHOD                                                                                            */
+/************************************************************************************************************************/
+void cmindexcloud_winweights(t_cmindexcloud *x, t_symbol *s, long ac, t_atom *av) {
+	double weights[MAX_WININDEX + 1];
+	double sum = 0.0;
+	if (ac < 1 || ac > MAX_WININDEX + 1) {
+		object_error((t_object *)x, "between 1 and %d window weights required", MAX_WININDEX + 1);
+		return;
+	}
+	for (int i = 0; i < ac; i++) {
+		weights[i] = atom_getfloat(av + i);
+		if (weights[i] < 0.0) {
+			object_error((t_object *)x, "window weight %d must not be negative - setting to 0", (i+1));
+			weights[i] = 0.0;
+		}
+		sum += weights[i];
+		weights[i] = sum;
+	}
+	if (sum <= 0.0) {
+		object_error((t_object *)x, "at least one window weight must be greater than 0");
+		return;
+	}
+	x->winweights_count = 0; // weights are not read while being written
+	for (int i = 0; i < ac; i++) {
+		x->winweights[i] = weights[i];
+	}
+	x->winweights_count = ac;
+}
+
+
+/************************************************************************************************************************/
+/* THE GRAIN WINDOW SELECTION METHOD (AUDIO THREAD)                                                                     */
+/************************************************************************************************************************/
+// returns the window type of a new grain, index is the value of the window index inlet
+long cmindexcloud_grainwindow(t_cmindexcloud *x, double index) {
+	long type = x->window_type;
+	double type_zero = 0.0;
+	double type_max = (double)(MAX_WININDEX + 1);
+	double rnd;
+	if (x->attr_winmode == gensym("random")) {
+		type = (long)cm_random(&type_zero, &type_max);
+	}
+	else if (x->attr_winmode == gensym("list") && x->winlist_size > 0) {
+		type = x->winlist[(long)cm_random(&x->winlist_zero, &x->winlist_size)];
+	}
+	else if (x->attr_winmode == gensym("weighted") && x->winweights_count > 0) {
+		// pick a window type from the cumulative weights
+		rnd = cm_random(&type_zero, &x->winweights[x->winweights_count - 1]);
+		type = 0;
+		while (type < x->winweights_count - 1 && rnd >= x->winweights[type]) {
+			type++;
+		}
+	}
+	else if (x->attr_winmode == gensym("index")) {
+		type = (long)index;
+	}
+	if (type < 0) {
+		type = 0;
+	}
+	else if (type > MAX_WININDEX) {
+		type = MAX_WININDEX;
+	}
+	return type;
+}
+// per-grain window skew step (random within the skew range)
+long cmindexcloud_grainskew(t_cmindexcloud *x) {
+	long skew;
+	if (x->skew_lo == x->skew_hi) {
+		return x->skew_lo;
+	}
+	skew = lround((cm_random(&x->skew_min, &x->skew_max) - MIN_SKEW) / (MAX_SKEW - MIN_SKEW) * (SKEW_STEPS - 1));
+	if (skew < x->skew_lo) {
+		skew = x->skew_lo;
+	}
+	else if (skew > x->skew_hi) {
+		skew = x->skew_hi;
+	}
+	return skew;
+}
 
 
 /************************************************************************************************************************/
@@ -1466,47 +1767,201 @@ t_max_err cmindexcloud_reverse_set(t_cmindexcloud *x, t_object *attr, long ac, t
 	return MAX_ERR_NONE;
 }
 
+/************************************************************************************************************************/
+/* THE WINDOW MODE ATTRIBUTE SET METHOD                                                                                 */
+/************************************************************************************************************************/
+t_max_err cmindexcloud_winmode_set(t_cmindexcloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		t_symbol *arg = atom_getsym(av);
+		if (arg != gensym("fixed") && arg != gensym("random") && arg != gensym("list") && arg != gensym("weighted") && arg != gensym("index")) {
+			object_error((t_object *)x, "invalid attribute value");
+			object_error((t_object *)x, "valid attribute values are fixed | random | list | weighted | index");
+		}
+		else {
+			x->attr_winmode = arg;
+		}
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE KAISER WINDOW BETA ATTRIBUTE SET METHOD                                                                          */
+/************************************************************************************************************************/
+t_max_err cmindexcloud_kaiserbeta_set(t_cmindexcloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		double arg = atom_getfloat(av);
+		if (arg < 0.0) {
+			object_error((t_object *)x, "kaiser_beta must be 0 or larger - setting to 0");
+			arg = 0.0;
+		}
+		else if (arg > 30.0) {
+			object_error((t_object *)x, "kaiser_beta must not be larger than 30 - setting to 30");
+			arg = 30.0;
+		}
+		x->attr_kaiserbeta = arg;
+		cmindexcloud_winparam(x, WIN_KAISER, arg);
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE TUKEY WINDOW RATIO ATTRIBUTE SET METHOD                                                                          */
+/************************************************************************************************************************/
+t_max_err cmindexcloud_tukeyratio_set(t_cmindexcloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		double arg = atom_getfloat(av);
+		if (arg < 0.0) {
+			object_error((t_object *)x, "tukey_ratio must be 0 or larger - setting to 0");
+			arg = 0.0;
+		}
+		else if (arg > 1.0) {
+			object_error((t_object *)x, "tukey_ratio must not be larger than 1 - setting to 1");
+			arg = 1.0;
+		}
+		x->attr_tukeyratio = arg;
+		cmindexcloud_winparam(x, WIN_TUKEY, arg);
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE CHEBYSHEV WINDOW ATTENUATION ATTRIBUTE SET METHOD                                                                */
+/************************************************************************************************************************/
+t_max_err cmindexcloud_chebyatten_set(t_cmindexcloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		double arg = atom_getfloat(av);
+		if (arg < 20.0) {
+			object_error((t_object *)x, "cheby_atten must be 20 or larger - setting to 20");
+			arg = 20.0;
+		}
+		else if (arg > 200.0) {
+			object_error((t_object *)x, "cheby_atten must not be larger than 200 - setting to 200");
+			arg = 200.0;
+		}
+		x->attr_chebyatten = arg;
+		cmindexcloud_winparam(x, WIN_CHEBYSHEV, arg);
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE TAYLOR WINDOW SIDELOBE LEVEL ATTRIBUTE SET METHOD                                                                */
+/************************************************************************************************************************/
+t_max_err cmindexcloud_taylorsll_set(t_cmindexcloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		double arg = atom_getfloat(av);
+		if (arg < 10.0) {
+			object_error((t_object *)x, "taylor_sll must be 10 or larger - setting to 10");
+			arg = 10.0;
+		}
+		else if (arg > 100.0) {
+			object_error((t_object *)x, "taylor_sll must not be larger than 100 - setting to 100");
+			arg = 100.0;
+		}
+		x->attr_taylorsll = arg;
+		cmindexcloud_winparam(x, WIN_TAYLOR, arg);
+	}
+	return MAX_ERR_NONE;
+}
+
+
+/************************************************************************************************************************/
+/* THE GAUSS WINDOW ALPHA ATTRIBUTE SET METHOD                                                                          */
+/************************************************************************************************************************/
+t_max_err cmindexcloud_gaussalpha_set(t_cmindexcloud *x, t_object *attr, long ac, t_atom *av) {
+	if (ac && av) {
+		double arg = atom_getfloat(av);
+		if (arg < 0.5) {
+			object_error((t_object *)x, "gauss_alpha must be 0.5 or larger - setting to 0.5");
+			arg = 0.5;
+		}
+		else if (arg > 20.0) {
+			object_error((t_object *)x, "gauss_alpha must not be larger than 20 - setting to 20");
+			arg = 20.0;
+		}
+		x->attr_gaussalpha = arg;
+		cmindexcloud_winparam(x, WIN_GAUSS, arg);
+	}
+	return MAX_ERR_NONE;
+}
+
+
 /************************************************************************************************************************/
 /* THE WINDOW_WRITE FUNCTION                                                                                            */
 /************************************************************************************************************************/
-void cmindexcloud_windowwrite(t_cmindexcloud *x) {
-	//	int i;
-	long length = x->window_length;
-	switch (x->window_type) {
+void cmindexcloud_windowwrite(double *window, long type, double param, long length) {
+	switch (type) {
 		case 0:
 			// object_post((t_object*)x, "hann - %d", length);
-			cm_hann(x->window, &length);
+			cm_hann(window, &length);
 			break;
 		case 1:
 			// object_post((t_object*)x, "hamming - %d", length);
-			cm_hamming(x->window, &length);
+			cm_hamming(window, &length);
 			break;
 		case 2:
 			// object_post((t_object*)x, "rectangular - %d", length);
-			cm_rectangular(x->window, &length);
+			cm_rectangular(window, &length);
 			break;
 		case 3:
 			// object_post((t_object*)x, "bartlett - %d", length);
-			cm_bartlett(x->window, &length);
+			cm_bartlett(window, &length);
 			break;
 		case 4:
 			// object_post((t_object*)x, "flattop - %d", length);
-			cm_flattop(x->window, &length);
+			cm_flattop(window, &length);
 			break;
 		case 5:
 			// object_post((t_object*)x, "gauss (alpha 2) - %d", length);
-			cm_gauss2(x->window, &length);
+			cm_gauss2(window, &length);
 			break;
 		case 6:
 			// object_post((t_object*)x, "gauss (alpha 4) - %d", length);
-			cm_gauss4(x->window, &length);
+			cm_gauss4(window, &length);
 			break;
 		case 7:
 			// object_post((t_object*)x, "gauss (alpha 8) - %d", length);
-			cm_gauss8(x->window, &length);
+			cm_gauss8(window, &length);
+			break;
+		case 8:
+			cm_blackman(window, &length);
+			break;
+		case 9:
+			cm_blackmanharris(window, &length);
+			break;
+		case 10:
+			cm_nuttall(window, &length);
+			break;
+		case 11:
+			cm_bartletthann(window, &length);
+			break;
+		case 12:
+			cm_parzen(window, &length);
+			break;
+		case 13:
+			cm_bohman(window, &length);
+			break;
+		case WIN_KAISER:
+			cm_kaiser(window, &length, param);
+			break;
+		case WIN_TUKEY:
+			cm_tukey(window, &length, param);
+			break;
+		case WIN_CHEBYSHEV:
+			cm_chebyshev(window, &length, param);
+			break;
+		case WIN_TAYLOR:
+			cm_taylor(window, &length, param);
+			break;
+		case WIN_GAUSS:
+			cm_gauss(window, &length, param);
 			break;
 		default:
-			cm_hann(x->window, &length);
+			cm_hann(window, &length);
 	}
 	return;
 }
@@ -1515,6 +1970,162 @@ void cmindexcloud_windowwrite(t_cmindexcloud *x) {
 /************************************************************************************************************************/
 /* CUSTOM FUNCTIONS																										*/
 /************************************************************************************************************************/
+// SHARED WINDOW TABLES: returns the table of the window type, parameter, skew step and length, written when no instance uses it yet
+// (skewed tables are warped from symmetric, the acquired table of the SKEW_CENTER step)
+double *cm_window_acquire(long type, double param, long skew, long length, double *symmetric) {
+	cm_windowtable *table;
+	cm_windowtable *shared;
+	systhread_mutex_lock(cm_windowtables_mutex); // the lock only guards the list - tables are allocated and written outside of it
+	shared = cm_window_find(type, param, skew, length);
+	systhread_mutex_unlock(cm_windowtables_mutex);
+	if (shared) {
+		return shared->window;
+	}
+	table = (cm_windowtable *)sysmem_newptrclear(sizeof(cm_windowtable));
+	if (table) {
+		table->window = (double *)sysmem_newptrclear(length * sizeof(double));
+		if (table->window == NULL) {
+			sysmem_freeptr(table);
+			table = NULL;
+		}
+	}
+	if (table == NULL) {
+		return NULL;
+	}
+	if (skew == SKEW_CENTER) {
+		cmindexcloud_windowwrite(table->window, type, param, length);
+	}
+	else {
+		cm_skew(table->window, symmetric, length, cm_skewratio(skew));
+	}
+	table->type = type;
+	table->param = param;
+	table->skew = skew;
+	table->length = length;
+	table->refcount = 1;
+	systhread_mutex_lock(cm_windowtables_mutex);
+	shared = cm_window_find(type, param, skew, length); // another instance may have inserted the same table in the meantime
+	if (shared == NULL) {
+		table->next = cm_windowtables;
+		cm_windowtables = table;
+	}
+	systhread_mutex_unlock(cm_windowtables_mutex);
+	if (shared) {
+		sysmem_freeptr(table->window);
+		sysmem_freeptr(table);
+		return shared->window;
+	}
+	return table->window;
+}
+// SHARED WINDOW TABLES: returns the listed table and counts the new reference (the caller holds cm_windowtables_mutex)
+cm_windowtable *cm_window_find(long type, double param, long skew, long length) {
+	cm_windowtable *table;
+	for (table = cm_windowtables; table; table = table->next) {
+		if (table->type == type && table->param == param && table->skew == skew && table->length == length) {
+			table->refcount++;
+			return table;
+		}
+	}
+	return NULL;
+}
+// SHARED WINDOW TABLES: the table is freed when the last instance releases it
+void cm_window_release(double *window) {
+	cm_windowtable **link;
+	cm_windowtable *table = NULL;
+	if (window == NULL) {
+		return;
+	}
+	systhread_mutex_lock(cm_windowtables_mutex);
+	for (link = &cm_windowtables; *link; link = &(*link)->next) {
+		if ((*link)->window == window) {
+			if (--(*link)->refcount == 0) {
+				table = *link;
+				*link = table->next;
+			}
+			break;
+		}
+	}
+	systhread_mutex_unlock(cm_windowtables_mutex);
+	if (table) { // the unlinked table is freed outside of the lock
+		sysmem_freeptr(table->window);
+		sysmem_freeptr(table);
+	}
+}
+// WINDOW FAMILY: acquires the shared tables of a window type for the symmetric window and the skew steps of the skew range
+t_bool cm_windowfamily_acquire(double **family, long type, double param, long skew_lo, long skew_hi, long length) {
+	long skew;
+	for (skew = 0; skew < SKEW_STEPS; skew++) {
+		family[skew] = NULL;
+	}
+	family[SKEW_CENTER] = cm_window_acquire(type, param, SKEW_CENTER, length, NULL); // the skewed tables are warped from it
+	if (family[SKEW_CENTER] == NULL) {
+		return false;
+	}
+	for (skew = 0; skew < SKEW_STEPS; skew++) {
+		if (skew != SKEW_CENTER && skew >= skew_lo && skew <= skew_hi) {
+			family[skew] = cm_window_acquire(type, param, skew, length, family[SKEW_CENTER]);
+			if (family[skew] == NULL) {
+				cm_windowfamily_release(family);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+// WINDOW FAMILY: releases the tables of a window type
+void cm_windowfamily_release(double **family) {
+	for (long skew = 0; skew < SKEW_STEPS; skew++) {
+		cm_window_release(family[skew]);
+		family[skew] = NULL;
+	}
+}
+// WINDOW BANK: acquires the window families of all window types with their parameters at the window length
+t_bool cm_windowbank_acquire(double *(*bank)[SKEW_STEPS], double *params, long skew_lo, long skew_hi, long length) {
+	long type;
+	for (type = 0; type <= MAX_WININDEX; type++) {
+		if (!cm_windowfamily_acquire(bank[type], type, params[type], skew_lo, skew_hi, length)) {
+			while (type--) {
+				cm_windowfamily_release(bank[type]);
+			}
+			return false;
+		}
+	}
+	return true;
+}
+// WINDOW BANK: releases the window families of all window types
+void cm_windowbank_release(double *(*bank)[SKEW_STEPS]) {
+	for (long type = 0; type <= MAX_WININDEX; type++) {
+		cm_windowfamily_release(bank[type]);
+	}
+}
+// WINDOW SKEW: attack ratio (position of the window peak) of a skew step
+double cm_skewratio(long skew) {
+	return MIN_SKEW + ((MAX_SKEW - MIN_SKEW) * skew) / (SKEW_STEPS - 1);
+}
+// WINDOW SKEW: the attack of the symmetric window is stretched over the attack ratio of the window, the decay over the rest
+void cm_skew(double *window, double *symmetric, long length, double attack) {
+	long i, index;
+	double pos, frac;
+	long N = length - 1;
+	for (i = 0; i < length; i++) {
+		pos = (double)i / N;
+		if (pos < attack) {
+			pos = 0.5 * pos / attack;
+		}
+		else {
+			pos = 0.5 + 0.5 * (pos - attack) / (1.0 - attack);
+		}
+		pos *= N;
+		index = (long)pos;
+		if (index >= N) {
+			window[i] = symmetric[N];
+		}
+		else {
+			frac = pos - index;
+			window[i] = symmetric[index] + frac * (symmetric[index + 1] - symmetric[index]);
+		}
+	}
+}
 // constant power stereo function
 void cm_panning(cm_panstruct *panstruct, double *pos, t_cmindexcloud *x) {
 	panstruct->left = x->root2ovr2 * (cos((*pos * x->piovr2) * 0.5) - sin((*pos * x->piovr2) * 0.5));
@@ -1674,3 +2285,238 @@ void cm_gauss8(double *window, long *length) {
 		window[i] = exp(-0.5 * pow((n / stdev), 2));
 	}
 }
+
+
+void cm_blackman(double *window, long *length) {
+	int i;
+	long N = *length - 1;
+	for (i = 0; i < *length; i++) {
+		window[i] = 0.42 - (0.5 * cos((2.0 * M_PI * i) / N)) + (0.08 * cos((4.0 * M_PI * i) / N));
+	}
+}
+
+
+void cm_blackmanharris(double *window, long *length) {
+	int i;
+	long N = *length - 1;
+	for (i = 0; i < *length; i++) {
+		window[i] = 0.35875 - (0.48829 * cos((2.0 * M_PI * i) / N)) + (0.14128 * cos((4.0 * M_PI * i) / N)) - (0.01168 * cos((6.0 * M_PI * i) / N));
+	}
+}
+
+
+void cm_nuttall(double *window, long *length) {
+	int i;
+	long N = *length - 1;
+	for (i = 0; i < *length; i++) {
+		window[i] = 0.355768 - (0.487396 * cos((2.0 * M_PI * i) / N)) + (0.144232 * cos((4.0 * M_PI * i) / N)) - (0.012604 * cos((6.0 * M_PI * i) / N));
+	}
+}
+
+
+void cm_bartletthann(double *window, long *length) {
+	int i;
+	long N = *length - 1;
+	for (i = 0; i < *length; i++) {
+		window[i] = 0.62 - (0.48 * fabs(((double)i / N) - 0.5)) - (0.38 * cos((2.0 * M_PI * i) / N));
+	}
+}
+
+
+// parzen: piecewise cubic (de la vallee poussin) window
+void cm_parzen(double *window, long *length) {
+	int i;
+	double n;
+	double N = *length - 1;
+	double half = *length / 2.0;
+	for (i = 0; i < *length; i++) {
+		n = fabs(i - N / 2) / half;
+		if (n <= 0.5) { // the cubic pieces meet at a quarter of the length from the center
+			window[i] = 1.0 - (6.0 * n * n) + (6.0 * n * n * n);
+		}
+		else {
+			window[i] = 2.0 * pow(1.0 - n, 3);
+		}
+	}
+}
+
+
+void cm_bohman(double *window, long *length) {
+	int i;
+	double n;
+	long N = *length - 1;
+	for (i = 0; i < *length; i++) {
+		n = fabs(((2.0 * i) / N) - 1.0);
+		window[i] = ((1.0 - n) * cos(M_PI * n)) + (sin(M_PI * n) / M_PI);
+	}
+	window[0] = 0.0;
+	window[N] = 0.0;
+}
+
+
+// kaiser: beta sets the tradeoff between main lobe width and sidelobe level (0 = rectangular)
+void cm_kaiser(double *window, long *length, double beta) {
+	int i;
+	double n;
+	long N = *length - 1;
+	double norm = cm_besseli0(beta);
+	for (i = 0; i < *length; i++) {
+		n = ((2.0 * i) / N) - 1.0;
+		window[i] = cm_besseli0(beta * sqrt(fmax(0.0, 1.0 - n * n))) / norm;
+	}
+}
+
+
+// tukey: cosine tapered rectangle, ratio is the tapered part of the window (0 = rectangular, 1 = hann)
+void cm_tukey(double *window, long *length, double ratio) {
+	int i;
+	long N = *length - 1;
+	double taper = ratio * N / 2.0;
+	for (i = 0; i < *length; i++) {
+		if (taper > 0.0 && i < taper) {
+			window[i] = 0.5 * (1.0 - cos(M_PI * i / taper));
+		}
+		else if (taper > 0.0 && i > N - taper) {
+			window[i] = 0.5 * (1.0 - cos(M_PI * (N - i) / taper));
+		}
+		else {
+			window[i] = 1.0;
+		}
+	}
+}
+
+
+// chebyshev (dolph-chebyshev): all sidelobes at atten dB below the main lobe. the window is the inverse dft of the
+// chebyshev polynomial sampled on the unit circle (O(length^2), written once per table), normalized to a peak of 1.
+// windows longer than CHEBY_MAXLENGTH are linearly resampled from a window of that length
+void cm_chebyshev(double *window, long *length, double atten) {
+	long i, k;
+	long M = *length;
+	if (M > CHEBY_MAXLENGTH) {
+		long L = CHEBY_MAXLENGTH;
+		double pos;
+		double *short_window = (double *)sysmem_newptr(L * sizeof(double));
+		if (short_window == NULL) {
+			cm_hann(window, length);
+			return;
+		}
+		cm_chebyshev(short_window, &L, atten);
+		for (i = 0; i < M; i++) { // the first and last samples and the symmetry are kept
+			pos = (double)i * (L - 1) / (M - 1);
+			k = (long)pos;
+			window[i] = (k >= L - 1) ? short_window[L - 1] : short_window[k] + (pos - k) * (short_window[k + 1] - short_window[k]);
+		}
+		sysmem_freeptr(short_window);
+		return;
+	}
+	long half = (M % 2) ? (M + 1) / 2 : (M / 2) + 1;
+	double order = M - 1;
+	double x0 = cosh(acosh(pow(10.0, atten / 20.0)) / order);
+	double sum, c, s, tmp, step_c, step_s, peak = 0.0;
+	double *p = (double *)sysmem_newptr(M * sizeof(double));
+	if (p == NULL) { // the hann window is written if the polynomial samples cannot be allocated
+		cm_hann(window, length);
+		return;
+	}
+	for (k = 0; k < M; k++) {
+		p[k] = cm_chebpoly(order, x0 * cos(M_PI * k / M));
+	}
+	// one half of the symmetric window (odd length: centered on sample 0, even length: half a sample shifted)
+	for (i = 0; i < half; i++) {
+		step_c = cos((M % 2) ? (2.0 * M_PI * i / M) : (M_PI * (1 - 2 * i) / M));
+		step_s = sin((M % 2) ? (2.0 * M_PI * i / M) : (M_PI * (1 - 2 * i) / M));
+		c = 1.0;
+		s = 0.0;
+		sum = 0.0;
+		for (k = 0; k < M; k++) { // the cosine of the dft is a rotation, no trigonometric function per term
+			sum += p[k] * c;
+			tmp = c * step_c - s * step_s;
+			s = s * step_c + c * step_s;
+			c = tmp;
+		}
+		if (M % 2) {
+			window[half - 1 - i] = sum;
+			window[half - 1 + i] = sum;
+		}
+		else if (i > 0) {
+			window[half - 1 - i] = sum;
+			window[half - 2 + i] = sum;
+		}
+	}
+	for (i = 0; i < M; i++) {
+		peak = fmax(peak, fabs(window[i]));
+	}
+	for (i = 0; i < M; i++) {
+		window[i] /= peak;
+	}
+	sysmem_freeptr(p);
+}
+
+
+// taylor: TAYLOR_NBAR nearly constant sidelobes at sll dB below the main lobe, then decaying sidelobes
+void cm_taylor(double *window, long *length, double sll) {
+	int i, m, j;
+	long M = *length;
+	double fm[TAYLOR_NBAR];
+	double a = acosh(pow(10.0, sll / 20.0)) / M_PI;
+	double s2 = (TAYLOR_NBAR * TAYLOR_NBAR) / (a * a + (TAYLOR_NBAR - 0.5) * (TAYLOR_NBAR - 0.5));
+	double numer, denom, sum;
+	double norm = 1.0;
+	for (m = 1; m < TAYLOR_NBAR; m++) {
+		numer = (m % 2) ? 1.0 : -1.0;
+		denom = 2.0;
+		for (j = 1; j < TAYLOR_NBAR; j++) {
+			numer *= 1.0 - (m * m) / s2 / (a * a + (j - 0.5) * (j - 0.5));
+			if (j != m) {
+				denom *= 1.0 - (double)(m * m) / (j * j);
+			}
+		}
+		fm[m] = numer / denom;
+		norm += 2.0 * fm[m];
+	}
+	for (i = 0; i < M; i++) {
+		sum = 1.0;
+		for (m = 1; m < TAYLOR_NBAR; m++) {
+			sum += 2.0 * fm[m] * cos(2.0 * M_PI * m * (i - M / 2.0 + 0.5) / M);
+		}
+		window[i] = sum / norm;
+	}
+}
+
+
+// gauss: alpha is the ratio of the half window length to the standard deviation
+void cm_gauss(double *window, long *length, double alpha) {
+	int i;
+	double n;
+	double N = *length - 1;
+	double stdev = N / (2 * alpha);
+	for (i = 0; i < *length; i++) {
+		n = i - N / 2;
+		window[i] = exp(-0.5 * (n / stdev) * (n / stdev));
+	}
+}
+
+
+// modified bessel function of the first kind, order 0 (power series)
+double cm_besseli0(double x) {
+	double sum = 1.0;
+	double term = 1.0;
+	double q = (x * x) / 4.0;
+	for (int k = 1; k < 500 && term > sum * 1e-16; k++) {
+		term *= q / ((double)k * k);
+		sum += term;
+	}
+	return sum;
+}
+
+
+// chebyshev polynomial of the first kind of order n
+double cm_chebpoly(double n, double x) {
+	if (fabs(x) <= 1.0) {
+		return cos(n * acos(x));
+	}
+	if (x > 1.0) {
+		return cosh(n * acosh(x));
+	}
+	return (fmod(n, 2.0) == 0.0 ? 1.0 : -1.0) * cosh(n * acosh(-x));
+}